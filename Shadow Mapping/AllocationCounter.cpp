@@ -0,0 +1,91 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <malloc.h>
+#include <new>
+#include <stdlib.h>
+
+// Replacing the global operators routes every new and delete in
+// the program through here; the other variants (arrays, nothrow,
+// sized delete) are defined too so none of them bypass the count
+
+#if defined(DEBUG) || defined(_DEBUG)
+
+namespace
+{
+	std::atomic<unsigned long long> heapAllocationCount(0);
+
+	void* CountedMalloc(size_t size)
+	{
+		heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		return malloc(size > 0 ? size : 1);
+	}
+
+	void* CountedAlignedMalloc(size_t size, std::align_val_t alignment)
+	{
+		heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		return _aligned_malloc(size > 0 ? size : 1, (size_t)alignment);
+	}
+}
+
+unsigned long long GetHeapAllocationCount()
+{
+	return heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size)
+{
+	void* p = CountedMalloc(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedMalloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedMalloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* p = CountedAlignedMalloc(size, alignment);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { _aligned_free(p); }
+
+#else
+
+unsigned long long GetHeapAllocationCount()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+
+// --------------------------------------------------------
+// Counts heap allocations made through operator new, which
+// AllocationCounter.cpp replaces for the whole program, so
+// the game loop can check a settled frame makes none.
+// Debug builds only - in release the operators are left
+// alone and the count stays at zero.
+//
+// malloc isn't counted, and neither is anything allocated
+// inside other DLLs (the D3D runtime, the driver).
+// --------------------------------------------------------
+unsigned long long GetHeapAllocationCount();
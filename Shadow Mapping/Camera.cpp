@@ -1,4 +1,5 @@
 #include "Camera.h"
+#include "FrustumCulling.h"
 #include "Input.h"
 
 Camera::Camera(float aspectRatio, DirectX::XMFLOAT3 initialPosition, DirectX::XMFLOAT3 initialRotation, float fov, float nearClipDistance, float farClipDistance, float moveSpeed, float mouseLookSpeed, bool isOrthographic)
@@ -14,8 +15,11 @@ Camera::Camera(float aspectRatio, DirectX::XMFLOAT3 initialPosition, DirectX::XM
 	this->mouseLookSpeed = mouseLookSpeed;
 	this->isOrthographic = isOrthographic;
 
-	UpdateViewMatrix();
+	//both matrix updates rebuild the frustum planes from the pair, so the
+	//view starts as identity until the projection it's paired with exists
+	DirectX::XMStoreFloat4x4(&viewMatrix, DirectX::XMMatrixIdentity());
 	UpdateProjectionMatrix(aspectRatio);
+	UpdateViewMatrix();
 }
 
 Camera::~Camera()
@@ -42,14 +46,47 @@ DirectX::XMFLOAT3 Camera::GetAmbientColor()
 	return cameraAmbientColor;
 }
 
+//vertical field of view in radians
+float Camera::GetFov()
+{
+	return fov;
+}
+
+float Camera::GetAspectRatio()
+{
+	return aspectRatio;
+}
+
+float Camera::GetNearClipDistance()
+{
+	return nearClipDistance;
+}
+
+float Camera::GetFarClipDistance()
+{
+	return farClipDistance;
+}
+
+bool Camera::IsOrthographic()
+{
+	return isOrthographic;
+}
+
+const DirectX::XMFLOAT4* Camera::GetFrustumPlanes()
+{
+	return frustumPlanes;
+}
+
 void Camera::SetViewMatrix(DirectX::XMFLOAT4X4 newViewMatrix)
 {
 	DirectX::XMStoreFloat4x4(&viewMatrix, DirectX::XMLoadFloat4x4(&newViewMatrix));
+	UpdateFrustumPlanes();
 }
 
 void Camera::SetProjectionMatrix(DirectX::XMFLOAT4X4 newProjectionMatrix)
 {
 	DirectX::XMStoreFloat4x4(&projectionMatrix, DirectX::XMLoadFloat4x4(&newProjectionMatrix));
+	UpdateFrustumPlanes();
 }
 
 void Camera::Update(float dt)
@@ -105,7 +142,9 @@ void Camera::Update(float dt)
 
 void Camera::UpdateProjectionMatrix(float aspectRatio)
 {
+	this->aspectRatio = aspectRatio;
 	DirectX::XMStoreFloat4x4(&projectionMatrix, DirectX::XMMatrixPerspectiveFovLH(fov, aspectRatio, nearClipDistance, farClipDistance));
+	UpdateFrustumPlanes();
 }
 
 void Camera::SetAmbientColor(DirectX::XMFLOAT3 ambientColor)
@@ -123,6 +162,16 @@ void Camera::UpdateViewMatrix()
 	DirectX::XMVECTOR worldUp = DirectX::XMVectorSet(0, 1, 0, 0);
 
 	DirectX::XMStoreFloat4x4(&viewMatrix, DirectX::XMMatrixLookToLH(position, forward, worldUp));
+	UpdateFrustumPlanes();
 }
 
-
+// --------------------------------------------------------
+// Pulls the frustum planes out of the view * projection
+// matrix (see ExtractFrustumPlanes)
+// --------------------------------------------------------
+void Camera::UpdateFrustumPlanes()
+{
+	DirectX::XMMATRIX view = DirectX::XMLoadFloat4x4(&viewMatrix);
+	DirectX::XMMATRIX projection = DirectX::XMLoadFloat4x4(&projectionMatrix);
+	ExtractFrustumPlanes(DirectX::XMMatrixMultiply(view, projection), frustumPlanes);
+}
@@ -14,6 +14,13 @@ public:
 	DirectX::XMFLOAT4X4	GetProjectionMatrix();
 	Transform* GetTransform();
 	DirectX::XMFLOAT3 GetAmbientColor();
+	float GetFov();
+	float GetAspectRatio();
+	float GetNearClipDistance();
+	float GetFarClipDistance();
+	bool IsOrthographic();
+	//world space planes (left, right, bottom, top, near, far) facing into the view
+	const DirectX::XMFLOAT4* GetFrustumPlanes();
 
 	//Setters
 	void SetViewMatrix(DirectX::XMFLOAT4X4);
@@ -29,8 +36,10 @@ private:
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projectionMatrix;
 	DirectX::XMFLOAT3 cameraAmbientColor;  //keeping ambient color as a property of the specific camera being used. 
+	DirectX::XMFLOAT4 frustumPlanes[6];
 
 	float fov;
+	float aspectRatio;
 	float nearClipDistance;
 	float farClipDistance;
 	float movementSpeed;
@@ -39,5 +48,6 @@ private:
 
 	//Private Updates
 	void UpdateViewMatrix();
+	void UpdateFrustumPlanes();
 };
 
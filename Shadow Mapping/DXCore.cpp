@@ -1,8 +1,14 @@
 #include "DXCore.h"
 #include "Input.h"
+#include "AllocationCounter.h"
 
 #include <WindowsX.h>
 #include <sstream>
+#include <stdio.h>
+
+// Frames the game gets to grow its containers to fit the scene,
+// after which a frame shouldn't allocate from the heap at all
+#define HEAP_ALLOCATION_WARMUP_FRAMES 10
 
 #include "ImGui/imgui.h"
 #include "ImGui/backends/imgui_impl_dx11.h"
@@ -49,6 +55,9 @@ DXCore::DXCore(
 	dxFeatureLevel(D3D_FEATURE_LEVEL_11_0),
 	fpsTimeElapsed(0),
 	fpsFrameCount(0),
+	framesRun(0),
+	heapAllocationsReported(false),
+	frameHeapAllocations(0),
 	previousTime(0),
 	currentTime(0),
 	hasFocus(true),
@@ -415,9 +424,27 @@ HRESULT DXCore::Run()
 			Input::GetInstance().Update();
 
 			// The game loop
+#if defined(DEBUG) || defined(_DEBUG)
+			unsigned long long heapAllocations = GetHeapAllocationCount();
+#endif
 			Update(deltaTime, totalTime);
 			Draw(deltaTime, totalTime);
 
+#if defined(DEBUG) || defined(_DEBUG)
+			frameHeapAllocations = GetHeapAllocationCount() - heapAllocations;
+
+			// Anything allocating every frame should be reusing memory instead,
+			// so warn (once) in the debugger if a frame after the warm up still does
+			framesRun++;
+			if (frameHeapAllocations > 0 && framesRun > HEAP_ALLOCATION_WARMUP_FRAMES && !heapAllocationsReported)
+			{
+				char warning[128];
+				snprintf(warning, sizeof(warning), "Frame %u made %llu heap allocations after warming up\n", framesRun, frameHeapAllocations);
+				OutputDebugStringA(warning);
+				heapAllocationsReported = true;
+			}
+#endif
+
 			// Frame is over, notify the input manager
 			Input::GetInstance().EndOfFrame();
 		}
@@ -72,6 +72,9 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV;
 
+	// Heap allocations made during the last Update() and Draw() (Debug builds only)
+	unsigned long long frameHeapAllocations;
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
@@ -88,6 +91,10 @@ private:
 	int fpsFrameCount;
 	float fpsTimeElapsed;
 
+	// Frames run so far, for telling warm up from steady state
+	unsigned int framesRun;
+	bool heapAllocationsReported;	// Only the first allocating frame gets logged
+
 	void UpdateTimer();			// Updates the timer for this frame
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
 };
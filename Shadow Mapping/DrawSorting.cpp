@@ -0,0 +1,125 @@
+#include "DrawSorting.h"
+
+static const unsigned int DrawKeyDepthShift = 0;
+static const unsigned int DrawKeyMeshShift = DrawKeyDepthShift + DrawKeyDepthBits;
+static const unsigned int DrawKeyMaterialShift = DrawKeyMeshShift + DrawKeyMeshBits;
+static const unsigned int DrawKeyShaderShift = DrawKeyMaterialShift + DrawKeyMaterialBits;
+static const unsigned int DrawKeyPassShift = DrawKeyShaderShift + DrawKeyShaderBits;
+static_assert(DrawKeyPassShift + DrawKeyPassBits == 64, "Draw key fields should fill 64 bits");
+
+// --------------------------------------------------------
+// Puts a value in its field of the key, wrapping it to fit
+// --------------------------------------------------------
+static unsigned long long KeyField(unsigned int value, unsigned int bits, unsigned int shift)
+{
+	return ((unsigned long long)value & ((1ull << bits) - 1)) << shift;
+}
+
+// --------------------------------------------------------
+// Gets a field back out of a key
+// --------------------------------------------------------
+static unsigned int GetKeyField(unsigned long long key, unsigned int bits, unsigned int shift)
+{
+	return (unsigned int)((key >> shift) & ((1ull << bits) - 1));
+}
+
+unsigned long long MakeDrawSortKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depthBucket)
+{
+	return
+		KeyField(pass, DrawKeyPassBits, DrawKeyPassShift) |
+		KeyField(shader, DrawKeyShaderBits, DrawKeyShaderShift) |
+		KeyField(material, DrawKeyMaterialBits, DrawKeyMaterialShift) |
+		KeyField(mesh, DrawKeyMeshBits, DrawKeyMeshShift) |
+		KeyField(depthBucket, DrawKeyDepthBits, DrawKeyDepthShift);
+}
+
+unsigned int GetDepthBucket(float distance, float maxDistance)
+{
+	const unsigned int maxBucket = (1u << DrawKeyDepthBits) - 1;
+	if (!(distance > 0.0f) || !(maxDistance > 0.0f))
+		return 0;
+	if (distance >= maxDistance)
+		return maxBucket;
+
+	return (unsigned int)(distance / maxDistance * maxBucket);
+}
+
+// --------------------------------------------------------
+// Counts every byte's values in one pass over the keys, then
+// does a counting sort per byte from the lowest up, bouncing
+// between the two arrays.  Bytes that are the same in every
+// key (most of the pass and shader bytes, usually) would
+// leave the order alone, so they're skipped.
+// --------------------------------------------------------
+DrawItem* SortDrawItems(DrawItem* items, DrawItem* scratch, size_t count)
+{
+	if (count < 2)
+		return items;
+
+	size_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned long long key = items[i].Key;
+		for (int b = 0; b < 8; b++)
+			histograms[b][(key >> (b * 8)) & 0xFF]++;
+	}
+
+	DrawItem* source = items;
+	DrawItem* destination = scratch;
+
+	for (int b = 0; b < 8; b++)
+	{
+		size_t* histogram = histograms[b];
+		if (histogram[(source[0].Key >> (b * 8)) & 0xFF] == count)
+			continue;
+
+		// Turn the counts into where each value's run starts
+		size_t offset = 0;
+		for (int v = 0; v < 256; v++)
+		{
+			size_t valueCount = histogram[v];
+			histogram[v] = offset;
+			offset += valueCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			destination[histogram[(source[i].Key >> (b * 8)) & 0xFF]++] = source[i];
+
+		DrawItem* swap = source;
+		source = destination;
+		destination = swap;
+	}
+
+	// An odd number of passes leaves the result in the scratch array
+	return source;
+}
+
+void SortDrawItems(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch)
+{
+	scratch.resize(items.size());
+	if (SortDrawItems(items.data(), scratch.data(), items.size()) != items.data())
+		items.swap(scratch);
+}
+
+DrawStateChanges CountDrawStateChanges(const DrawItem* items, size_t count)
+{
+	DrawStateChanges changes;
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned long long key = items[i].Key;
+		unsigned long long previous = i > 0 ? items[i - 1].Key : ~key;
+
+		if (GetKeyField(key, DrawKeyShaderBits, DrawKeyShaderShift) != GetKeyField(previous, DrawKeyShaderBits, DrawKeyShaderShift))
+			changes.Shaders++;
+		if (GetKeyField(key, DrawKeyMaterialBits, DrawKeyMaterialShift) != GetKeyField(previous, DrawKeyMaterialBits, DrawKeyMaterialShift))
+			changes.Materials++;
+		if (GetKeyField(key, DrawKeyMeshBits, DrawKeyMeshShift) != GetKeyField(previous, DrawKeyMeshBits, DrawKeyMeshShift))
+			changes.Meshes++;
+	}
+	return changes;
+}
+
+DrawStateChanges CountDrawStateChanges(const std::vector<DrawItem>& items)
+{
+	return CountDrawStateChanges(items.data(), items.size());
+}
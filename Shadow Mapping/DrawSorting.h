@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// --------------------------------------------------------
+// A 64-bit draw sort key packs, from the most significant
+// bits down:
+//
+//   pass (4) | shader (16) | material (16) | mesh (12) | depth (16)
+//
+// so sorting by key groups draws by pass, then shader, then
+// material, then mesh, and goes front to back within those.
+// Values wider than their field wrap around, which can only
+// interleave groups - what gets bound still comes from the
+// draw itself, never from the key.
+// --------------------------------------------------------
+static const unsigned int DrawKeyPassBits = 4;
+static const unsigned int DrawKeyShaderBits = 16;
+static const unsigned int DrawKeyMaterialBits = 16;
+static const unsigned int DrawKeyMeshBits = 12;
+static const unsigned int DrawKeyDepthBits = 16;
+
+enum DrawPass
+{
+	DRAW_PASS_SHADOW,
+	DRAW_PASS_OPAQUE,
+	DRAW_PASS_COUNT
+};
+
+// One queued draw: its key and the index of what to draw
+struct DrawItem
+{
+	unsigned long long Key;
+	unsigned int Index;
+};
+
+// How often the shaders, material and mesh change over a draw list
+struct DrawStateChanges
+{
+	unsigned int Shaders = 0;
+	unsigned int Materials = 0;
+	unsigned int Meshes = 0;
+};
+
+unsigned long long MakeDrawSortKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depthBucket);
+
+// Quantizes a distance in [0, maxDistance] to a depth bucket (clamped)
+unsigned int GetDepthBucket(float distance, float maxDistance);
+
+// Sorts by key with an LSD radix sort, a byte at a time.  Equal keys keep
+// their order.  scratch needs room for count items, and the sorted list
+// ends up in whichever of the two arrays is returned.
+DrawItem* SortDrawItems(DrawItem* items, DrawItem* scratch, size_t count);
+// Same, for a list in a vector.  scratch is resized to match and just
+// saves reallocating.
+void SortDrawItems(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch);
+
+// Counts the changes drawing the list in its current order, from the keys.
+// The first draw counts as a change of everything.
+DrawStateChanges CountDrawStateChanges(const DrawItem* items, size_t count);
+DrawStateChanges CountDrawStateChanges(const std::vector<DrawItem>& items);
@@ -1,16 +1,23 @@
 #include "Entity.h"
+#include <cmath>
+
+using namespace DirectX;
+
+float Entity::LodScreenSizes[MESH_MAX_LODS] = { 0.0f, 0.4f, 0.2f, 0.1f };
+float Entity::LodHysteresis = 0.1f;
 
 Entity::Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
 {
 	this->mesh = mesh;
 	this->material = material;
+	this->lod = 0;
 }
 
 Entity::~Entity() {}
 
-std::shared_ptr<Mesh> Entity::GetMesh()
+Mesh* Entity::GetMesh()
 {
-	return mesh;
+	return mesh.get();
 }
 
 Transform* Entity::GetTransform()
@@ -18,16 +25,99 @@ Transform* Entity::GetTransform()
 	return &transform;
 }
 
-std::shared_ptr<Material> Entity::GetMaterial()
+Material* Entity::GetMaterial()
+{
+	return material.get();
+}
+
+unsigned int Entity::GetLod()
+{
+	return lod;
+}
+
+// --------------------------------------------------------
+// Moves the mesh's local bounds into world space.  The box
+// extents are the local extents run through the absolute
+// value of the world matrix, so rotated boxes stay conservative.
+// --------------------------------------------------------
+void Entity::GetWorldBounds(XMFLOAT3& center, float& radius, XMFLOAT3& extents)
+{
+	XMFLOAT3 localCenter = mesh->GetBoundsCenter();
+	XMFLOAT3 boundsMax = mesh->GetBoundsMax();
+	XMFLOAT4X4 world = transform.GetWorldMatrix();
+
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&localCenter), worldMatrix));
+
+	//largest axis scale, including any parents'
+	XMVECTOR scale = XMVectorMax(XMVector3Length(worldMatrix.r[0]),
+		XMVectorMax(XMVector3Length(worldMatrix.r[1]), XMVector3Length(worldMatrix.r[2])));
+	radius = mesh->GetBoundsRadius() * XMVectorGetX(scale);
+
+	XMVECTOR localExtents = XMVectorSubtract(XMLoadFloat3(&boundsMax), XMLoadFloat3(&localCenter));
+	XMMATRIX absWorld(
+		XMVectorAbs(worldMatrix.r[0]),
+		XMVectorAbs(worldMatrix.r[1]),
+		XMVectorAbs(worldMatrix.r[2]),
+		XMVectorZero());
+	XMStoreFloat3(&extents, XMVector3TransformNormal(localExtents, absWorld));
+}
+
+// --------------------------------------------------------
+// Projects the bounding sphere of the mesh to get the fraction
+// of the screen height it covers, then steps the current LOD
+// towards the matching level.  A level only changes once the
+// size is LodHysteresis past its threshold, so an entity sitting
+// right on a threshold doesn't pop back and forth every frame.
+// --------------------------------------------------------
+void Entity::UpdateLod(Camera* camera)
 {
-	return material;
+	unsigned int lodCount = mesh->GetLodCount();
+	if (lodCount <= 1 || camera->IsOrthographic())
+	{
+		lod = 0;
+		return;
+	}
+
+	XMFLOAT3 center;
+	XMFLOAT3 extents;
+	float radius;
+	GetWorldBounds(center, radius, extents);
+
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat3(&cameraPosition))));
+
+	//inside the sphere always gets full detail
+	if (distance <= radius)
+	{
+		lod = 0;
+		return;
+	}
+
+	//projected diameter over the height of the view
+	float screenSize = radius / (distance * tanf(camera->GetFov() * 0.5f));
+
+	if (lod >= lodCount)
+		lod = lodCount - 1;
+
+	while (lod + 1 < lodCount && screenSize < LodScreenSizes[lod + 1] * (1.0f - LodHysteresis))
+		lod++;
+
+	while (lod > 0 && screenSize > LodScreenSizes[lod] * (1.0f + LodHysteresis))
+		lod--;
 }
 
-void Entity::Draw(std::shared_ptr<Camera> camera)
+void Entity::Draw(unsigned int lodBias)
 {
-	//prep material for drawing
-	material->PrepareMaterialForDraw(&transform, camera);
+	//per-object data for the material's shaders
+	material->SetObjectData(&transform);
 
 	//Draw mesh after all shader variables have been set
-	mesh->Draw();
+	mesh->DrawBound(lod + lodBias);
+}
+
+void Entity::DrawMesh(unsigned int lodBias)
+{
+	//the mesh clamps the level to the ones it has
+	mesh->Draw(lod + lodBias);
 }
\ No newline at end of file
@@ -12,15 +12,34 @@ public:
 	~Entity();
 
 	//Getters
-	std::shared_ptr<Mesh> GetMesh();
+	//(borrowed - the entity keeps them alive)
+	Mesh* GetMesh();
 	Transform* GetTransform();
-	std::shared_ptr<Material> GetMaterial();
-	
-	//Draw (option 2 for now)
-	void Draw(std::shared_ptr<Camera> camera);
+	Material* GetMaterial();
+	unsigned int GetLod();
+
+	//World space bounding sphere and box (sharing the same center) of the mesh
+	void GetWorldBounds(DirectX::XMFLOAT3& center, float& radius, DirectX::XMFLOAT3& extents);
+
+	//Picks a level of detail from how big the entity appears to the camera
+	void UpdateLod(Camera* camera);
+
+	//Draw (option 2 for now) - the material and mesh must already be
+	//bound (Material::Bind, Mesh::Bind)
+	//lodBias draws a coarser level than the selected one
+	void Draw(unsigned int lodBias = 0);
+	//Draws just the mesh, for passes that set up their own shaders
+	void DrawMesh(unsigned int lodBias = 0);
+
+	//LOD i is used once the entity's bounding sphere covers less than
+	//this fraction of the screen height (index 0 is unused)
+	static float LodScreenSizes[MESH_MAX_LODS];
+	//How far past a threshold the screen size must move before switching
+	static float LodHysteresis;
 private:
 	Transform transform;
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+	unsigned int lod;
 };
 
@@ -0,0 +1,61 @@
+#include "FrameAllocator.h"
+
+#include <stdint.h>
+
+// Rounds an address up to a power of two alignment
+static uintptr_t AlignAddress(uintptr_t address, size_t alignment)
+{
+	return (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+FrameAllocator::FrameAllocator(size_t capacity)
+	: block(capacity), used(0), lastFrameUsed(0), overflowBytes(0)
+{
+}
+
+FrameAllocator::~FrameAllocator() {}
+
+// --------------------------------------------------------
+// Grows the block (doubling) when the frame that just ended
+// spilled onto the heap, so the next one fits in one piece
+// --------------------------------------------------------
+void FrameAllocator::Reset()
+{
+	lastFrameUsed = used + overflowBytes;
+
+	if (overflowBytes > 0)
+	{
+		size_t newCapacity = block.size() > 0 ? block.size() : 1024;
+		while (newCapacity < lastFrameUsed)
+			newCapacity *= 2;
+
+		block = std::vector<unsigned char>(newCapacity);
+		overflowBlocks.clear();
+		overflowBytes = 0;
+	}
+
+	used = 0;
+}
+
+void FrameAllocator::Reserve(size_t capacity)
+{
+	if (capacity > block.size())
+		block = std::vector<unsigned char>(capacity);
+	used = 0;
+}
+
+void* FrameAllocator::Allocate(size_t size, size_t alignment)
+{
+	uintptr_t base = (uintptr_t)block.data();
+	uintptr_t start = AlignAddress(base + used, alignment);
+	if (start + size <= base + block.size())
+	{
+		used = (size_t)(start - base) + size;
+		return (void*)start;
+	}
+
+	// Didn't fit, so this frame's extra comes from the heap
+	overflowBlocks.emplace_back(new unsigned char[size + alignment]);
+	overflowBytes += size + alignment;
+	return (void*)AlignAddress((uintptr_t)overflowBlocks.back().get(), alignment);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Linear allocator for data that only lives for one frame.
+// Allocating just bumps an offset into one block, and Reset()
+// throws everything away at once - nothing is freed or
+// destructed one at a time, so only put plain data in it.
+//
+// If a frame needs more than the block holds, the rest comes
+// from the heap and the next Reset() grows the block to fit.
+// Reserve() the most a frame can use up front and it never
+// touches the heap at all.
+// --------------------------------------------------------
+class FrameAllocator
+{
+public:
+	FrameAllocator(size_t capacity = 64 * 1024);
+	~FrameAllocator();
+
+	// Starts a new frame, invalidating everything allocated before
+	void Reset();
+
+	// Grows the block to at least this many bytes - only between frames,
+	// as it invalidates everything allocated since the last Reset()
+	void Reserve(size_t capacity);
+
+	// Uninitialized memory that's good until the next Reset()
+	void* Allocate(size_t size, size_t alignment = 16);
+
+	template<typename T>
+	T* Allocate(size_t count) { return (T*)Allocate(sizeof(T) * count, alignof(T)); }
+
+	size_t GetCapacity() { return block.size(); }
+	// Bytes the frame before the last Reset() used, overflow included
+	size_t GetLastFrameUsed() { return lastFrameUsed; }
+
+private:
+	std::vector<unsigned char> block;
+	size_t used;
+	size_t lastFrameUsed;
+
+	// Heap allocations for whatever didn't fit this frame
+	std::vector<std::unique_ptr<unsigned char[]>> overflowBlocks;
+	size_t overflowBytes;
+};
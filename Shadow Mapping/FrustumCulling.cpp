@@ -0,0 +1,126 @@
+#include "FrustumCulling.h"
+
+using namespace DirectX;
+
+void CullingBounds::Resize(size_t count)
+{
+	// Padding entries are zero sized spheres at the origin; they're
+	// never reported since only the first Count results are used
+	size_t padded = (count + 3) & ~(size_t)3;
+	CenterX.resize(padded, 0.0f);
+	CenterY.resize(padded, 0.0f);
+	CenterZ.resize(padded, 0.0f);
+	Radius.resize(padded, 0.0f);
+	ExtentX.resize(padded, 0.0f);
+	ExtentY.resize(padded, 0.0f);
+	ExtentZ.resize(padded, 0.0f);
+	Count = count;
+}
+
+void CullingBounds::Set(size_t index, XMFLOAT3 center, float radius, XMFLOAT3 extents)
+{
+	CenterX[index] = center.x;
+	CenterY[index] = center.y;
+	CenterZ[index] = center.z;
+	Radius[index] = radius;
+	ExtentX[index] = extents.x;
+	ExtentY[index] = extents.y;
+	ExtentZ[index] = extents.z;
+}
+
+// --------------------------------------------------------
+// Gribb & Hartmann - each plane is a sum or difference of
+// the matrix's columns.  D3D clip space z runs from 0 to 1,
+// so the near plane is just the third column.
+// --------------------------------------------------------
+void ExtractFrustumPlanes(FXMMATRIX viewProjection, XMFLOAT4* planes)
+{
+	//rows of the transpose are the columns of view * projection
+	XMMATRIX columns = XMMatrixTranspose(viewProjection);
+
+	XMVECTOR unnormalized[6] =
+	{
+		XMVectorAdd(columns.r[3], columns.r[0]),		//left
+		XMVectorSubtract(columns.r[3], columns.r[0]),	//right
+		XMVectorAdd(columns.r[3], columns.r[1]),		//bottom
+		XMVectorSubtract(columns.r[3], columns.r[1]),	//top
+		columns.r[2],									//near
+		XMVectorSubtract(columns.r[3], columns.r[2]),	//far
+	};
+
+	for (int i = 0; i < 6; i++)
+	{
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(unnormalized[i]));
+	}
+}
+
+// --------------------------------------------------------
+// For each plane, the signed distance to the shared center
+// is compared against both the sphere's radius and the box's
+// projected radius (|n.x| * e.x + |n.y| * e.y + |n.z| * e.z).
+// Whichever is smaller is the tighter fit, so the object is
+// outside if the distance is below minus that value.
+//
+// 4 objects are handled per iteration, with the planes
+// splatted across the lanes up front.
+// --------------------------------------------------------
+size_t CullBounds(const XMFLOAT4* planes, const CullingBounds& bounds, std::vector<unsigned char>& visible)
+{
+	visible.resize(bounds.Count);
+	if (bounds.Count == 0)
+		return 0;
+
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	XMVECTOR planeAbsX[6], planeAbsY[6], planeAbsZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = XMVectorReplicate(planes[p].x);
+		planeY[p] = XMVectorReplicate(planes[p].y);
+		planeZ[p] = XMVectorReplicate(planes[p].z);
+		planeW[p] = XMVectorReplicate(planes[p].w);
+		planeAbsX[p] = XMVectorAbs(planeX[p]);
+		planeAbsY[p] = XMVectorAbs(planeY[p]);
+		planeAbsZ[p] = XMVectorAbs(planeZ[p]);
+	}
+
+	size_t visibleCount = 0;
+	for (size_t i = 0; i < bounds.Count; i += 4)
+	{
+		XMVECTOR cx = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterX[i]);
+		XMVECTOR cy = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterY[i]);
+		XMVECTOR cz = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterZ[i]);
+		XMVECTOR radius = XMLoadFloat4((const XMFLOAT4*)&bounds.Radius[i]);
+		XMVECTOR ex = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentX[i]);
+		XMVECTOR ey = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentY[i]);
+		XMVECTOR ez = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentZ[i]);
+
+		// Lanes become all ones once they're outside any plane
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(cx, planeX[p],
+				XMVectorMultiplyAdd(cy, planeY[p],
+				XMVectorMultiplyAdd(cz, planeZ[p], planeW[p])));
+
+			XMVECTOR boxRadius = XMVectorMultiplyAdd(ex, planeAbsX[p],
+				XMVectorMultiplyAdd(ey, planeAbsY[p],
+				XMVectorMultiply(ez, planeAbsZ[p])));
+
+			XMVECTOR fit = XMVectorMin(radius, boxRadius);
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, XMVectorNegate(fit)));
+		}
+
+		XMUINT4 lanes;
+		XMStoreUInt4(&lanes, outside);
+		const unsigned int results[4] = { lanes.x, lanes.y, lanes.z, lanes.w };
+
+		size_t laneCount = (bounds.Count - i < 4) ? bounds.Count - i : 4;
+		for (size_t lane = 0; lane < laneCount; lane++)
+		{
+			visible[i + lane] = results[lane] ? 0 : 1;
+			visibleCount += visible[i + lane];
+		}
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// World space bounds of many objects, packed component by
+// component so 4 objects can be tested at once.  Each object
+// has both a bounding sphere and an axis-aligned box sharing
+// the same center; an object is culled if either one is
+// completely outside a frustum plane.
+//
+// The arrays are padded to a multiple of 4 so the tests never
+// need a scalar tail.
+// --------------------------------------------------------
+struct CullingBounds
+{
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> Radius;
+	std::vector<float> ExtentX;
+	std::vector<float> ExtentY;
+	std::vector<float> ExtentZ;
+	size_t Count;
+
+	CullingBounds() : Count(0) {}
+	void Resize(size_t count);
+	void Set(size_t index, DirectX::XMFLOAT3 center, float radius, DirectX::XMFLOAT3 extents);
+};
+
+// Pulls the 6 planes (left, right, bottom, top, near, far) out of a
+// view * projection matrix, perspective or orthographic, normalized and
+// facing inwards.  A point p is inside a plane when dot(plane.xyz, p) +
+// plane.w >= 0.
+void ExtractFrustumPlanes(DirectX::FXMMATRIX viewProjection, DirectX::XMFLOAT4* planes);
+
+// Tests every object against the 6 planes (see Camera::GetFrustumPlanes).
+// visible[i] is set to 1 for objects inside or touching the frustum and
+// 0 for culled ones.  Returns the number of visible objects.
+size_t CullBounds(const DirectX::XMFLOAT4* planes, const CullingBounds& bounds, std::vector<unsigned char>& visible);
@@ -3,6 +3,8 @@
 #include "Input.h"
 #include "Helpers.h"
 #include "Entity.h"
+#include "TransformSystem.h"
+#include "ShaderLayouts.h"
 
 #include "ImGui/imgui.h"
 #include "ImGui/backends/imgui_impl_dx11.h"
@@ -12,6 +14,9 @@
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
 
+#include <algorithm>
+#include <stdio.h>
+
 // For the DirectX Math library
 using namespace DirectX;
 
@@ -137,10 +142,51 @@ void Game::LoadShaders()
 	pixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"PixelShader.cso").c_str());
 	
 	shadowVertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader_Shadow.cso").c_str());
+	instancedVertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader_Instanced.cso").c_str());
+	shadowInstancedVertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader_Shadow_Instanced.cso").c_str());
 	customPixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"CustomPixelShader.cso").c_str());
 	
 	skyVertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader_Sky.cso").c_str());
 	skyPixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"PixelShader_Sky.cso").c_str());
+
+	//shadow and light data for the lit shaders
+	perFrameVSHandle = vertexShader->GetBufferHandle("PerFrame");
+	perFramePSHandle = pixelShader->GetBufferHandle("PerFrame");
+	shadowMapsHandle = pixelShader->GetShaderResourceViewHandle("ShadowMaps");
+	shadowSamplerHandle = pixelShader->GetSamplerHandle("ShadowSampler");
+
+	//the shadow map pass
+	shadowPassPerFrameHandle = shadowVertexShader->GetBufferHandle("PerFrame");
+	shadowPassPerObjectHandle = shadowVertexShader->GetBufferHandle("PerObject");
+
+	//the instanced shaders only have per frame data
+	perFrameInstancedVSHandle = instancedVertexShader->GetBufferHandle("PerFrame");
+	shadowInstancedPerFrameHandle = shadowInstancedVertexShader->GetBufferHandle("PerFrame");
+	instanceBuffer = std::make_shared<InstanceBuffer>(device, context);
+
+	//the shaders rewritten for every draw sub-allocate from one ring buffer,
+	//if the driver can bind constant buffers with offsets
+	constantBufferRing = std::make_shared<SimpleConstantBufferRing>(device, context);
+	if (constantBufferRing->IsSupported())
+	{
+		vertexShader->SetConstantBufferRing(constantBufferRing.get());
+		pixelShader->SetConstantBufferRing(constantBufferRing.get());
+		shadowVertexShader->SetConstantBufferRing(constantBufferRing.get());
+		instancedVertexShader->SetConstantBufferRing(constantBufferRing.get());
+		shadowInstancedVertexShader->SetConstantBufferRing(constantBufferRing.get());
+	}
+
+	//every shader binds through one cache of the context's state,
+	//so binding what's already bound never reaches the context
+	stateCache = std::make_shared<SimpleStateCache>(context);
+	vertexShader->SetStateCache(stateCache.get());
+	pixelShader->SetStateCache(stateCache.get());
+	shadowVertexShader->SetStateCache(stateCache.get());
+	instancedVertexShader->SetStateCache(stateCache.get());
+	shadowInstancedVertexShader->SetStateCache(stateCache.get());
+	customPixelShader->SetStateCache(stateCache.get());
+	skyVertexShader->SetStateCache(stateCache.get());
+	skyPixelShader->SetStateCache(stateCache.get());
 }
 
 void Game::LoadTexturesAndSamplerState()
@@ -225,6 +271,10 @@ void Game::CreateMaterials()
 	materials[2]->AddSampler("BasicSampler", samplerState);
 	materials[3]->AddSampler("BasicSampler", samplerState);
 	materials[4]->AddSampler("BasicSampler", samplerState);
+
+	//all of them can be drawn instanced
+	for (auto& m : materials)
+		m->SetInstancedVertexShader(instancedVertexShader);
 }
 
 // --------------------------------------------------------
@@ -346,6 +396,30 @@ void Game::CreateMeshesAndEntitites()
 		gameEntities[5]->GetTransform()->SetPosition(0.0f, -3.0f, 0.0f);
 		gameEntities[5]->GetTransform()->SetScale(20.0f, 1.0f, 20.0f);
 	}
+
+	//nothing has been culled until the first frame is drawn
+	visibleEntityCount = gameEntities.size();
+	culledEntityCount = 0;
+	sortDraws = true;
+	drawInstanced = true;
+	shadowsInstanced = false;
+	instanceBatchCount = 0;
+	shadowInstanceBatchCount = 0;
+
+	//same for the shadow casters, in every slice that might be used
+	for (int i = 0; i < MAX_SHADOW_MAPS; i++)
+		shadowCasterVisible[i].assign(gameEntities.size(), 1);
+
+	//the most any frame can batch, whatever the shadow settings: every
+	//entity in the main pass, and every entity in every shadow map slice
+	instanceBatcher.Reserve(gameEntities.size(), gameEntities.size() * MAX_SHADOW_MAPS);
+	instanceBuffer->Reserve((unsigned int)(std::max)(
+		gameEntities.size() * sizeof(InstanceData),
+		gameEntities.size() * MAX_SHADOW_MAPS * sizeof(XMFLOAT4X4)));
+
+	//each pass keys and sorts at most every entity, which takes two draw
+	//lists (plus alignment) from the frame allocator
+	frameAllocator.Reserve(4 * (gameEntities.size() * sizeof(DrawItem) + alignof(DrawItem)));
 }
 
 void Game::CreateLights()
@@ -405,52 +479,28 @@ void Game::CreateShadowMapResources()
 {
 	// Create shadow requirements ------------------------------------------
 	shadowMapResolution = 1024;
-	shadowProjectionSize = 30.0f;
+	shadowLodBias = 1;
+	shadowCascadeCount = 3;
+	shadowDistance = 60.0f;
+	shadowSplitLambda = 0.75f;
+	shadowCasterDistance = 50.0f;
+	for (int c = 0; c <= MAX_SHADOW_CASCADES; c++)
+		shadowCascadeSplits[c] = 0.0f;
+	cullShadowCasters = true;
+	for (int i = 0; i < MAX_SHADOW_MAPS; i++)
+		shadowCasterCounts[i] = 0;
 	
-	//Init 1st Shadow Map stuff
-	{
-		Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
-
-		// Create the actual texture that will be the shadow map
-		D3D11_TEXTURE2D_DESC shadowDesc = {};
-		shadowDesc.Width = shadowMapResolution;
-		shadowDesc.Height = shadowMapResolution;
-		shadowDesc.ArraySize = 1;
-		shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
-		shadowDesc.CPUAccessFlags = 0;
-		shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-		shadowDesc.MipLevels = 1;
-		shadowDesc.MiscFlags = 0;
-		shadowDesc.SampleDesc.Count = 1;
-		shadowDesc.SampleDesc.Quality = 0;
-		shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-		device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
-
-		// Create the depth/stencil
-		D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-		shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-		shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-		shadowDSDesc.Texture2D.MipSlice = 0;
-		device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowDSV1.GetAddressOf());
+	shadowMapCount = 0;
 
-		// Create the SRV for the shadow map
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MipLevels = 1;
-		srvDesc.Texture2D.MostDetailedMip = 0;
-		device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowSRV1.GetAddressOf());
-	}	
-	
-	//Init 2nd Shadow Map stuff
+	//One texture with a slice per shadow map
 	{
 		Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
 
-		// Create the actual texture that will be the shadow map
+		// Create the actual texture that will hold the shadow maps
 		D3D11_TEXTURE2D_DESC shadowDesc = {};
 		shadowDesc.Width = shadowMapResolution;
 		shadowDesc.Height = shadowMapResolution;
-		shadowDesc.ArraySize = 1;
+		shadowDesc.ArraySize = MAX_SHADOW_MAPS;
 		shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 		shadowDesc.CPUAccessFlags = 0;
 		shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
@@ -461,55 +511,27 @@ void Game::CreateShadowMapResources()
 		shadowDesc.Usage = D3D11_USAGE_DEFAULT;
 		device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
 
-		// Create the depth/stencil
-		D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-		shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-		shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-		shadowDSDesc.Texture2D.MipSlice = 0;
-		device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowDSV2.GetAddressOf());
-
-		// Create the SRV for the shadow map
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MipLevels = 1;
-		srvDesc.Texture2D.MostDetailedMip = 0;
-		device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowSRV2.GetAddressOf());
-	}	
-	
-	//Init 3rd Shadow Map stuff
-	{
-		Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
-
-		// Create the actual texture that will be the shadow map
-		D3D11_TEXTURE2D_DESC shadowDesc = {};
-		shadowDesc.Width = shadowMapResolution;
-		shadowDesc.Height = shadowMapResolution;
-		shadowDesc.ArraySize = 1;
-		shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
-		shadowDesc.CPUAccessFlags = 0;
-		shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-		shadowDesc.MipLevels = 1;
-		shadowDesc.MiscFlags = 0;
-		shadowDesc.SampleDesc.Count = 1;
-		shadowDesc.SampleDesc.Quality = 0;
-		shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-		device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
-
-		// Create the depth/stencil
-		D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-		shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-		shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-		shadowDSDesc.Texture2D.MipSlice = 0;
-		device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowDSV3.GetAddressOf());
+		// Create a depth/stencil per slice, to render each shadow map
+		for (unsigned int i = 0; i < MAX_SHADOW_MAPS; i++)
+		{
+			D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
+			shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+			shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+			shadowDSDesc.Texture2DArray.MipSlice = 0;
+			shadowDSDesc.Texture2DArray.FirstArraySlice = i;
+			shadowDSDesc.Texture2DArray.ArraySize = 1;
+			device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowMapDSVs[i].GetAddressOf());
+		}
 
-		// Create the SRV for the shadow map
+		// Create one SRV for the whole array, for the pixel shader
 		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 		srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MipLevels = 1;
-		srvDesc.Texture2D.MostDetailedMip = 0;
-		device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowSRV3.GetAddressOf());
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MipLevels = 1;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = MAX_SHADOW_MAPS;
+		device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowMapsSRV.GetAddressOf());
 	}
 
 	// Create the special "comparison" sampler state for shadows
@@ -535,13 +557,41 @@ void Game::CreateShadowMapResources()
 	shadowRastDesc.SlopeScaledDepthBias = 1.0f;
 	device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
 
-	// Create Projection Matrix
-	XMMATRIX shProj = XMMatrixOrthographicLH(shadowProjectionSize, shadowProjectionSize, 0.1f, 100.0f);
-	XMStoreFloat4x4(&shadowProjectionMatrix, shProj);
+	// The cascades' projections are fitted to the camera every frame
+}
+
+// --------------------------------------------------------
+// Gives each shadow casting directional light a run of
+// slices in the shadow map array, one per cascade, in light
+// order until the slices run out.  Lights past the budget
+// (and every other light) get none and are drawn unshadowed.
+// --------------------------------------------------------
+void Game::AssignShadowMaps()
+{
+	shadowMapCount = 0;
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		Light& light = lights[i];
+		light.ShadowMapIndex = -1;
+		light.ShadowMapCount = 0;
+
+		if ((int)i >= numOfLightsInGame || !light.CastsShadows || light.Type != LIGHT_TYPE_DIRECTIONAL)
+			continue;
+		if (shadowMapCount + shadowCascadeCount > MAX_SHADOW_MAPS)
+			continue;
+
+		light.ShadowMapIndex = shadowMapCount;
+		light.ShadowMapCount = shadowCascadeCount;
+		for (int c = 0; c < shadowCascadeCount; c++)
+			shadowMapLights[shadowMapCount++] = (unsigned int)i;
+	}
 }
 
 void Game::RenderShadowMaps()
 {
+	//lights can start or stop casting shadows any frame
+	AssignShadowMaps();
+
 	// Need to create a viewport that matches the shadow map resolution
 	D3D11_VIEWPORT viewport = {};
 	viewport.TopLeftX = 0.0f;
@@ -551,124 +601,112 @@ void Game::RenderShadowMaps()
 	viewport.MinDepth = 0.0f;
 	viewport.MaxDepth = 1.0f;
 	context->RSSetViewports(1, &viewport);
-	
-	float dScale = -1 * 20.0f;
-	
-	// Render 1st shadow map
+
+	//split the camera's view into cascades and put a sphere around
+	//each slice - every light fits its cascades to the same spheres
+	float cascadeFar = (std::min)(shadowDistance, mainCamera->GetFarClipDistance());
+	ComputeCascadeSplits(mainCamera->GetNearClipDistance(), cascadeFar, shadowCascadeCount, shadowSplitLambda, shadowCascadeSplits);
+
+	XMFLOAT4X4 cameraView = mainCamera->GetViewMatrix();
+	XMMATRIX cameraWorld = XMMatrixInverse(0, XMLoadFloat4x4(&cameraView));
+	float tanHalfFov = tanf(mainCamera->GetFov() * 0.5f);
+	XMFLOAT3 cascadeCenters[MAX_SHADOW_CASCADES];
+	float cascadeRadii[MAX_SHADOW_CASCADES];
+	XMFLOAT3 cascadeCorners[MAX_SHADOW_CASCADES][8];
+	for (int c = 0; c < shadowCascadeCount; c++)
 	{
-		// Initial pipeline setup - No RTV necessary - Clear shadow map
-		context->OMSetRenderTargets(0, 0, shadowDSV1.Get());
-		context->ClearDepthStencilView(shadowDSV1.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-		context->RSSetState(shadowRasterizer.Get());
-
-		// Update View matrix to light 1
-		XMMATRIX shView = XMMatrixLookAtLH(
-			XMVectorSet(dScale * lights[0].Direction.x, dScale * lights[0].Direction.y, dScale * lights[0].Direction.z, 0.0f),
-			XMVectorSet(0, 0, 0, 0),
-			XMVectorSet(0, 1, 0, 0));
-		XMStoreFloat4x4(&shadowViewMatrix1, shView);
-
-		// Turn on our shadow map Vertex Shader
-		// and turn OFF the pixel shader entirely
-		shadowVertexShader->SetShader();
-		shadowVertexShader->SetMatrix4x4("view", shadowViewMatrix1);
-		shadowVertexShader->SetMatrix4x4("projection", shadowProjectionMatrix);
-		context->PSSetShader(0, 0, 0); // No PS
-
-		//create camera to pass to entity to draw. This camera is actually the light.
-		std::shared_ptr<Camera> lightCamera = std::make_shared<Camera>(1.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), DirectX::XM_PI / 3, 0.01f, 1000.0f, 1.0f, 5.0f, false);
-
-		//set camera to the lights orientation and set projection to shadowMap viewport values
-		lightCamera->SetViewMatrix(shadowViewMatrix1);
-		lightCamera->SetProjectionMatrix(shadowProjectionMatrix);
-
-		// Loop and draw all entities
-		for (auto& e : gameEntities)
-		{
-			shadowVertexShader->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-			shadowVertexShader->CopyAllBufferData();
+		float centerZ;
+		GetFrustumSliceSphere(tanHalfFov, mainCamera->GetAspectRatio(), shadowCascadeSplits[c], shadowCascadeSplits[c + 1], centerZ, cascadeRadii[c]);
+		XMStoreFloat3(&cascadeCenters[c], XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, centerZ, 1.0f), cameraWorld));
+		GetFrustumSliceCorners(tanHalfFov, mainCamera->GetAspectRatio(), shadowCascadeSplits[c], shadowCascadeSplits[c + 1], cameraWorld, cascadeCorners[c]);
+	}
+
+	//fit each light's view around its cascades, and find the entities
+	//that can shadow the part of the slice the camera sees
+	for (unsigned int i = 0; i < shadowMapCount; i++)
+	{
+		const Light& light = lights[shadowMapLights[i]];
+		unsigned int cascade = i - light.ShadowMapIndex;
+		shadowCascades[i] = FitShadowCascade(cascadeCenters[cascade], cascadeRadii[cascade], light.Direction, shadowMapResolution, shadowCasterDistance);
 
-			// Draw the mesh
-			e->Draw(lightCamera);
+		if (cullShadowCasters)
+		{
+			XMFLOAT4 casterPlanes[6];
+			GetShadowCasterPlanes(shadowCascades[i], cascadeCorners[cascade], 8, casterPlanes);
+			shadowCasterCounts[i] = CullBounds(casterPlanes, entityBounds, shadowCasterVisible[i]);
+		}
+		else
+		{
+			shadowCasterVisible[i].assign(gameEntities.size(), 1);
+			shadowCasterCounts[i] = gameEntities.size();
 		}
 	}
 
-	// Render 2nd shadow map
+	//every shadow map's casters go into one set of instance batches,
+	//sorted by mesh and level of detail (which takes the place of depth
+	//in the sort key) once, then split up by which maps they're in
+	shadowsInstanced = false;
+	shadowInstanceBatchCount = 0;
+	if (drawInstanced && shadowMapCount > 0)
 	{
-		// Initial pipeline setup - No RTV necessary - Clear shadow map
-		context->OMSetRenderTargets(0, 0, shadowDSV2.Get());
-		context->ClearDepthStencilView(shadowDSV2.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-		context->RSSetState(shadowRasterizer.Get());
-
-		// Update View matrix to light 2
-		XMMATRIX shView = XMMatrixLookAtLH(
-			XMVectorSet(dScale * lights[1].Direction.x, dScale * lights[1].Direction.y, dScale * lights[1].Direction.z, 0.0f),
-			XMVectorSet(0, 0, 0, 0),
-			XMVectorSet(0, 1, 0, 0));
-		XMStoreFloat4x4(&shadowViewMatrix2, shView);
-
-		// Turn on our shadow map Vertex Shader
-		// and turn OFF the pixel shader entirely
-		shadowVertexShader->SetShader();
-		shadowVertexShader->SetMatrix4x4("view", shadowViewMatrix2);
-		shadowVertexShader->SetMatrix4x4("projection", shadowProjectionMatrix);
-		context->PSSetShader(0, 0, 0); // No PS
-
-		//create camera to pass to entity to draw. This camera is actually the light.
-		std::shared_ptr<Camera> lightCamera = std::make_shared<Camera>(1.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), DirectX::XM_PI / 3, 0.01f, 1000.0f, 1.0f, 5.0f, false);
-
-		//set camera to the lights orientation and set projection to shadowMap viewport values
-		lightCamera->SetViewMatrix(shadowViewMatrix2);
-		lightCamera->SetProjectionMatrix(shadowProjectionMatrix);
-
-		// Loop and draw all entities
-		for (auto& e : gameEntities)
+		auto shadowLod = [this](Entity* e)
+		{
+			return (std::min)(e->GetLod() + shadowLodBias, e->GetMesh()->GetLodCount() - 1);
+		};
+
+		size_t entityCount = gameEntities.size();
+		size_t casterCount = 0;
+		DrawItem* shadowDrawItems = frameAllocator.Allocate<DrawItem>(entityCount);
+		for (size_t i = 0; i < entityCount; i++)
 		{
-			shadowVertexShader->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-			shadowVertexShader->CopyAllBufferData();
+			bool casts = false;
+			for (unsigned int s = 0; s < shadowMapCount; s++)
+				casts = casts || shadowCasterVisible[s][i];
+			if (!casts)
+				continue;
+
+			Entity* e = gameEntities[i].get();
+			unsigned long long key = MakeDrawSortKey(DRAW_PASS_SHADOW, 0, 0, e->GetMesh()->GetSortId(), shadowLod(e));
+			shadowDrawItems[casterCount++] = { key, (unsigned int)i };
+		}
+		shadowDrawItems = SortDrawItems(shadowDrawItems, frameAllocator.Allocate<DrawItem>(casterCount), casterCount);
 
-			// Draw the mesh
-			e->Draw(lightCamera);
+		//the shadow vertex shader only reads world matrices, so that's
+		//all that gets packed (room for every entity in every slice was
+		//reserved up front)
+		instanceBatcher.Begin();
+		for (unsigned int s = 0; s < shadowMapCount; s++)
+		{
+			shadowBatchStarts[s] = instanceBatcher.GetBatches().size();
+			for (size_t d = 0; d < casterCount; d++)
+			{
+				unsigned int index = shadowDrawItems[d].Index;
+				if (!shadowCasterVisible[s][index])
+					continue;
+
+				Entity* e = gameEntities[index].get();
+				instanceBatcher.Add(e->GetMesh(), 0, shadowLod(e), e->GetTransform()->GetWorldMatrix());
+			}
+			instanceBatcher.EndBatch();
 		}
+		shadowBatchStarts[shadowMapCount] = instanceBatcher.GetBatches().size();
+
+		shadowsInstanced = instanceBuffer->Upload(instanceBatcher.GetWorlds());
+		if (shadowsInstanced)
+			shadowInstanceBatchCount = instanceBatcher.GetBatches().size();
 	}
 
-	// Render 3rd shadow map
+	context->RSSetState(shadowRasterizer.Get());
+
+	// Render each light's cascades into their slices
+	for (unsigned int i = 0; i < shadowMapCount; i++)
 	{
 		// Initial pipeline setup - No RTV necessary - Clear shadow map
-		context->OMSetRenderTargets(0, 0, shadowDSV3.Get());
-		context->ClearDepthStencilView(shadowDSV3.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-		context->RSSetState(shadowRasterizer.Get());
-
-		// Update View matrix to light 2
-		XMMATRIX shView = XMMatrixLookAtLH(
-			XMVectorSet(dScale * lights[2].Direction.x, dScale * lights[2].Direction.y, dScale * lights[2].Direction.z, 0.0f),
-			XMVectorSet(0, 0, 0, 0),
-			XMVectorSet(0, 1, 0, 0));
-		XMStoreFloat4x4(&shadowViewMatrix3, shView);
-
-		// Turn on our shadow map Vertex Shader
-		// and turn OFF the pixel shader entirely
-		shadowVertexShader->SetShader();
-		shadowVertexShader->SetMatrix4x4("view", shadowViewMatrix3);
-		shadowVertexShader->SetMatrix4x4("projection", shadowProjectionMatrix);
-		context->PSSetShader(0, 0, 0); // No PS
-
-		//create camera to pass to entity to draw. This camera is actually the light.
-		std::shared_ptr<Camera> lightCamera = std::make_shared<Camera>(1.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), DirectX::XM_PI / 3, 0.01f, 1000.0f, 1.0f, 5.0f, false);
-
-		//set camera to the lights orientation and set projection to shadowMap viewport values
-		lightCamera->SetViewMatrix(shadowViewMatrix3);
-		lightCamera->SetProjectionMatrix(shadowProjectionMatrix);
-
-		// Loop and draw all entities
-		for (auto& e : gameEntities)
-		{
-			shadowVertexShader->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-			shadowVertexShader->CopyAllBufferData();
+		context->OMSetRenderTargets(0, 0, shadowMapDSVs[i].Get());
+		context->ClearDepthStencilView(shadowMapDSVs[i].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
 
-			// Draw the mesh
-			e->Draw(lightCamera);
-		}
+		// Draw this slice's casters from the light's point of view
+		DrawShadowCasters(i);
 	}
 
 	// After rendering the shadow map, go back to the screen
@@ -679,6 +717,67 @@ void Game::RenderShadowMaps()
 	context->RSSetState(0);
 }
 
+// --------------------------------------------------------
+// Draws the casters RenderShadowMaps() found for a shadow
+// map into it, as instance batches if it made them this
+// frame, or one at a time otherwise
+// --------------------------------------------------------
+void Game::DrawShadowCasters(unsigned int shadowMap)
+{
+	const ShadowCascade& cascade = shadowCascades[shadowMap];
+
+	// Turn OFF the pixel shader entirely
+	stateCache->SetShader(SIMPLE_STAGE_PIXEL, 0); // No PS
+
+	if (shadowsInstanced)
+	{
+		shadowInstancedVertexShader->SetShader();
+		ShaderLayouts::VertexShader_Shadow_Instanced_PerFrame shadowPerFrame = {};
+		shadowPerFrame.view = cascade.View;
+		shadowPerFrame.projection = cascade.Projection;
+		shadowInstancedVertexShader->SetBufferData(shadowInstancedPerFrameHandle, &shadowPerFrame, sizeof(shadowPerFrame));
+		shadowInstancedVertexShader->CopyBufferData(SIMPLE_BUFFER_PER_FRAME);
+
+		const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+		Mesh* boundMesh = 0;
+		for (size_t b = shadowBatchStarts[shadowMap]; b < shadowBatchStarts[shadowMap + 1]; b++)
+		{
+			const InstanceBatch& batch = batches[b];
+			if (batch.BatchMesh != boundMesh)
+			{
+				batch.BatchMesh->Bind();
+				boundMesh = batch.BatchMesh;
+			}
+			batch.BatchMesh->DrawBoundInstanced(batch.Lod, batch.InstanceCount, batch.FirstInstance);
+		}
+		return;
+	}
+
+	// Turn on our shadow map Vertex Shader
+	shadowVertexShader->SetShader();
+	ShaderLayouts::VertexShader_Shadow_PerFrame shadowPerFrame = {};
+	shadowPerFrame.view = cascade.View;
+	shadowPerFrame.projection = cascade.Projection;
+	shadowVertexShader->SetBufferData(shadowPassPerFrameHandle, &shadowPerFrame, sizeof(shadowPerFrame));
+	shadowVertexShader->CopyBufferData(SIMPLE_BUFFER_PER_FRAME);
+
+	// Loop and draw the casters, only the world matrix changes per draw
+	for (size_t i = 0; i < gameEntities.size(); i++)
+	{
+		if (!shadowCasterVisible[shadowMap][i])
+			continue;
+
+		Entity* e = gameEntities[i].get();
+		ShaderLayouts::VertexShader_Shadow_PerObject shadowPerObject = {};
+		shadowPerObject.world = e->GetTransform()->GetWorldMatrix();
+		shadowVertexShader->SetBufferData(shadowPassPerObjectHandle, &shadowPerObject, sizeof(shadowPerObject));
+		shadowVertexShader->CopyBufferData(SIMPLE_BUFFER_PER_OBJECT);
+
+		// Draw the mesh (without the entity's material)
+		e->DrawMesh(shadowLodBias);
+	}
+}
+
 void Game::UpdateImGui(float deltaTime)
 {
 	// Get a reference to our custom input manager
@@ -724,6 +823,80 @@ void Game::UpdateStatsUI()
 
 	ImGui::Text("Framerate: %f", io.Framerate);
 	ImGui::Text("Window Size: %d x %d", windowWidth,windowHeight);
+	ImGui::Text("Entities Visible: %zu", visibleEntityCount);
+	ImGui::Text("Entities Culled: %zu", culledEntityCount);
+	ImGui::Text("Transforms Rebuilt: %u", TransformSystem::GetInstance().GetLastUpdateCount());
+	ImGui::Text("Constant Buffer Uploads: %u (%llu bytes)", ISimpleShader::BufferUploads, ISimpleShader::BufferBytesUploaded);
+	ImGui::Text("Constant Buffer Uploads Skipped: %u", ISimpleShader::BufferUploadsSkipped);
+	ImGui::Text("State Binds Issued: %u", stateCache->GetIssuedCalls());
+	ImGui::Text("State Binds Elided: %u", stateCache->GetElidedCalls());
+#if defined(DEBUG) || defined(_DEBUG)
+	ImGui::Text("Heap Allocations: %llu last frame", frameHeapAllocations);
+#endif
+	ImGui::Text("Frame Allocator: %zu of %zu bytes", frameAllocator.GetLastFrameUsed(), frameAllocator.GetCapacity());
+	ImGui::Checkbox("Sort Draws", &sortDraws);
+	ImGui::Checkbox("Draw Instanced", &drawInstanced);
+	ImGui::Text("Instance Batches: %zu (shadows: %zu)", instanceBatchCount, shadowInstanceBatchCount);
+	ImGui::Text("Shadow Maps: %u of %d", shadowMapCount, MAX_SHADOW_MAPS);
+	ImGui::Checkbox("Cull Shadow Casters", &cullShadowCasters);
+
+	//casters drawn into each of a light's cascades, against drawing
+	//every entity into every one
+	size_t shadowCasterDraws = 0;
+	for (int i = 0; i < numOfLightsInGame; i++)
+	{
+		const Light& light = lights[i];
+		if (light.ShadowMapCount == 0)
+			continue;
+
+		size_t lightCasters = 0;
+		for (int c = 0; c < light.ShadowMapCount; c++)
+			lightCasters += shadowCasterCounts[light.ShadowMapIndex + c];
+		shadowCasterDraws += lightCasters;
+
+		char cascadeCasters[64] = "";
+		int length = 0;
+		for (int c = 0; c < light.ShadowMapCount; c++)
+		{
+			//snprintf returns what it would have written, so stop once
+			//it errors or the buffer is full rather than run past it
+			int written = snprintf(cascadeCasters + length, sizeof(cascadeCasters) - length, c == 0 ? "%zu" : " / %zu", shadowCasterCounts[light.ShadowMapIndex + c]);
+			if (written < 0)
+				break;
+			length += written;
+			if (length >= (int)sizeof(cascadeCasters))
+				break;
+		}
+		ImGui::Text("Light %d Shadow Casters: %zu (%s)", i + 1, lightCasters, cascadeCasters);
+	}
+	ImGui::Text("Shadow Caster Draws: %zu of %zu", shadowCasterDraws, gameEntities.size() * shadowMapCount);
+	ImGui::SliderInt("Shadow Cascades", &shadowCascadeCount, 1, MAX_SHADOW_CASCADES);
+	ImGui::SliderFloat("Cascade Split Lambda", &shadowSplitLambda, 0.0f, 1.0f);
+	for (int c = 0; c < shadowCascadeCount; c++)
+		ImGui::Text("Cascade %d: %.2f to %.2f", c + 1, shadowCascadeSplits[c], shadowCascadeSplits[c + 1]);
+	ImGui::Text("Shader Changes: %u unsorted, %u drawn", unsortedDrawStateChanges.Shaders, drawStateChanges.Shaders);
+	ImGui::Text("Material Changes: %u unsorted, %u drawn", unsortedDrawStateChanges.Materials, drawStateChanges.Materials);
+	ImGui::Text("Mesh Changes: %u unsorted, %u drawn", unsortedDrawStateChanges.Meshes, drawStateChanges.Meshes);
+
+	//Per shader metadata size and load time
+	if (ImGui::TreeNode("Shaders"))
+	{
+		std::pair<const char*, ISimpleShader*> shaders[] =
+		{
+			{ "VertexShader", vertexShader.get() },
+			{ "PixelShader", pixelShader.get() },
+			{ "VertexShader_Shadow", shadowVertexShader.get() },
+			{ "VertexShader_Instanced", instancedVertexShader.get() },
+			{ "VertexShader_Shadow_Instanced", shadowInstancedVertexShader.get() },
+			{ "CustomPixelShader", customPixelShader.get() },
+			{ "VertexShader_Sky", skyVertexShader.get() },
+			{ "PixelShader_Sky", skyPixelShader.get() },
+		};
+		for (auto& shader : shaders)
+			ImGui::Text("%s: %zu bytes, %.2f ms", shader.first, shader.second->GetMetadataSize(), shader.second->GetLoadMilliseconds());
+
+		ImGui::TreePop();
+	}
 
 }
 
@@ -824,8 +997,8 @@ void Game::Update(float deltaTime, float totalTime)
 		//Update Lights
 		UpdateLights();
 
-		////Update Stats UI
-		//UpdateStatsUI();
+		//Update Stats UI
+		UpdateStatsUI();
 
 		////Update Entity and Camera Control UI
 		//UpdateEntityCameraControlUI();	
@@ -856,6 +1029,15 @@ void Game::Update(float deltaTime, float totalTime)
 	
 	//Camera Update
 	mainCamera->Update(deltaTime);
+
+	//Rebuild the matrices of everything that moved this frame in one pass
+	TransformSystem::GetInstance().UpdateMatrices();
+
+	//Pick each entity's level of detail for this frame's view
+	for (auto& e : gameEntities)
+	{
+		e->UpdateLod(mainCamera.get());
+	}
 }
 
 // --------------------------------------------------------
@@ -863,6 +1045,18 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	//count constant buffer uploads for this frame only
+	ISimpleShader::ResetUploadStats();
+	constantBufferRing->BeginFrame();
+
+	//ImGui (and the shadow maps becoming depth targets again) changed
+	//the context behind the state cache's back since last frame
+	stateCache->Invalidate();
+	stateCache->ResetStats();
+
+	//everything allocated for last frame's draw lists goes at once
+	frameAllocator.Reset();
+
 	// Frame START
 	// - These things should happen ONCE PER FRAME
 	// - At the beginning of Game::Draw() before drawing *anything*
@@ -875,38 +1069,168 @@ void Game::Draw(float deltaTime, float totalTime)
 		context->ClearDepthStencilView(depthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
 	}
 
+	//gather every entity's bounds, for culling both the shadow
+	//casters and the main view
+	entityBounds.Resize(gameEntities.size());
+	for (size_t i = 0; i < gameEntities.size(); i++)
+	{
+		XMFLOAT3 center;
+		XMFLOAT3 extents;
+		float radius;
+		gameEntities[i]->GetWorldBounds(center, radius, extents);
+		entityBounds.Set(i, center, radius, extents);
+	}
+
 	// Render the shadow map before rendering anything to the screen
 	RenderShadowMaps();
 
-	std::vector <DirectX::XMFLOAT4X4> viewMatrices;
-	viewMatrices.push_back(shadowViewMatrix1);
-	viewMatrices.push_back(shadowViewMatrix2);
-	viewMatrices.push_back(shadowViewMatrix3);
+	//find the entities the main camera can see
+	visibleEntityCount = CullBounds(mainCamera->GetFrustumPlanes(), entityBounds, entityVisible);
+	culledEntityCount = gameEntities.size() - visibleEntityCount;
+
+	//every lit material shares these shaders, so the camera, shadow and
+	//light data (the PerFrame buffers) only gets uploaded once per frame
+	//set camera info for vertex shader
+	ShaderLayouts::VertexShader_PerFrame perFrameVS = {};
+	perFrameVS.view = mainCamera->GetViewMatrix();
+	perFrameVS.projection = mainCamera->GetProjectionMatrix();
+	vertexShader->SetBufferData(perFrameVSHandle, &perFrameVS, sizeof(perFrameVS));
+	vertexShader->CopyBufferData(SIMPLE_BUFFER_PER_FRAME);
+	ShaderLayouts::VertexShader_Instanced_PerFrame perFrameInstancedVS = {};
+	perFrameInstancedVS.view = perFrameVS.view;
+	perFrameInstancedVS.projection = perFrameVS.projection;
+	instancedVertexShader->SetBufferData(perFrameInstancedVSHandle, &perFrameInstancedVS, sizeof(perFrameInstancedVS));
+	instancedVertexShader->CopyBufferData(SIMPLE_BUFFER_PER_FRAME);
+
+	//set camera, lights and shadow maps for pixel shader - each pixel only
+	//transforms into the one shadow map it samples
+	static_assert(sizeof(Light) == sizeof(ShaderLayouts::Light), "Light doesn't match the shader's Light struct");
+	ShaderLayouts::PixelShader_PerFrame perFramePS = {};
+	perFramePS.cameraPosition = mainCamera->GetTransform()->GetPosition();
+	perFramePS.ambientTerm = mainCamera->GetAmbientColor();
+	memcpy(perFramePS.lights, &lights[0], sizeof(Light) * (std::min)(lights.size(), (size_t)MAX_LIGHTS));
+	perFramePS.lightCount = numOfLightsInGame;
+	for (unsigned int i = 0; i < shadowMapCount; i++)
+	{
+		XMMATRIX shadowViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&shadowCascades[i].View), XMLoadFloat4x4(&shadowCascades[i].Projection));
+		XMStoreFloat4x4(&perFramePS.shadowViewProjection[i], shadowViewProjection);
+	}
 
-	//draw each entity
-	for (std::shared_ptr<Entity> entity : gameEntities)
+	//a pixel's view depth picks its cascade, as the casters were culled
+	//per slice - unused cascades end where the last one does
+	XMFLOAT4X4 cameraView = mainCamera->GetViewMatrix();
+	perFramePS.viewDepthPlane = XMFLOAT4(cameraView._13, cameraView._23, cameraView._33, cameraView._43);
+	float* cascadeEnds = &perFramePS.cascadeEnds.x;
+	for (int c = 0; c < MAX_SHADOW_CASCADES; c++)
+		cascadeEnds[c] = shadowCascadeSplits[(std::min)(c + 1, shadowCascadeCount)];
+	pixelShader->SetBufferData(perFramePSHandle, &perFramePS, sizeof(perFramePS));
+	pixelShader->CopyBufferData(SIMPLE_BUFFER_PER_FRAME);
+	pixelShader->SetShaderResourceView(shadowMapsHandle, shadowMapsSRV);
+	pixelShader->SetSamplerState(shadowSamplerHandle, shadowSampler);
+
+	//queue the visible entities, keyed so that sorting puts draws
+	//sharing shaders, then materials, then meshes next to each other
+	//(front to back within a mesh)
+	XMFLOAT3 cameraPosition = mainCamera->GetTransform()->GetPosition();
+	XMVECTOR cameraPositionVec = XMLoadFloat3(&cameraPosition);
+	DrawItem* drawItems = frameAllocator.Allocate<DrawItem>(visibleEntityCount);
+	size_t drawItemCount = 0;
+	for (size_t i = 0; i < gameEntities.size(); i++)
 	{
-		std::shared_ptr<SimpleVertexShader> vs = entity->GetMaterial()->GetVertexShader();
-		std::shared_ptr<SimplePixelShader> ps = entity->GetMaterial()->GetPixelShader();
-		
-		//set shadow info for vertex shader
-		vs->SetData("shadowView", &viewMatrices[0],sizeof(DirectX::XMFLOAT4X4)*viewMatrices.size());
-		vs->SetMatrix4x4("shadowProjection", shadowProjectionMatrix);
-
-		//set lights for pixel shader
-		ps->SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
-		ps->SetInt("lightCount", numOfLightsInGame);
-		ps->SetShaderResourceView("ShadowMap1", shadowSRV1);
-		ps->SetShaderResourceView("ShadowMap2", shadowSRV2);
-		ps->SetShaderResourceView("ShadowMap3", shadowSRV3);
-		ps->SetSamplerState("ShadowSampler", shadowSampler);
+		if (!entityVisible[i])
+			continue;
+
+		Material* material = gameEntities[i]->GetMaterial();
+		unsigned int shader = (material->GetVertexShader()->GetShaderId() << 8) | (material->GetPixelShader()->GetShaderId() & 0xFF);
+
+		XMVECTOR center = XMVectorSet(entityBounds.CenterX[i], entityBounds.CenterY[i], entityBounds.CenterZ[i], 0.0f);
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, cameraPositionVec)));
+
+		unsigned long long key = MakeDrawSortKey(DRAW_PASS_OPAQUE, shader, material->GetSortId(),
+			gameEntities[i]->GetMesh()->GetSortId(), GetDepthBucket(distance, mainCamera->GetFarClipDistance()));
+		drawItems[drawItemCount++] = { key, (unsigned int)i };
+	}
+
+	unsortedDrawStateChanges = CountDrawStateChanges(drawItems, drawItemCount);
+	if (sortDraws)
+		drawItems = SortDrawItems(drawItems, frameAllocator.Allocate<DrawItem>(drawItemCount), drawItemCount);
+	drawStateChanges = CountDrawStateChanges(drawItems, drawItemCount);
+
+	//batch up whatever can be drawn instanced - the sorted list already
+	//has draws sharing a mesh and material next to each other
+	bool instanced = false;
+	instanceBatchCount = 0;
+	if (drawInstanced)
+	{
+		instanceBatcher.Begin();
+		for (size_t d = 0; d < drawItemCount; d++)
+		{
+			Entity* entity = gameEntities[drawItems[d].Index].get();
+			Material* material = entity->GetMaterial();
+			if (!material->CanDrawInstanced())
+				continue;
+
+			Transform* transform = entity->GetTransform();
+			instanceBatcher.Add(entity->GetMesh(), material, entity->GetLod(),
+				transform->GetWorldMatrix(), transform->GetWorldInverseTransposeMatrix());
+		}
+
+		instanced = instanceBuffer->Upload(instanceBatcher.GetInstances());
+		if (instanced)
+			instanceBatchCount = instanceBatcher.GetBatches().size();
+	}
+
+	//draw the list, only binding what changed since the previous draw
+	Material* boundMaterial = 0;
+	Mesh* boundMesh = 0;
+	for (size_t d = 0; d < drawItemCount; d++)
+	{
+		Entity* entity = gameEntities[drawItems[d].Index].get();
+
+		Material* material = entity->GetMaterial();
+		if (instanced && material->CanDrawInstanced())
+			continue;
+
+		if (material != boundMaterial)
+		{
+			material->Bind(boundMaterial);
+			boundMaterial = material;
+		}
+
+		Mesh* mesh = entity->GetMesh();
+		if (mesh != boundMesh)
+		{
+			mesh->Bind();
+			boundMesh = mesh;
+		}
 
 		//draw entity
-		entity->Draw(mainCamera);
+		entity->Draw();
+	}
+
+	//then the instance batches
+	if (instanced)
+	{
+		for (const InstanceBatch& batch : instanceBatcher.GetBatches())
+		{
+			if (batch.BatchMaterial != boundMaterial)
+			{
+				batch.BatchMaterial->Bind(boundMaterial, true);
+				boundMaterial = batch.BatchMaterial;
+			}
+
+			if (batch.BatchMesh != boundMesh)
+			{
+				batch.BatchMesh->Bind();
+				boundMesh = batch.BatchMesh;
+			}
+
+			batch.BatchMesh->DrawBoundInstanced(batch.Lod, batch.InstanceCount, batch.FirstInstance);
+		}
 	}
 	
 	//draw skybox
-	skyBox->Draw(context, mainCamera);
+	skyBox->Draw(context.Get(), mainCamera.get());
 
 	// Draw ImGui
 	ImGui::Render();
@@ -919,6 +1243,7 @@ void Game::Draw(float deltaTime, float totalTime)
 		// Present the back buffer to the user
 		//  - Puts the results of what we've drawn onto the window
 		//  - Without this, the user never sees anything
+		constantBufferRing->EndFrame();
 		swapChain->Present(vsync ? 1 : 0, 0);
 
 		// Must re-bind buffers after presenting, as they become unbound
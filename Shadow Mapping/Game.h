@@ -12,6 +12,12 @@
 #include "Material.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "FrustumCulling.h"
+#include "DrawSorting.h"
+#include "InstanceBatcher.h"
+#include "InstanceBuffer.h"
+#include "FrameAllocator.h"
+#include "ShadowCascades.h"
 
 class Game 
 	: public DXCore
@@ -38,7 +44,9 @@ private:
 	void CreateLights();
 	void CreateSkyBox();
 	void CreateShadowMapResources();
+	void AssignShadowMaps();
 	void RenderShadowMaps();
+	void DrawShadowCasters(unsigned int shadowMap);
 
 	void UpdateImGui(float deltaTime);
 	void UpdateStatsUI();
@@ -60,6 +68,21 @@ private:
 	//Custom Shaders
 	std::shared_ptr<SimpleVertexShader> shadowVertexShader;
 	std::shared_ptr<SimplePixelShader> customPixelShader;
+	//Instanced versions, reading the per object matrices from the instance buffer
+	std::shared_ptr<SimpleVertexShader> instancedVertexShader;
+	std::shared_ptr<SimpleVertexShader> shadowInstancedVertexShader;
+	//Handles into the shaders above, looked up once in LoadShaders()
+	SimpleBufferHandle perFrameVSHandle;
+	SimpleBufferHandle perFramePSHandle;
+	SimpleSRVHandle shadowMapsHandle;
+	SimpleSamplerHandle shadowSamplerHandle;
+	SimpleBufferHandle shadowPassPerFrameHandle;
+	SimpleBufferHandle shadowPassPerObjectHandle;
+	SimpleBufferHandle perFrameInstancedVSHandle;
+	SimpleBufferHandle shadowInstancedPerFrameHandle;
+	//Shared ring the per-draw constant buffers are copied into (when supported)
+	std::shared_ptr<SimpleConstantBufferRing> constantBufferRing;
+	std::shared_ptr<SimpleStateCache> stateCache;
 
 	// Texture and texture-related constructs (how to have a vector of com pointers?)
 	//Albedo Map SRVs
@@ -106,6 +129,30 @@ private:
 	std::vector<std::shared_ptr<Mesh>> gameMeshes;
 	std::vector<std::shared_ptr<Entity>> gameEntities;
 
+	//Frustum culling (rebuilt every frame, indexed like gameEntities)
+	CullingBounds entityBounds;
+	std::vector<unsigned char> entityVisible;
+	size_t visibleEntityCount;
+	size_t culledEntityCount;
+
+	//Scratch memory for the current frame - the draw lists live here
+	FrameAllocator frameAllocator;
+
+	//Whether to sort the visible entities by shader, material and mesh
+	bool sortDraws;
+	//state changes the draw list would have had unsorted, and has as drawn
+	DrawStateChanges unsortedDrawStateChanges;
+	DrawStateChanges drawStateChanges;
+
+	//Hardware instancing - draws sharing a mesh, material and level of
+	//detail become one DrawIndexedInstanced, in the main and shadow passes
+	bool drawInstanced;
+	bool shadowsInstanced; //whether this frame's shadow batches made it into the buffer
+	InstanceBatcher instanceBatcher;
+	std::shared_ptr<InstanceBuffer> instanceBuffer;
+	size_t instanceBatchCount;
+	size_t shadowInstanceBatchCount;
+
 	//Camera
 	std::shared_ptr<Camera> mainCamera;
 
@@ -115,22 +162,33 @@ private:
 
 	//Shadows
 	int shadowMapResolution;
-	float shadowProjectionSize;
-	//shadow textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV1;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV2;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV3;
-	//shadow depth stencils
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV1;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV2;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV3;
+	unsigned int shadowLodBias; //shadow maps draw this many levels coarser than the main view
+	//shadow maps - one texture array, read all at once, drawn a slice at a time
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowMapsSRV;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowMapDSVs[MAX_SHADOW_MAPS];
+	//which light each slice belongs to this frame (the lights point back
+	//with Light::ShadowMapIndex/ShadowMapCount), and how many slices are in use
+	unsigned int shadowMapLights[MAX_SHADOW_MAPS];
+	unsigned int shadowMapCount;
 	//shadow sampler and rasterizer
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
-	//Shadow view and projection matrices
-	DirectX::XMFLOAT4X4 shadowViewMatrix1;
-	DirectX::XMFLOAT4X4 shadowViewMatrix2;
-	DirectX::XMFLOAT4X4 shadowViewMatrix3;
-	DirectX::XMFLOAT4X4 shadowProjectionMatrix;
+	//Cascades - the view out to shadowDistance is split into
+	//shadowCascadeCount slices, and every directional light gets
+	//a shadow map fitted around each
+	int shadowCascadeCount;
+	float shadowDistance;
+	float shadowSplitLambda; //0 splits the distance evenly, 1 logarithmically
+	float shadowCasterDistance; //how far towards the light casters still make it into a cascade
+	float shadowCascadeSplits[MAX_SHADOW_CASCADES + 1];
+	//Light view and projection of each slice, fitted every frame
+	ShadowCascade shadowCascades[MAX_SHADOW_MAPS];
+	//Shadow caster culling - each slice only draws the entities that
+	//can shadow its part of the camera's view (indexed like gameEntities)
+	bool cullShadowCasters;
+	std::vector<unsigned char> shadowCasterVisible[MAX_SHADOW_MAPS];
+	size_t shadowCasterCounts[MAX_SHADOW_MAPS];
+	//each slice's run of instance batches, when the casters are instanced
+	size_t shadowBatchStarts[MAX_SHADOW_MAPS + 1];
 };
 
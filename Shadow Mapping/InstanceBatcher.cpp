@@ -0,0 +1,48 @@
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+
+void InstanceBatcher::Reserve(size_t instanceCapacity, size_t worldCapacity)
+{
+	//every draw could be a batch of its own
+	batches.reserve((std::max)(instanceCapacity, worldCapacity));
+	instances.reserve(instanceCapacity);
+	worlds.reserve(worldCapacity);
+}
+
+void InstanceBatcher::Begin()
+{
+	batches.clear();
+	instances.clear();
+	worlds.clear();
+	closedBatchCount = 0;
+}
+
+// --------------------------------------------------------
+// Extends the last batch if this draw matches it, and
+// starts a new one otherwise
+// --------------------------------------------------------
+void InstanceBatcher::Add(Mesh* mesh, Material* material, unsigned int lod, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInvTranspose)
+{
+	AddToBatch(mesh, material, lod, instances.size());
+	instances.push_back({ world, worldInvTranspose });
+}
+
+void InstanceBatcher::Add(Mesh* mesh, Material* material, unsigned int lod, const DirectX::XMFLOAT4X4& world)
+{
+	AddToBatch(mesh, material, lod, worlds.size());
+	worlds.push_back(world);
+}
+
+void InstanceBatcher::AddToBatch(Mesh* mesh, Material* material, unsigned int lod, size_t instanceIndex)
+{
+	if (batches.size() == closedBatchCount ||
+		batches.back().BatchMesh != mesh ||
+		batches.back().BatchMaterial != material ||
+		batches.back().Lod != lod)
+	{
+		batches.push_back({ mesh, material, lod, (unsigned int)instanceIndex, 0 });
+	}
+
+	batches.back().InstanceCount++;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+class Mesh;
+class Material;
+
+// --------------------------------------------------------
+// Per-instance data, as the instanced vertex shaders read
+// it (the WORLD_PER_INSTANCE and WORLDINVTRANSPOSE_PER_INSTANCE
+// rows, from input slot 1)
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInvTranspose;
+};
+
+// --------------------------------------------------------
+// A run of instances drawn with one DrawIndexedInstanced
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	Mesh* BatchMesh;
+	Material* BatchMaterial;	// Null for passes that don't use materials
+	unsigned int Lod;
+	unsigned int FirstInstance;
+	unsigned int InstanceCount;
+};
+
+// --------------------------------------------------------
+// Groups draws into instance batches, packing the matrices
+// of every instance into one array as it goes.  Consecutive
+// draws with the same mesh, material and level of detail
+// share a batch, so feed it a sorted draw list (see
+// DrawSorting.h) to get the fewest batches.
+//
+// Draws added with just a world matrix are packed into an
+// array of their own, half the size, for passes whose
+// shaders read nothing else (InstanceInput_Shadow) - stick
+// to one kind of Add() between Begin()s.
+//
+// Only pointers to meshes and materials are compared, so
+// this doesn't need anything from Direct3D.
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher() : closedBatchCount(0) {}
+
+	// Makes room up front for the most draws of each kind a frame can
+	// add, so no frame within those counts ever reallocates
+	void Reserve(size_t instanceCapacity, size_t worldCapacity);
+
+	// Starts a new set of batches, keeping the arrays' memory
+	void Begin();
+
+	void Add(Mesh* mesh, Material* material, unsigned int lod, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInvTranspose);
+	// For passes that only need the world matrix, packed into GetWorlds()
+	void Add(Mesh* mesh, Material* material, unsigned int lod, const DirectX::XMFLOAT4X4& world);
+
+	// Closes the last batch, so the next draw starts a new one even if it
+	// matches - for packing several passes' batches into the same arrays
+	void EndBatch() { closedBatchCount = batches.size(); }
+
+	const std::vector<InstanceBatch>& GetBatches() { return batches; }
+	const std::vector<InstanceData>& GetInstances() { return instances; }
+	const std::vector<DirectX::XMFLOAT4X4>& GetWorlds() { return worlds; }
+
+private:
+	std::vector<InstanceBatch> batches;
+	std::vector<InstanceData> instances;
+	std::vector<DirectX::XMFLOAT4X4> worlds;
+	size_t closedBatchCount; // Batches before this can't be extended
+
+	// Counts one more instance, in the last batch if it matches
+	void AddToBatch(Mesh* mesh, Material* material, unsigned int lod, size_t instanceIndex);
+};
@@ -0,0 +1,72 @@
+#include "InstanceBuffer.h"
+
+#include <string.h>
+
+// Smallest buffer made, in bytes (1024 full instances)
+#define INSTANCE_BUFFER_MIN_CAPACITY (unsigned int)(1024 * sizeof(InstanceData))
+
+InstanceBuffer::InstanceBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	this->device = device;
+	this->context = context;
+	this->capacity = 0;
+}
+
+InstanceBuffer::~InstanceBuffer() {}
+
+bool InstanceBuffer::Upload(const std::vector<InstanceData>& instances)
+{
+	return Upload(instances.data(), instances.size(), sizeof(InstanceData));
+}
+
+bool InstanceBuffer::Upload(const std::vector<DirectX::XMFLOAT4X4>& worlds)
+{
+	return Upload(worlds.data(), worlds.size(), sizeof(DirectX::XMFLOAT4X4));
+}
+
+// --------------------------------------------------------
+// Grows by doubling, so a scene that keeps adding
+// entities only reallocates a handful of times
+// --------------------------------------------------------
+bool InstanceBuffer::Reserve(unsigned int size)
+{
+	if (size <= capacity)
+		return true;
+
+	unsigned int newCapacity = capacity > 0 ? capacity : INSTANCE_BUFFER_MIN_CAPACITY;
+	while (newCapacity < size)
+		newCapacity *= 2;
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.ByteWidth = newCapacity;
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	buffer.Reset();
+	capacity = 0;
+	if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())))
+		return false;
+	capacity = newCapacity;
+	return true;
+}
+
+bool InstanceBuffer::Upload(const void* data, size_t count, unsigned int stride)
+{
+	if (count == 0)
+		return true;
+
+	size_t size = count * stride;
+	if (!Reserve((unsigned int)size))
+		return false;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return false;
+	memcpy(mapped.pData, data, size);
+	context->Unmap(buffer.Get(), 0);
+
+	UINT offset = 0;
+	context->IASetVertexBuffers(InputSlot, 1, buffer.GetAddressOf(), &stride, &offset);
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include "InstanceBatcher.h"
+
+// --------------------------------------------------------
+// Dynamic vertex buffer holding a frame's instance data,
+// bound to input slot 1 where the instanced vertex shaders
+// read their per-instance elements from.
+//
+// Every Upload() is a MAP_WRITE_DISCARD, so it can be
+// filled more than once per frame (once per pass) without
+// waiting on draws that used the earlier contents.
+// --------------------------------------------------------
+class InstanceBuffer
+{
+public:
+	InstanceBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~InstanceBuffer();
+
+	// Copies the instances in, growing the buffer if they don't fit,
+	// and binds it.  False if the buffer couldn't be made big enough.
+	bool Upload(const std::vector<InstanceData>& instances);
+	// Same for world matrices alone, bound with their own 64 byte stride
+	bool Upload(const std::vector<DirectX::XMFLOAT4X4>& worlds);
+
+	// Makes the buffer at least this many bytes now, so uploads up to
+	// that size never have to recreate it.  False if it couldn't be made.
+	bool Reserve(unsigned int size);
+
+	// In bytes, since instances come in more than one size
+	unsigned int GetCapacity() { return capacity; }
+
+	// Instance slot the instanced shaders expect, matching
+	// SimpleVertexShader's layout for "_PER_INSTANCE" semantics
+	static const unsigned int InputSlot = 1;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	unsigned int capacity;
+
+	bool Upload(const void* data, size_t count, unsigned int stride);
+};
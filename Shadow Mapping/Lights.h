@@ -7,6 +7,8 @@
 #define LIGHT_TYPE_SPOT 2
 
 #define MAX_LIGHTS 5
+// Slices in the shadow map array - each shadowed light takes one per cascade
+#define MAX_SHADOW_MAPS 12
 
 struct Light
 {
@@ -18,5 +20,6 @@ struct Light
 	DirectX::XMFLOAT3 Color;					// All lights need a color
 	float SpotFalloff;				// Spot lights need a value to define their cone size
 	int CastsShadows;				// 0 = False, 1 = True
-	DirectX::XMFLOAT2 Padding;				// Purposefully padding to hit the 16-byte boundary
+	int ShadowMapIndex;				// First slice of the shadow map array, or -1 (assigned by Game each frame)
+	int ShadowMapCount;				// Slices from ShadowMapIndex on, one per cascade, nearest first
 };
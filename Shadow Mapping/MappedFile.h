@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// Read-only memory mapping of a whole file.
+//
+// The view stays valid until Close() is called or the
+// object is destroyed.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const wchar_t* filename);
+	void Close();
+
+	//Getters
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const char* view;
+	size_t size;
+};
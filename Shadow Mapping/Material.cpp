@@ -1,5 +1,27 @@
 #include "Material.h"
+#include "ShaderLayouts.h"
 
+unsigned int Material::nextSortId = 0;
+
+namespace
+{
+	bool Float3Equal(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	//whether a list of (handle, resource) bindings has the same one
+	template<typename Binding>
+	bool HasBinding(const std::vector<Binding>& bindings, const Binding& binding)
+	{
+		for (auto& b : bindings)
+		{
+			if (b.first.BindIndex == binding.first.BindIndex && b.second == binding.second)
+				return true;
+		}
+		return false;
+	}
+}
 
 Material::Material(DirectX::XMFLOAT3 colorTint, float roughness, std::shared_ptr<SimpleVertexShader> vertexShader, std::shared_ptr<SimplePixelShader> pixelShader)
 {
@@ -7,6 +29,11 @@ Material::Material(DirectX::XMFLOAT3 colorTint, float roughness, std::shared_ptr
 	this->roughness = roughness;
 	this->vertexShader = vertexShader;
 	this->pixelShader = pixelShader;
+	this->sortId = nextSortId++;
+	this->boundVertexShader = 0;
+
+	ResolveVertexShaderHandles();
+	ResolvePixelShaderHandles();
 }
 
 Material::~Material() {}
@@ -21,14 +48,19 @@ float Material::GetRoughness()
 	return roughness;
 }
 
-std::shared_ptr<SimpleVertexShader> Material::GetVertexShader()
+SimpleVertexShader* Material::GetVertexShader()
 {
-	return vertexShader;
+	return vertexShader.get();
 }
 
-std::shared_ptr<SimplePixelShader> Material::GetPixelShader()
+SimplePixelShader* Material::GetPixelShader()
 {
-	return pixelShader;
+	return pixelShader.get();
+}
+
+unsigned int Material::GetSortId()
+{
+	return sortId;
 }
 
 void Material::SetColorTint(DirectX::XMFLOAT3 colorTint)
@@ -39,11 +71,23 @@ void Material::SetColorTint(DirectX::XMFLOAT3 colorTint)
 void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> vertexShader)
 {
 	this->vertexShader = vertexShader;
+	ResolveVertexShaderHandles();
 }
 
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> pixelShader)
 {
 	this->pixelShader = pixelShader;
+	ResolvePixelShaderHandles();
+}
+
+void Material::SetInstancedVertexShader(std::shared_ptr<SimpleVertexShader> instancedVertexShader)
+{
+	this->instancedVertexShader = instancedVertexShader;
+}
+
+bool Material::CanDrawInstanced()
+{
+	return instancedVertexShader && instancedVertexShader->GetPerInstanceCompatible();
 }
 
 void Material::SetRoughness(float roughness)
@@ -54,40 +98,79 @@ void Material::SetRoughness(float roughness)
 void Material::AddTextureSRV(std::string textureName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	textureSRVs.insert({ textureName, srv });
+	ResolvePixelShaderHandles();
 }
 
 void Material::AddSampler(std::string samplerName, Microsoft::WRL::ComPtr<ID3D11SamplerState> ss)
 {
 	samplers.insert({ samplerName,ss });
+	ResolvePixelShaderHandles();
 }
 
-void Material::PrepareMaterialForDraw(Transform* transform, std::shared_ptr<Camera> camera)
+void Material::Bind(const Material* previous, bool instanced)
 {
-	//Set vertex shader constant buffer data
+	//anything the previous material left in the same pixel shader can stay
+	bool samePixelShader = previous && previous->pixelShader == pixelShader;
+
+	//Set pixel shader per-material data
+	if (!samePixelShader || !Float3Equal(previous->colorTint, colorTint))
 	{
-		vertexShader->SetMatrix4x4("world", transform->GetWorldMatrix());
-		vertexShader->SetMatrix4x4("worldInvTranspose", transform->GetWorldInverseTransposeMatrix());
-		vertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
-		vertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+		ShaderLayouts::PixelShader_PerMaterial perMaterial = {};
+		perMaterial.colorTint = colorTint;
+		pixelShader->SetBufferData(perMaterialHandle, &perMaterial, sizeof(perMaterial));
+		pixelShader->CopyBufferData(SIMPLE_BUFFER_PER_MATERIAL);
 	}
-	vertexShader->CopyAllBufferData();
 
-	//Set pixel shader constant buffer data
+	//set pixel shader texture and sampler data
+	for (auto& t : boundTextureSRVs)
+	{
+		if (!samePixelShader || !HasBinding(previous->boundTextureSRVs, t))
+			pixelShader->SetShaderResourceView(t.first, t.second);
+	}
+	for (auto& s : boundSamplers)
 	{
-		pixelShader->SetFloat3("colorTint", colorTint);
-		pixelShader->SetFloat("roughness", roughness);
-		pixelShader->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
-		pixelShader->SetFloat3("ambientTerm", camera->GetAmbientColor());
+		if (!samePixelShader || !HasBinding(previous->boundSamplers, s))
+			pixelShader->SetSamplerState(s.first, s.second);
 	}
-	pixelShader->CopyAllBufferData();
 
-	//set pixel shader texture and sampler data
-	for (auto& t : textureSRVs) { pixelShader->SetShaderResourceView(t.first.c_str(), t.second); }
-	for (auto& s : samplers) { pixelShader->SetSamplerState(s.first.c_str(), s.second); }
+	//Set shaders as active - or again, if a copy overflowed the
+	//constant buffer ring and took their bound buffers with it
+	SimpleVertexShader* vs = instanced ? instancedVertexShader.get() : vertexShader.get();
+	if (!previous || previous->boundVertexShader != vs || vs->HasExpiredRingData())
+		vs->SetShader();
+	boundVertexShader = vs;
+	if (!samePixelShader || pixelShader->HasExpiredRingData())
+		pixelShader->SetShader();
+}
 
-	//Set shaders as active
-	vertexShader->SetShader();
-	pixelShader->SetShader();
+void Material::SetObjectData(Transform* transform)
+{
+	//Set vertex shader per-object data
+	{
+		ShaderLayouts::VertexShader_PerObject perObject;
+		perObject.world = transform->GetWorldMatrix();
+		perObject.worldInvTranspose = transform->GetWorldInverseTransposeMatrix();
+		vertexShader->SetBufferData(perObjectHandle, &perObject, sizeof(perObject));
+	}
+	vertexShader->CopyBufferData(SIMPLE_BUFFER_PER_OBJECT);
+
+	//an overflow in that copy also took the pixel shader's buffers
+	if (pixelShader->HasExpiredRingData())
+		pixelShader->SetShader();
+}
+
+void Material::ResolveVertexShaderHandles()
+{
+	perObjectHandle = vertexShader->GetBufferHandle("PerObject");
 }
 
+void Material::ResolvePixelShaderHandles()
+{
+	perMaterialHandle = pixelShader->GetBufferHandle("PerMaterial");
+
+	boundTextureSRVs.clear();
+	for (auto& t : textureSRVs) { boundTextureSRVs.push_back({ pixelShader->GetShaderResourceViewHandle(t.first), t.second }); }
 
+	boundSamplers.clear();
+	for (auto& s : samplers) { boundSamplers.push_back({ pixelShader->GetSamplerHandle(s.first), s.second }); }
+}
@@ -4,8 +4,8 @@
 #include <memory>
 #include "SimpleShader/SimpleShader.h"
 #include <unordered_map>
+#include <vector>
 #include "Transform.h"
-#include "Camera.h"
 
 class Material
 {
@@ -16,27 +16,57 @@ public:
 	//Getters
 	DirectX::XMFLOAT3 GetColorTint();
 	float GetRoughness();
-	std::shared_ptr<SimpleVertexShader> GetVertexShader();
-	std::shared_ptr<SimplePixelShader> GetPixelShader();
+	//(borrowed - the material keeps them alive)
+	SimpleVertexShader* GetVertexShader();
+	SimplePixelShader* GetPixelShader();
+	//small number unique to this material, for draw sort keys
+	unsigned int GetSortId();
 	
 	//Setters
 	void SetColorTint(DirectX::XMFLOAT3);
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader>);
 	void SetPixelShader(std::shared_ptr<SimplePixelShader>);
+	//vertex shader to use in place of the normal one when drawing
+	//instanced (it must take its matrices from the instance buffer)
+	void SetInstancedVertexShader(std::shared_ptr<SimpleVertexShader>);
+	bool CanDrawInstanced();
 	void SetRoughness(float);
 
 	void AddTextureSRV(std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>);
 	void AddSampler(std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>);
 
-	//Before Draw
-	void PrepareMaterialForDraw(Transform*, std::shared_ptr<Camera>);
+	//Before Draw - Bind() once whenever the material changes, then
+	//SetObjectData() for each object drawn with it.  Per frame data
+	//(camera, lights) is up to whoever owns the shaders.
+	//Passing the material drawn just before skips whatever it
+	//already left bound (shaders, per material data, textures).
+	//Instanced binds the instanced vertex shader instead, and then
+	//there's no SetObjectData() - see InstanceBatcher.
+	void Bind(const Material* previous = 0, bool instanced = false);
+	void SetObjectData(Transform*);
 private:
 	DirectX::XMFLOAT3 colorTint;
 	float roughness; //obsolete
+	unsigned int sortId;
+	static unsigned int nextSortId;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
 	std::shared_ptr<SimplePixelShader> pixelShader;
+	std::shared_ptr<SimpleVertexShader> instancedVertexShader;
+	//whichever vertex shader the last Bind() set
+	SimpleVertexShader* boundVertexShader;
 
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
+
+	//shader handles, looked up again whenever a shader or resource changes.
+	//The buffers are filled from the structs in ShaderLayouts.h, so the
+	//shaders need the same PerObject and PerMaterial layouts as the lit ones.
+	SimpleBufferHandle perObjectHandle;
+	SimpleBufferHandle perMaterialHandle;
+	std::vector<std::pair<SimpleSRVHandle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>> boundTextureSRVs;
+	std::vector<std::pair<SimpleSamplerHandle, Microsoft::WRL::ComPtr<ID3D11SamplerState>>> boundSamplers;
+
+	void ResolveVertexShaderHandles();
+	void ResolvePixelShaderHandles();
 };
 
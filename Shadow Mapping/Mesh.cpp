@@ -1,9 +1,19 @@
 #include "Mesh.h"
-#include <fstream>
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshTangents.h"
 #include <vector>
+#include <algorithm>
 
 using namespace DirectX;
 
+bool Mesh::OptimizeIndices = true;
+bool Mesh::OptimizeOverdraw = false;
+bool Mesh::GenerateLods = true;
+
+unsigned int Mesh::nextSortId = 0;
+
 Mesh::Mesh(Vertex* vertices,
 	unsigned int verticesNum,
 	unsigned int* indices,
@@ -11,229 +21,97 @@ Mesh::Mesh(Vertex* vertices,
 	Microsoft::WRL::ComPtr<ID3D11Device> device,
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context)
 {
+	CalculateTangents(vertices, verticesNum, indices, indicesNum);
+	CalculateBounds(vertices, verticesNum);
 	InitMeshAndCreateBuffers(vertices,verticesNum, indices, indicesNum, device, context);
+
+	lods[0] = { 0, indicesNum, 0.0f };
+	lodCount = 1;
+	sortId = nextSortId++;
 }
 
 Mesh::Mesh(const wchar_t* filename, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
-	// Author: Chris Cascioli
-	// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-	// 
-	// - You are allowed to directly copy/paste this into your code base
-	//   for assignments, given that you clearly cite that this is not
-	//   code of your own design.
-	//
-	// - NOTE: You'll need to #include <fstream>
-
-	// File input object
-	std::ifstream obj(filename);
-
-	// Check for successful open
-	if (!obj.is_open())
+	lods[0] = { 0, 0, 0.0f };
+	lodCount = 1;
+	sortId = nextSortId++;
+	boundsMin = XMFLOAT3(0, 0, 0);
+	boundsMax = XMFLOAT3(0, 0, 0);
+	boundsRadius = 0.0f;
+
+	// Map the source so we can hash it, and parse it if needed
+	MappedFile objFile;
+	if (!objFile.Open(filename))
 		return;
 
-	// Variables used while reading the file
-	std::vector<DirectX::XMFLOAT3> positions;	// Positions from the file
-	std::vector<DirectX::XMFLOAT3> normals;		// Normals from the file
-	std::vector<DirectX::XMFLOAT2> uvs;			// UVs from the file
-	std::vector<Vertex> verts;					// Verts we're assembling
-	std::vector<UINT> indices;					// Indices of these verts
-	int vertCounter = 0;						// Count of vertices
-	int indexCounter = 0;						// Count of indices
-	char chars[100];							// String for line reading
-	
-	//Read obj file
+	unsigned long long sourceHash = HashMeshSource(objFile.GetData(), objFile.GetSize());
+	std::wstring cachePath = GetMeshCachePath(filename);
+
+	unsigned int buildFlags = 0;
+	if (OptimizeIndices)
+	{
+		buildFlags |= MESH_BUILD_OPTIMIZE_INDICES;
+		if (OptimizeOverdraw)
+			buildFlags |= MESH_BUILD_OPTIMIZE_OVERDRAW;
+	}
+	if (GenerateLods)
+		buildFlags |= MESH_BUILD_GENERATE_LODS;
+
+	// Warm start: a valid .meshbin already holds the final vertices (tangents
+	// included) and indices, so the mapped pages go straight to the GPU
 	{
-		// Still have data left?
-		while (obj.good())
+		MappedFile cacheFile;
+		MeshCacheView cached;
+		if (OpenMeshCache(cachePath.c_str(), sourceHash, buildFlags, cacheFile, cached))
 		{
-			// Get the line (100 characters should be more than enough)
-			obj.getline(chars, 100);
-
-			// Check the type of line
-			if (chars[0] == 'v' && chars[1] == 'n')
-			{
-				// Read the 3 numbers directly into an XMFLOAT3
-				DirectX::XMFLOAT3 norm;
-				sscanf_s(
-					chars,
-					"vn %f %f %f",
-					&norm.x, &norm.y, &norm.z);
-
-				// Add to the list of normals
-				normals.push_back(norm);
-			}
-			else if (chars[0] == 'v' && chars[1] == 't')
-			{
-				// Read the 2 numbers directly into an XMFLOAT2
-				DirectX::XMFLOAT2 uv;
-				sscanf_s(
-					chars,
-					"vt %f %f",
-					&uv.x, &uv.y);
-
-				// Add to the list of uv's
-				uvs.push_back(uv);
-			}
-			else if (chars[0] == 'v')
-			{
-				// Read the 3 numbers directly into an XMFLOAT3
-				DirectX::XMFLOAT3 pos;
-				sscanf_s(
-					chars,
-					"v %f %f %f",
-					&pos.x, &pos.y, &pos.z);
-
-				// Add to the positions
-				positions.push_back(pos);
-			}
-			else if (chars[0] == 'f')
-			{
-				// Read the face indices into an array
-				// NOTE: This assumes the given obj file contains
-				//  vertex positions, uv coordinates AND normals.
-				unsigned int i[12];
-				int numbersRead = sscanf_s(
-					chars,
-					"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-					&i[0], &i[1], &i[2],
-					&i[3], &i[4], &i[5],
-					&i[6], &i[7], &i[8],
-					&i[9], &i[10], &i[11]);
-
-				// If we only got the first number, chances are the OBJ
-				// file has no UV coordinates.  This isn't great, but we
-				// still want to load the model without crashing, so we
-				// need to re-read a different pattern (in which we assume
-				// there are no UVs denoted for any of the vertices)
-				if (numbersRead == 1)
-				{
-					// Re-read with a different pattern
-					numbersRead = sscanf_s(
-						chars,
-						"f %d//%d %d//%d %d//%d %d//%d",
-						&i[0], &i[2],
-						&i[3], &i[5],
-						&i[6], &i[8],
-						&i[9], &i[11]);
-
-					// The following indices are where the UVs should 
-					// have been, so give them a valid value
-					i[1] = 1;
-					i[4] = 1;
-					i[7] = 1;
-					i[10] = 1;
-
-					// If we have no UVs, create a single UV coordinate
-					// that will be used for all vertices
-					if (uvs.size() == 0)
-						uvs.push_back(DirectX::XMFLOAT2(0, 0));
-				}
-
-				// - Create the verts by looking up
-				//    corresponding data from vectors
-				// - OBJ File indices are 1-based, so
-				//    they need to be adusted
-				Vertex v1;
-				v1.Position = positions[i[0] - 1];
-				v1.UV = uvs[i[1] - 1];
-				v1.Normal = normals[i[2] - 1];
-
-				Vertex v2;
-				v2.Position = positions[i[3] - 1];
-				v2.UV = uvs[i[4] - 1];
-				v2.Normal = normals[i[5] - 1];
-
-				Vertex v3;
-				v3.Position = positions[i[6] - 1];
-				v3.UV = uvs[i[7] - 1];
-				v3.Normal = normals[i[8] - 1];
-
-				// The model is most likely in a right-handed space,
-				// especially if it came from Maya.  We want to convert
-				// to a left-handed space for DirectX.  This means we 
-				// need to:
-				//  - Invert the Z position
-				//  - Invert the normal's Z
-				//  - Flip the winding order
-				// We also need to flip the UV coordinate since DirectX
-				// defines (0,0) as the top left of the texture, and many
-				// 3D modeling packages use the bottom left as (0,0)
-
-				// Flip the UV's since they're probably "upside down"
-				v1.UV.y = 1.0f - v1.UV.y;
-				v2.UV.y = 1.0f - v2.UV.y;
-				v3.UV.y = 1.0f - v3.UV.y;
-
-				// Flip Z (LH vs. RH)
-				v1.Position.z *= -1.0f;
-				v2.Position.z *= -1.0f;
-				v3.Position.z *= -1.0f;
-
-				// Flip normal's Z
-				v1.Normal.z *= -1.0f;
-				v2.Normal.z *= -1.0f;
-				v3.Normal.z *= -1.0f;
-
-				// Add the verts to the vector (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v3);
-				verts.push_back(v2);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-
-				// Was there a 4th face?
-				// - 12 numbers read means 4 faces WITH uv's
-				// - 8 numbers read means 4 faces WITHOUT uv's
-				if (numbersRead == 12 || numbersRead == 8)
-				{
-					// Make the last vertex
-					Vertex v4;
-					v4.Position = positions[i[9] - 1];
-					v4.UV = uvs[i[10] - 1];
-					v4.Normal = normals[i[11] - 1];
-
-					// Flip the UV, Z pos and normal's Z
-					v4.UV.y = 1.0f - v4.UV.y;
-					v4.Position.z *= -1.0f;
-					v4.Normal.z *= -1.0f;
-
-					// Add a whole triangle (flipping the winding order)
-					verts.push_back(v1);
-					verts.push_back(v4);
-					verts.push_back(v3);
-					vertCounter += 3;
-
-					// Add three more indices
-					indices.push_back(indexCounter); indexCounter += 1;
-					indices.push_back(indexCounter); indexCounter += 1;
-					indices.push_back(indexCounter); indexCounter += 1;
-				}
-			}
+			boundsMin = cached.Header->BoundsMin;
+			boundsMax = cached.Header->BoundsMax;
+			boundsRadius = cached.Header->BoundsRadius;
+			InitMeshAndCreateBuffers(cached.Vertices, cached.Header->VertexCount, cached.Indices, cached.Header->IndexCount, device, context);
+
+			lodCount = cached.Header->LodCount;
+			for (unsigned int i = 0; i < lodCount; i++)
+				lods[i] = cached.Header->Lods[i];
+			return;
 		}
+	}
+
+	// Cold start: parse the whole file in one pass
+	// (see ObjParser.cpp for the details of the format handling)
+	ObjData obj;
+	if (!ParseObj(objFile.GetData(), objFile.GetSize(), obj) || obj.Corners.empty())
+		return;
 
-		// Close the file and create the actual buffers
-		obj.close();
-
-		// - At this point, "verts" is a vector of Vertex structs, and can be used
-		//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-		//
-		// - The vector "indices" is similar. It's a vector of unsigned ints and
-		//    can be used directly for the index buffer: &indices[0] is the address of the first int
-		//
-		// - "vertCounter" is the number of vertices
-		// - "indexCounter" is the number of indices
-		// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
-		//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
-		//    and detect duplicate vertices, but at that point it would be better to use a more
-		//    sophisticated model loading library like TinyOBJLoader or The Open Asset Importer Library
+	std::vector<Vertex> verts;			// Verts we're assembling
+	std::vector<unsigned int> indices;	// Indices of these verts
+	BuildObjVertices(obj, verts, indices);
+
+	// Reorder triangles for the post-transform cache, then
+	// reorder vertices to match so fetches stay sequential
+	if (OptimizeIndices)
+	{
+		OptimizeVertexCache(&indices[0], indices.size(), verts.size());
+		if (OptimizeOverdraw)
+			::OptimizeOverdraw(&indices[0], indices.size(), &verts[0], verts.size());
+		OptimizeVertexFetch(verts, indices);
 	}
 
-	InitMeshAndCreateBuffers(&verts[0], vertCounter, &indices[0], indexCounter, device, context);
+	unsigned int vertCount = (unsigned int)verts.size();
+	CalculateTangents(&verts[0], vertCount, &indices[0], (int)indices.size());
+	CalculateBounds(&verts[0], vertCount);
+
+	// Coarser levels reuse the same vertices, so their indices are
+	// simply appended after the full detail ones
+	lods[0] = { 0, (unsigned int)indices.size(), 0.0f };
+	lodCount = 1;
+	if (GenerateLods)
+		lodCount = BuildLodChain(verts, indices, lods, OptimizeIndices);
+
+	unsigned int indexCounter = (unsigned int)indices.size();
+	InitMeshAndCreateBuffers(&verts[0], vertCount, &indices[0], indexCounter, device, context);
+
+	// Save the final data so the next run can skip all of the above
+	WriteMeshCache(cachePath.c_str(), sourceHash, buildFlags, &verts[0], vertCount, &indices[0], indexCounter, lods, lodCount, boundsMin, boundsMax, boundsRadius);
 }
 
 Mesh::~Mesh()
@@ -253,31 +131,93 @@ Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
 	return this->indexBuffer;
 }
 
+//index count of the full detail mesh
 unsigned int Mesh::GetIndexCount()
 {
-	return this->indexCount;
+	return this->lods[0].IndexCount;
 }
 
-void Mesh::Draw()
+unsigned int Mesh::GetLodCount()
+{
+	return this->lodCount;
+}
+
+unsigned int Mesh::GetSortId()
+{
+	return this->sortId;
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsMin()
+{
+	return this->boundsMin;
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsMax()
+{
+	return this->boundsMax;
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsCenter()
+{
+	return XMFLOAT3(
+		(boundsMin.x + boundsMax.x) * 0.5f,
+		(boundsMin.y + boundsMax.y) * 0.5f,
+		(boundsMin.z + boundsMax.z) * 0.5f);
+}
+
+float Mesh::GetBoundsRadius()
+{
+	return this->boundsRadius;
+}
+
+//draws the given level of detail (clamped to the coarsest one available)
+void Mesh::Draw(unsigned int lod)
+{
+	Bind();
+	DrawBound(lod);
+}
+
+void Mesh::Bind()
 {
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 
 	context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
 	context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+}
+
+void Mesh::DrawBound(unsigned int lod)
+{
+	if (lod >= lodCount)
+		lod = lodCount - 1;
 
 	context->DrawIndexed(
-		indexCount,     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
+		lods[lod].IndexCount,     // The number of indices to use (just this LOD's range)
+		lods[lod].StartIndex,     // Offset to the first index we want to use
 		0);
 }
 
-void Mesh::InitMeshAndCreateBuffers(Vertex* vertices, unsigned int verticesNum, unsigned int* indices, unsigned int indicesNum, Microsoft::WRL::ComPtr<ID3D11Device> device,
+void Mesh::DrawBoundInstanced(unsigned int lod, unsigned int instanceCount, unsigned int firstInstance)
+{
+	if (lod >= lodCount)
+		lod = lodCount - 1;
+
+	context->DrawIndexedInstanced(
+		lods[lod].IndexCount,     // The number of indices per instance (just this LOD's range)
+		instanceCount,
+		lods[lod].StartIndex,     // Offset to the first index we want to use
+		0,
+		firstInstance);           // Where this batch's instances start in the instance buffer
+}
+
+// --------------------------------------------------------
+// Creates the GPU buffers from finished vertex data.
+// Tangents must already be calculated, since the data may
+// come straight from a read-only mapped cache file.
+// --------------------------------------------------------
+void Mesh::InitMeshAndCreateBuffers(const Vertex* vertices, unsigned int verticesNum, const unsigned int* indices, unsigned int indicesNum, Microsoft::WRL::ComPtr<ID3D11Device> device,
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context)
 {	
-	//calculate tangents
-	CalculateTangents(vertices, verticesNum, indices, indicesNum);
-
 	//Vertex Buffer Creation
 	{
 		D3D11_BUFFER_DESC vbd = {};
@@ -314,95 +254,39 @@ void Mesh::InitMeshAndCreateBuffers(Vertex* vertices, unsigned int verticesNum,
 	}
 
 	this->context = context;
-	this->indexCount = indicesNum;
 }
 
-// --------------------------------------------------------
-// Author: Chris Cascioli
-// Purpose: Calculates the tangents of the vertices in a mesh
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-//         contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
-// --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+//finds the local space axis-aligned bounds of the vertices,
+//and the smallest sphere around their center that holds them all
+void Mesh::CalculateBounds(const Vertex* verts, unsigned int numVerts)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
+	if (numVerts == 0)
 	{
-		verts[i].Tangent = DirectX::XMFLOAT3(0, 0, 0);
+		boundsMin = XMFLOAT3(0, 0, 0);
+		boundsMax = XMFLOAT3(0, 0, 0);
+		boundsRadius = 0.0f;
+		return;
 	}
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
+	XMVECTOR minV = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR maxV = minV;
+	for (unsigned int i = 1; i < numVerts; i++)
 	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
+		XMVECTOR pos = XMLoadFloat3(&verts[i].Position);
+		minV = XMVectorMin(minV, pos);
+		maxV = XMVectorMax(maxV, pos);
 	}
 
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		DirectX::XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		DirectX::XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
+	XMStoreFloat3(&boundsMin, minV);
+	XMStoreFloat3(&boundsMax, maxV);
 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
+	//usually tighter than half the diagonal of the box
+	XMVECTOR center = XMVectorScale(XMVectorAdd(minV, maxV), 0.5f);
+	XMVECTOR maxDistanceSq = XMVectorZero();
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&verts[i].Position), center);
+		maxDistanceSq = XMVectorMax(maxDistanceSq, XMVector3LengthSq(offset));
 	}
+	boundsRadius = XMVectorGetX(XMVectorSqrt(maxDistanceSq));
 }
@@ -3,6 +3,7 @@
 #include <wrl/client.h>
 #include <d3d11.h>
 #include "Vertex.h"
+#include "MeshSimplifier.h"
 
 class Mesh
 {
@@ -22,7 +23,29 @@ public:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	unsigned int GetIndexCount();
-	void Draw();
+	unsigned int GetLodCount();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+	//small number unique to this mesh, for draw sort keys
+	unsigned int GetSortId();
+
+	//Draw binds the buffers every time.  When drawing the same mesh
+	//over and over, Bind() it once and use DrawBound() instead.
+	void Draw(unsigned int lod = 0);
+	void Bind();
+	void DrawBound(unsigned int lod = 0);
+	//draws instanceCount copies with the bound instance buffer,
+	//starting firstInstance instances into it
+	void DrawBoundInstanced(unsigned int lod, unsigned int instanceCount, unsigned int firstInstance);
+
+	// Reorder OBJ meshes for the post-transform cache and vertex fetch on load
+	static bool OptimizeIndices;
+	// Also reorder triangle clusters to reduce overdraw (costs some cache efficiency)
+	static bool OptimizeOverdraw;
+	// Build simplified levels of detail for OBJ meshes on load
+	static bool GenerateLods;
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
@@ -30,18 +53,26 @@ private:
 
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
 
-	unsigned int indexCount;
+	unsigned int sortId;
+	static unsigned int nextSortId;
+
+	//ranges of the index buffer to draw for each level of detail
+	MeshLod lods[MESH_MAX_LODS];
+	unsigned int lodCount;
 
-	void InitMeshAndCreateBuffers(Vertex* vertices,
+	//local space bounds of the vertices
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	//radius of a sphere around the center of the bounds holding every vertex
+	float boundsRadius;
+
+	void InitMeshAndCreateBuffers(const Vertex* vertices,
 		unsigned int verticesNum,
-		unsigned int* indices,
+		const unsigned int* indices,
 		unsigned int indicesNum,
 		Microsoft::WRL::ComPtr<ID3D11Device> device,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context);
 
-	void CalculateTangents(Vertex* verts,
-		int numVerts,
-		unsigned int* indices,
-		int numIndices);
+	void CalculateBounds(const Vertex* verts, unsigned int numVerts);
 };
 
@@ -0,0 +1,148 @@
+#include "MeshCache.h"
+#include <fstream>
+#include <cstring>
+
+namespace
+{
+	const unsigned long long Prime1 = 0x9E3779B185EBCA87ull;
+	const unsigned long long Prime2 = 0xC2B2AE3D27D4EB4Full;
+	const unsigned long long Prime3 = 0x165667B19E3779F9ull;
+
+	inline unsigned long long RotateLeft(unsigned long long x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+}
+
+// --------------------------------------------------------
+// Hashes a block of memory 8 bytes at a time.  This runs on
+// every load, so it needs to be much cheaper than parsing.
+// --------------------------------------------------------
+unsigned long long HashMeshSource(const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + size;
+	unsigned long long h = Prime3 ^ (size * Prime1);
+
+	while (end - p >= 8)
+	{
+		unsigned long long word;
+		memcpy(&word, p, 8);
+		word = RotateLeft(word * Prime2, 31) * Prime1;
+		h = RotateLeft(h ^ word, 27) * Prime1 + Prime3;
+		p += 8;
+	}
+
+	while (p < end)
+	{
+		h = RotateLeft(h ^ (*p * Prime3), 11) * Prime1;
+		p++;
+	}
+
+	// Final mix so every input bit affects every output bit
+	h ^= h >> 33;
+	h *= Prime2;
+	h ^= h >> 29;
+	h *= Prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+std::wstring GetMeshCachePath(const wchar_t* sourceFile)
+{
+	std::wstring path = sourceFile;
+
+	// Only strip an extension that belongs to the file name itself
+	size_t dot = path.find_last_of(L'.');
+	size_t slash = path.find_last_of(L"\\/");
+	if (dot != std::wstring::npos && (slash == std::wstring::npos || dot > slash))
+		path.erase(dot);
+
+	return path + L".meshbin";
+}
+
+// --------------------------------------------------------
+// Maps a .meshbin file and points the view straight at the
+// mapped pages.  Fails (so the caller falls back to the source
+// file) if the file is missing, stale or malformed.
+// --------------------------------------------------------
+bool OpenMeshCache(const wchar_t* cacheFile, unsigned long long sourceHash, unsigned int buildFlags, MappedFile& file, MeshCacheView& view)
+{
+	if (!file.Open(cacheFile))
+		return false;
+
+	size_t size = file.GetSize();
+	if (size < sizeof(MeshCacheHeader))
+	{
+		file.Close();
+		return false;
+	}
+
+	const MeshCacheHeader* header = (const MeshCacheHeader*)file.GetData();
+	size_t expectedSize = sizeof(MeshCacheHeader) +
+		(size_t)header->VertexCount * sizeof(Vertex) +
+		(size_t)header->IndexCount * sizeof(unsigned int);
+
+	if (header->Magic != MESH_CACHE_MAGIC ||
+		header->Version != MESH_CACHE_VERSION ||
+		header->VertexSize != sizeof(Vertex) ||
+		header->SourceHash != sourceHash ||
+		header->BuildFlags != buildFlags ||
+		header->VertexCount == 0 ||
+		header->IndexCount == 0 ||
+		header->LodCount == 0 ||
+		header->LodCount > MESH_MAX_LODS ||
+		size != expectedSize)
+	{
+		file.Close();
+		return false;
+	}
+
+	for (unsigned int i = 0; i < header->LodCount; i++)
+	{
+		const MeshLod& lod = header->Lods[i];
+		if (lod.StartIndex > header->IndexCount || lod.IndexCount > header->IndexCount - lod.StartIndex)
+		{
+			file.Close();
+			return false;
+		}
+	}
+
+	view.Header = header;
+	view.Vertices = (const Vertex*)(header + 1);
+	view.Indices = (const unsigned int*)(view.Vertices + header->VertexCount);
+	return true;
+}
+
+bool WriteMeshCache(const wchar_t* cacheFile, unsigned long long sourceHash, unsigned int buildFlags,
+	const Vertex* vertices, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount,
+	const MeshLod* lods, unsigned int lodCount,
+	DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, float boundsRadius)
+{
+	std::ofstream out(cacheFile, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	MeshCacheHeader header = {};
+	header.Magic = MESH_CACHE_MAGIC;
+	header.Version = MESH_CACHE_VERSION;
+	header.VertexSize = sizeof(Vertex);
+	header.VertexCount = vertexCount;
+	header.IndexCount = indexCount;
+	header.BuildFlags = buildFlags;
+	header.SourceHash = sourceHash;
+	header.BoundsMin = boundsMin;
+	header.BoundsMax = boundsMax;
+	header.BoundsRadius = boundsRadius;
+	header.LodCount = lodCount;
+	for (unsigned int i = 0; i < lodCount; i++)
+		header.Lods[i] = lods[i];
+
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)vertices, sizeof(Vertex) * vertexCount);
+	out.write((const char*)indices, sizeof(unsigned int) * indexCount);
+
+	// A partially written file fails the size check in OpenMeshCache
+	return out.good();
+}
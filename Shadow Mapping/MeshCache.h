@@ -0,0 +1,64 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include "Vertex.h"
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
+
+// Bits for MeshCacheHeader::BuildFlags
+#define MESH_BUILD_OPTIMIZE_INDICES 0x1
+#define MESH_BUILD_OPTIMIZE_OVERDRAW 0x2
+#define MESH_BUILD_GENERATE_LODS 0x4
+
+// Bump whenever the layout of the file (or the Vertex struct) changes,
+// or what gets built into it does (so old caches aren't trusted)
+#define MESH_CACHE_MAGIC 0x4E49424D // "MBIN"
+#define MESH_CACHE_VERSION 5
+
+// --------------------------------------------------------
+// Header at the start of every .meshbin file.  It is followed
+// directly by VertexCount Vertex structs and then IndexCount
+// unsigned ints, so the whole file can be used in place.
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned int VertexSize;		// sizeof(Vertex) when the file was written
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	unsigned int BuildFlags;		// Which optional processing steps were applied
+	unsigned long long SourceHash;	// Hash of the source file's contents
+	DirectX::XMFLOAT3 BoundsMin;	// Local space bounds of the vertices
+	DirectX::XMFLOAT3 BoundsMax;
+	float BoundsRadius;				// Bounding sphere around the center of the bounds
+	unsigned int LodCount;			// Levels of detail stored in the index data
+	MeshLod Lods[MESH_MAX_LODS];
+};
+
+// --------------------------------------------------------
+// Pointers into a mapped .meshbin file
+// --------------------------------------------------------
+struct MeshCacheView
+{
+	const MeshCacheHeader* Header;
+	const Vertex* Vertices;
+	const unsigned int* Indices;
+};
+
+// Hashes a block of memory (used to detect stale caches)
+unsigned long long HashMeshSource(const void* data, size_t size);
+
+// "Assets/Models/cube.obj" -> "Assets/Models/cube.meshbin"
+std::wstring GetMeshCachePath(const wchar_t* sourceFile);
+
+// Maps a cache file and validates it against the source hash and build flags
+bool OpenMeshCache(const wchar_t* cacheFile, unsigned long long sourceHash, unsigned int buildFlags, MappedFile& file, MeshCacheView& view);
+
+// Writes final vertex/index data out as a cache file
+bool WriteMeshCache(const wchar_t* cacheFile, unsigned long long sourceHash, unsigned int buildFlags,
+	const Vertex* vertices, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount,
+	const MeshLod* lods, unsigned int lodCount,
+	DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, float boundsRadius);
@@ -0,0 +1,382 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Tuning values from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+	const int ForsythCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	// How likely a vertex is to be useful soon, based on where it sits
+	// in the cache and how many unemitted triangles still use it
+	float ScoreVertex(int cachePosition, unsigned int remainingTriangles)
+	{
+		// No triangles left, so it can't add anything
+		if (remainingTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// The last triangle's vertices get a fixed score so we
+			// don't just keep using them to build strips
+			if (cachePosition < 3)
+				score = LastTriScore;
+			else
+			{
+				float scaler = 1.0f / (ForsythCacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few triangles left, so we finish them off
+		// instead of leaving lone triangles to pick up later
+		score += ValenceBoostScale * powf((float)remainingTriangles, -ValenceBoostPower);
+		return score;
+	}
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	inline Float3 Subtract(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	inline Float3 Cross(const Float3& a, const Float3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+}
+
+// --------------------------------------------------------
+// Runs the index buffer through a FIFO cache, counting how
+// many times a vertex would have to be transformed
+// --------------------------------------------------------
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	// A vertex is in the cache if it was transformed fewer than
+	// cacheSize transforms ago
+	std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int timestamp = cacheSize + 1;
+	size_t usedCount = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (timestamp - cacheTimestamps[v] > cacheSize)
+		{
+			cacheTimestamps[v] = timestamp++;
+			stats.Transforms++;
+		}
+
+		if (!used[v])
+		{
+			used[v] = true;
+			usedCount++;
+		}
+	}
+
+	stats.ACMR = (float)stats.Transforms / (indexCount / 3);
+	stats.ATVR = (float)stats.Transforms / usedCount;
+	return stats;
+}
+
+// --------------------------------------------------------
+// Greedily emits the triangle whose vertices score the highest,
+// re-scoring only the vertices that moved through the simulated
+// LRU cache after each triangle.
+// --------------------------------------------------------
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	// Build vertex -> triangle adjacency as one flat array
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		remaining[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	{
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+			for (int k = 0; k < 3; k++)
+				adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+	}
+
+	// Initial scores
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = ScoreVertex(-1, remaining[v]);
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> output(triangleCount * 3);
+
+	// LRU cache, with room for a whole triangle to be pushed in
+	unsigned int cache[ForsythCacheSize + 3];
+	unsigned int newCache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+
+	size_t scanCursor = 0;
+	int bestTriangle = -1;
+
+	for (size_t outTri = 0; outTri < triangleCount; outTri++)
+	{
+		// Nothing in the cache is useful, so pick up the next
+		// triangle that hasn't been emitted yet
+		if (bestTriangle < 0)
+		{
+			while (emitted[scanCursor])
+				scanCursor++;
+			bestTriangle = (int)scanCursor;
+		}
+
+		const unsigned int* tri = &indices[bestTriangle * 3];
+		output[outTri * 3 + 0] = tri[0];
+		output[outTri * 3 + 1] = tri[1];
+		output[outTri * 3 + 2] = tri[2];
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from its vertices' adjacency lists
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int a = 0; a < remaining[v]; a++)
+			{
+				if (list[a] == (unsigned int)bestTriangle)
+				{
+					list[a] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// Push the triangle's vertices to the front of the cache
+		int newCount = 0;
+		for (int k = 0; k < 3; k++)
+			newCache[newCount++] = tri[k];
+
+		for (int c = 0; c < cacheCount; c++)
+		{
+			unsigned int v = cache[c];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Anything pushed past the end falls out of the cache
+		for (int c = ForsythCacheSize; c < newCount; c++)
+		{
+			cachePositions[newCache[c]] = -1;
+			vertexScores[newCache[c]] = ScoreVertex(-1, remaining[newCache[c]]);
+		}
+
+		cacheCount = (std::min)(newCount, ForsythCacheSize);
+		for (int c = 0; c < cacheCount; c++)
+		{
+			cache[c] = newCache[c];
+			cachePositions[cache[c]] = c;
+			vertexScores[cache[c]] = ScoreVertex(c, remaining[cache[c]]);
+		}
+
+		// Re-score the triangles touching the cache and find the best one
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int c = 0; c < cacheCount; c++)
+		{
+			unsigned int v = cache[c];
+			const unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int a = 0; a < remaining[v]; a++)
+			{
+				unsigned int t = list[a];
+				float score =
+					vertexScores[indices[t * 3 + 0]] +
+					vertexScores[indices[t * 3 + 1]] +
+					vertexScores[indices[t * 3 + 2]];
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = (int)t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// --------------------------------------------------------
+// Splits the (already cache optimized) triangle list into
+// clusters wherever the cache starts over, then sorts the
+// clusters so the ones facing away from the mesh center are
+// drawn first.  They are the most likely to occlude the rest.
+// --------------------------------------------------------
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	// Cluster boundaries are triangles where all 3 vertices miss the cache
+	std::vector<size_t> clusterStarts;
+	{
+		std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+		unsigned int timestamp = MESH_OPT_SIMULATED_CACHE_SIZE + 1;
+
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			int misses = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (timestamp - cacheTimestamps[v] > MESH_OPT_SIMULATED_CACHE_SIZE)
+				{
+					cacheTimestamps[v] = timestamp++;
+					misses++;
+				}
+			}
+
+			if (t == 0 || misses == 3)
+				clusterStarts.push_back(t);
+		}
+	}
+
+	size_t clusterCount = clusterStarts.size();
+	if (clusterCount < 2)
+		return;
+
+	// Area weighted center of the whole mesh
+	Float3 meshCenter = { 0, 0, 0 };
+	float meshArea = 0.0f;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const DirectX::XMFLOAT3& p0 = vertices[indices[t * 3 + 0]].Position;
+		const DirectX::XMFLOAT3& p1 = vertices[indices[t * 3 + 1]].Position;
+		const DirectX::XMFLOAT3& p2 = vertices[indices[t * 3 + 2]].Position;
+
+		Float3 n = Cross(Subtract(p1, p0), Subtract(p2, p0));
+		float area = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+		meshCenter.x += (p0.x + p1.x + p2.x) / 3.0f * area;
+		meshCenter.y += (p0.y + p1.y + p2.y) / 3.0f * area;
+		meshCenter.z += (p0.z + p1.z + p2.z) / 3.0f * area;
+		meshArea += area;
+	}
+
+	if (meshArea > 0.0f)
+	{
+		meshCenter.x /= meshArea;
+		meshCenter.y /= meshArea;
+		meshCenter.z /= meshArea;
+	}
+
+	// Sort key per cluster: how far its center sits along its
+	// average normal, relative to the mesh center
+	std::vector<float> clusterKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		size_t start = clusterStarts[c];
+		size_t end = (c + 1 < clusterCount) ? clusterStarts[c + 1] : triangleCount;
+
+		Float3 center = { 0, 0, 0 };
+		Float3 normal = { 0, 0, 0 };
+		float clusterArea = 0.0f;
+
+		for (size_t t = start; t < end; t++)
+		{
+			const DirectX::XMFLOAT3& p0 = vertices[indices[t * 3 + 0]].Position;
+			const DirectX::XMFLOAT3& p1 = vertices[indices[t * 3 + 1]].Position;
+			const DirectX::XMFLOAT3& p2 = vertices[indices[t * 3 + 2]].Position;
+
+			// Un-normalized cross product is area weighted already
+			Float3 n = Cross(Subtract(p1, p0), Subtract(p2, p0));
+			float area = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+			normal.x += n.x;
+			normal.y += n.y;
+			normal.z += n.z;
+
+			center.x += (p0.x + p1.x + p2.x) / 3.0f * area;
+			center.y += (p0.y + p1.y + p2.y) / 3.0f * area;
+			center.z += (p0.z + p1.z + p2.z) / 3.0f * area;
+			clusterArea += area;
+		}
+
+		float normalLength = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		if (clusterArea <= 0.0f || normalLength <= 0.0f)
+		{
+			clusterKeys[c] = 0.0f;
+			continue;
+		}
+
+		center.x = center.x / clusterArea - meshCenter.x;
+		center.y = center.y / clusterArea - meshCenter.y;
+		center.z = center.z / clusterArea - meshCenter.z;
+
+		clusterKeys[c] = (center.x * normal.x + center.y * normal.y + center.z * normal.z) / normalLength;
+	}
+
+	// Highest key first, keeping the cache order for ties
+	std::vector<size_t> clusterOrder(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		clusterOrder[c] = c;
+
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+		[&clusterKeys](size_t a, size_t b) { return clusterKeys[a] > clusterKeys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	for (size_t c : clusterOrder)
+	{
+		size_t start = clusterStarts[c];
+		size_t end = (c + 1 < clusterCount) ? clusterStarts[c + 1] : triangleCount;
+		output.insert(output.end(), indices + start * 3, indices + end * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// --------------------------------------------------------
+// Renumbers vertices in the order the index buffer first uses
+// them, so vertex fetches walk memory mostly linearly
+// --------------------------------------------------------
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int unused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
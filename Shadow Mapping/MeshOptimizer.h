@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// Size of the FIFO post-transform cache used when measuring meshes
+#define MESH_OPT_SIMULATED_CACHE_SIZE 16
+
+// --------------------------------------------------------
+// Results of running an index buffer through a simulated
+// post-transform vertex cache
+//
+// - ACMR: average cache misses per triangle (0.5 is ideal
+//         for large regular meshes, 3.0 is the worst case)
+// - ATVR: average transforms per vertex (1.0 is ideal)
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	unsigned int Transforms;
+	float ACMR;
+	float ATVR;
+};
+
+// Simulates a FIFO vertex cache of the given size over the index buffer
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = MESH_OPT_SIMULATED_CACHE_SIZE);
+
+// Reorders triangles for post-transform cache locality (Forsyth's algorithm)
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+// Reorders clusters of cache-optimized triangles so outward facing
+// clusters are drawn first, reducing overdraw (Sander et al.)
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount);
+
+// Reorders vertices into the order they are first used, updating the
+// indices to match and dropping unused vertices
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
@@ -0,0 +1,490 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// Symmetric 4x4 matrix measuring the sum of squared distances
+	// to a set of planes (Garland & Heckbert), weighted by area
+	// --------------------------------------------------------
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	void AddPlane(Quadric& q, double nx, double ny, double nz, double d, double w)
+	{
+		q.a00 += w * nx * nx; q.a01 += w * nx * ny; q.a02 += w * nx * nz;
+		q.a11 += w * ny * ny; q.a12 += w * ny * nz;
+		q.a22 += w * nz * nz;
+		q.b0 += w * nx * d; q.b1 += w * ny * d; q.b2 += w * nz * d;
+		q.c += w * d * d;
+		q.weight += w;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+		q.a11 += other.a11; q.a12 += other.a12;
+		q.a22 += other.a22;
+		q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+		q.c += other.c;
+		q.weight += other.weight;
+	}
+
+	// Area weighted squared distance from p to the quadric's planes
+	double QuadricError(const Quadric& q, const XMFLOAT3& p)
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double e =
+			q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z +
+			q.a11 * y * y + 2 * q.a12 * y * z +
+			q.a22 * z * z +
+			2 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+			q.c;
+		return e < 0 ? 0 : e;
+	}
+
+	XMFLOAT3 TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+	{
+		float ux = p1.x - p0.x, uy = p1.y - p0.y, uz = p1.z - p0.z;
+		float vx = p2.x - p0.x, vy = p2.y - p0.y, vz = p2.z - p0.z;
+		return XMFLOAT3(uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	struct Collapse
+	{
+		unsigned int From;	// Vertex being removed
+		unsigned int To;	// Vertex it's merged into
+		float Cost;
+	};
+
+	// Ends a list of a position's distinct vertices
+	const unsigned int NoWedge = 0xFFFFFFFF;
+
+	// The vertex in to's position group most like v, to move v onto
+	// when its position collapses across a seam
+	unsigned int ClosestWedge(const Vertex* vertices, const std::vector<unsigned int>& nextWedge, unsigned int to, unsigned int v)
+	{
+		unsigned int closest = to;
+		float closestScore = -FLT_MAX;
+		for (unsigned int w = to; w != NoWedge; w = nextWedge[w])
+		{
+			float du = vertices[w].UV.x - vertices[v].UV.x;
+			float dv = vertices[w].UV.y - vertices[v].UV.y;
+			float score = Dot(vertices[w].Normal, vertices[v].Normal) - (du * du + dv * dv);
+			if (score > closestScore)
+			{
+				closest = w;
+				closestScore = score;
+			}
+		}
+		return closest;
+	}
+}
+
+// --------------------------------------------------------
+// Greedy edge collapse simplification.
+//
+// - Vertices that share a position (uv seams, hard edges) and
+//   vertices on open borders are locked in place, so the mesh
+//   keeps its silhouette and texture layout
+// - Every other vertex can collapse onto a neighbor, which
+//   keeps the result indexing the original vertex buffer
+// - Unless seams are locked, a seam collapses as a whole
+//   position, every vertex there moving to its closest match
+// - Each pass sorts every possible collapse by error and
+//   takes as many of the cheapest as it can without any two
+//   touching the same area
+// --------------------------------------------------------
+float SimplifyMesh(const Vertex* vertices, size_t vertexCount,
+	const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, float targetError, bool lockSeams,
+	std::vector<unsigned int>& destination)
+{
+	destination.assign(indices, indices + indexCount);
+	if (indexCount <= targetIndexCount || vertexCount == 0)
+		return 0.0f;
+
+	// Group vertices by position.  Each group is represented by its
+	// first vertex, and a group holding vertices with different
+	// normals or uvs is a seam.  Exact duplicates aren't seams, they
+	// are just merged into one vertex.  The distinct vertices at each
+	// position are chained from its first through nextWedge.
+	std::vector<unsigned int> canonical(vertexCount);
+	std::vector<unsigned int> duplicateOf(vertexCount);
+	std::vector<unsigned int> nextWedge(vertexCount, NoWedge);
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::vector<unsigned int> sorted(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+			sorted[i] = (unsigned int)i;
+
+		auto samePosition = [vertices](unsigned int a, unsigned int b)
+		{
+			const XMFLOAT3& pa = vertices[a].Position;
+			const XMFLOAT3& pb = vertices[b].Position;
+			return pa.x == pb.x && pa.y == pb.y && pa.z == pb.z;
+		};
+		auto sameAttributes = [vertices](unsigned int a, unsigned int b)
+		{
+			const Vertex& va = vertices[a];
+			const Vertex& vb = vertices[b];
+			return va.Normal.x == vb.Normal.x && va.Normal.y == vb.Normal.y && va.Normal.z == vb.Normal.z &&
+				va.UV.x == vb.UV.x && va.UV.y == vb.UV.y;
+		};
+		auto less = [vertices](unsigned int a, unsigned int b)
+		{
+			const XMFLOAT3& pa = vertices[a].Position;
+			const XMFLOAT3& pb = vertices[b].Position;
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		};
+		std::sort(sorted.begin(), sorted.end(), less);
+
+		for (size_t i = 0; i < vertexCount;)
+		{
+			size_t end = i + 1;
+			while (end < vertexCount && samePosition(sorted[i], sorted[end]))
+				end++;
+
+			bool seam = false;
+			unsigned int lastWedge = sorted[i];
+			for (size_t j = i; j < end; j++)
+			{
+				canonical[sorted[j]] = sorted[i];
+				duplicateOf[sorted[j]] = sorted[j];
+
+				// Groups are tiny, so a linear search is fine
+				for (size_t k = i; k < j; k++)
+				{
+					if (duplicateOf[sorted[k]] == sorted[k] && sameAttributes(sorted[j], sorted[k]))
+					{
+						duplicateOf[sorted[j]] = sorted[k];
+						break;
+					}
+				}
+
+				if (duplicateOf[sorted[j]] != sorted[i])
+					seam = true;
+
+				if (duplicateOf[sorted[j]] == sorted[j] && j > i)
+				{
+					nextWedge[lastWedge] = sorted[j];
+					lastWedge = sorted[j];
+				}
+			}
+
+			locked[sorted[i]] = seam && lockSeams;
+			i = end;
+		}
+	}
+
+	for (unsigned int& index : destination)
+		index = duplicateOf[index];
+
+	// An edge with no matching edge running the other way is on
+	// a border, so lock both of its ends
+	{
+		std::vector<unsigned long long> edges;
+		edges.reserve(indexCount);
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned long long a = canonical[indices[i + k]];
+				unsigned long long b = canonical[indices[i + (k + 1) % 3]];
+				edges.push_back((a << 32) | b);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for (unsigned long long e : edges)
+		{
+			unsigned long long a = e >> 32;
+			unsigned long long b = e & 0xFFFFFFFF;
+			if (!std::binary_search(edges.begin(), edges.end(), (b << 32) | a))
+			{
+				locked[a] = true;
+				locked[b] = true;
+			}
+		}
+	}
+
+	// With seams unlocked, a triangle over the same positions as an
+	// earlier one (the same face twice, with other normals or uvs)
+	// adds nothing, so it goes first, for free
+	if (!lockSeams)
+	{
+		std::vector<std::array<unsigned int, 4>> triangles(destination.size() / 3);
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			// Rotated to start at the lowest, keeping the winding
+			unsigned int a = canonical[destination[t * 3 + 0]];
+			unsigned int b = canonical[destination[t * 3 + 1]];
+			unsigned int c = canonical[destination[t * 3 + 2]];
+			if (b < a && b < c)
+				triangles[t] = { b, c, a, (unsigned int)t };
+			else if (c < a && c < b)
+				triangles[t] = { c, a, b, (unsigned int)t };
+			else
+				triangles[t] = { a, b, c, (unsigned int)t };
+		}
+		std::sort(triangles.begin(), triangles.end());
+
+		std::vector<bool> repeated(triangles.size(), false);
+		for (size_t t = 1; t < triangles.size(); t++)
+		{
+			const std::array<unsigned int, 4>& x = triangles[t - 1];
+			const std::array<unsigned int, 4>& y = triangles[t];
+			repeated[y[3]] = x[0] == y[0] && x[1] == y[1] && x[2] == y[2];
+		}
+
+		size_t write = 0;
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			if (repeated[t])
+				continue;
+			for (int k = 0; k < 3; k++)
+				destination[write++] = destination[t * 3 + k];
+		}
+		destination.resize(write);
+	}
+
+	// Quadrics start as the planes of the triangles around each vertex
+	std::vector<Quadric> quadrics(vertexCount, Quadric());
+	XMFLOAT3 boundsMin = vertices[0].Position;
+	XMFLOAT3 boundsMax = vertices[0].Position;
+	for (size_t v = 1; v < vertexCount; v++)
+	{
+		const XMFLOAT3& p = vertices[v].Position;
+		boundsMin = XMFLOAT3((std::min)(boundsMin.x, p.x), (std::min)(boundsMin.y, p.y), (std::min)(boundsMin.z, p.z));
+		boundsMax = XMFLOAT3((std::max)(boundsMax.x, p.x), (std::max)(boundsMax.y, p.y), (std::max)(boundsMax.z, p.z));
+	}
+
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		const XMFLOAT3& p0 = vertices[indices[i + 0]].Position;
+		const XMFLOAT3& p1 = vertices[indices[i + 1]].Position;
+		const XMFLOAT3& p2 = vertices[indices[i + 2]].Position;
+
+		XMFLOAT3 n = TriangleNormal(p0, p1, p2);
+		double length = sqrt((double)Dot(n, n));
+		if (length == 0)
+			continue;
+
+		double nx = n.x / length, ny = n.y / length, nz = n.z / length;
+		double d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+		double area = length * 0.5;
+
+		for (int k = 0; k < 3; k++)
+			AddPlane(quadrics[canonical[indices[i + k]]], nx, ny, nz, d, area);
+	}
+
+	// Errors are compared as squared distances
+	float dx = boundsMax.x - boundsMin.x, dy = boundsMax.y - boundsMin.y, dz = boundsMax.z - boundsMin.z;
+	float radius = 0.5f * sqrtf(dx * dx + dy * dy + dz * dz);
+	double maxCost = (double)targetError * radius * (double)targetError * radius;
+	double reachedCost = 0;
+
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<bool> touched(vertexCount);
+	std::vector<unsigned int> remap(vertexCount);
+
+	while (destination.size() > targetIndexCount)
+	{
+		size_t triangleCount = destination.size() / 3;
+
+		// Triangles around each position group
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (unsigned int index : destination)
+			adjacencyOffsets[canonical[index] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+		adjacency.resize(destination.size());
+		{
+			std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < destination.size(); i++)
+				adjacency[fill[canonical[destination[i]]]++] = (unsigned int)(i / 3);
+		}
+
+		// Every unlocked vertex can collapse along any of its edges
+		collapses.clear();
+		for (size_t i = 0; i < destination.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int from = destination[i + k];
+				if (locked[canonical[from]])
+					continue;
+
+				for (int o = 1; o < 3; o++)
+				{
+					unsigned int to = destination[i + (k + o) % 3];
+					Quadric q = quadrics[canonical[from]];
+					AddQuadric(q, quadrics[canonical[to]]);
+
+					double cost = QuadricError(q, vertices[to].Position) / (std::max)(q.weight, 1e-20);
+					collapses.push_back({ from, to, (float)cost });
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+		// Each collapse of an interior edge removes 2 triangles
+		size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+		size_t removed = 0;
+		size_t collapseCount = 0;
+
+		std::fill(touched.begin(), touched.end(), false);
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = (unsigned int)v;
+
+		for (const Collapse& c : collapses)
+		{
+			if (c.Cost > maxCost || removed >= trianglesToRemove)
+				break;
+
+			unsigned int from = canonical[c.From];
+			unsigned int to = canonical[c.To];
+			if (touched[from] || touched[to])
+				continue;
+
+			// Reject the collapse if any remaining triangle would flip over
+			bool flips = false;
+			size_t collapsedTriangles = 0;
+			const XMFLOAT3& newPosition = vertices[c.To].Position;
+			for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && !flips; a++)
+			{
+				const unsigned int* tri = &destination[adjacency[a] * 3];
+				if (canonical[tri[0]] == to || canonical[tri[1]] == to || canonical[tri[2]] == to)
+				{
+					collapsedTriangles++;
+					continue;
+				}
+
+				XMFLOAT3 p[3];
+				for (int k = 0; k < 3; k++)
+					p[k] = vertices[tri[k]].Position;
+				XMFLOAT3 before = TriangleNormal(p[0], p[1], p[2]);
+
+				for (int k = 0; k < 3; k++)
+					if (canonical[tri[k]] == from)
+						p[k] = newPosition;
+				XMFLOAT3 after = TriangleNormal(p[0], p[1], p[2]);
+
+				// Also rejects triangles that would become slivers
+				flips = Dot(before, after) < 0.25f * sqrtf(Dot(before, before) * Dot(after, after));
+			}
+
+			if (flips)
+				continue;
+
+			// Every vertex at the position goes, seam or not (with seams
+			// locked, or no seam here, c.From is the only one)
+			for (unsigned int w = from; w != NoWedge; w = nextWedge[w])
+				remap[w] = w == c.From ? c.To : ClosestWedge(vertices, nextWedge, to, w);
+			AddQuadric(quadrics[to], quadrics[from]);
+			reachedCost = (std::max)(reachedCost, (double)c.Cost);
+			removed += collapsedTriangles;
+			collapseCount++;
+
+			// Lock the whole neighborhood for the rest of this pass
+			// so the flip test above stays valid
+			for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+			{
+				const unsigned int* tri = &destination[adjacency[a] * 3];
+				for (int k = 0; k < 3; k++)
+					touched[canonical[tri[k]]] = true;
+			}
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Apply the collapses and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < destination.size(); i += 3)
+		{
+			unsigned int a = remap[destination[i + 0]];
+			unsigned int b = remap[destination[i + 1]];
+			unsigned int c = remap[destination[i + 2]];
+			if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c])
+				continue;
+
+			destination[write++] = a;
+			destination[write++] = b;
+			destination[write++] = c;
+		}
+		destination.resize(write);
+	}
+
+	return radius > 0 ? (float)sqrt(reachedCost) / radius : 0.0f;
+}
+
+// --------------------------------------------------------
+// Builds each LOD from the full detail triangles, asking for
+// MESH_LOD_REDUCTION of the previous level each time.  A
+// level the seams hold back is tried again with them
+// unlocked, and that carries on to the coarser levels.
+// Stops early once the simplifier can't make meaningful
+// progress within MESH_LOD_MAX_ERROR (flat meshes).
+// --------------------------------------------------------
+unsigned int BuildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, MeshLod lods[MESH_MAX_LODS], bool optimizeIndices)
+{
+	lods[0].StartIndex = 0;
+	lods[0].IndexCount = (unsigned int)indices.size();
+	lods[0].Error = 0.0f;
+
+	unsigned int lodCount = 1;
+	bool lockSeams = true;
+	std::vector<unsigned int> lod;
+	while (lodCount < MESH_MAX_LODS)
+	{
+		const MeshLod& previous = lods[lodCount - 1];
+		size_t target = (size_t)(previous.IndexCount / 3 * MESH_LOD_REDUCTION) * 3;
+
+		// Not worth another level if it barely has fewer triangles
+		float error = SimplifyMesh(&vertices[0], vertices.size(), &indices[0], lods[0].IndexCount, target, MESH_LOD_MAX_ERROR, lockSeams, lod);
+		if (lockSeams && (lod.empty() || lod.size() > previous.IndexCount * 0.9f))
+		{
+			lockSeams = false;
+			error = SimplifyMesh(&vertices[0], vertices.size(), &indices[0], lods[0].IndexCount, target, MESH_LOD_MAX_ERROR, lockSeams, lod);
+		}
+
+		if (lod.empty() || lod.size() > previous.IndexCount * 0.9f)
+			break;
+
+		if (optimizeIndices)
+			OptimizeVertexCache(&lod[0], lod.size(), vertices.size());
+
+		lods[lodCount].StartIndex = (unsigned int)indices.size();
+		lods[lodCount].IndexCount = (unsigned int)lod.size();
+		lods[lodCount].Error = error;
+		indices.insert(indices.end(), lod.begin(), lod.end());
+		lodCount++;
+	}
+
+	return lodCount;
+}
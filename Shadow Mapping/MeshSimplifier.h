@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// Most levels of detail a single mesh can have (including the original)
+#define MESH_MAX_LODS 4
+// Each LOD aims for this fraction of the previous level's triangles
+#define MESH_LOD_REDUCTION 0.5f
+// Largest error a LOD may have, relative to the mesh's bounding radius
+#define MESH_LOD_MAX_ERROR 0.05f
+
+// --------------------------------------------------------
+// One level of detail: a range of the mesh's index buffer.
+// All levels index into the same vertex buffer.
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int StartIndex;
+	unsigned int IndexCount;
+	float Error;	// Relative to the mesh's bounding radius
+};
+
+// Simplifies a triangle list by collapsing edges (quadric error metric)
+// until it has at most targetIndexCount indices, or no collapse would
+// add less than targetError (relative to the bounding radius).
+// The result indexes the same vertices.  Returns the error reached.
+// With lockSeams false, positions where normals or uvs split can
+// collapse too, each of their vertices moving onto the most alike one
+// at the other end - rougher on textures and hard edges, but the only
+// way to reduce meshes that are seams everywhere (faceted ones).
+float SimplifyMesh(const Vertex* vertices, size_t vertexCount,
+	const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, float targetError, bool lockSeams,
+	std::vector<unsigned int>& destination);
+
+// Appends coarser levels of detail after the existing indices (LOD 0)
+// and fills in the range of each level, unlocking seams for the levels
+// the seams would otherwise stop.  Returns the number of levels.
+unsigned int BuildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, MeshLod lods[MESH_MAX_LODS], bool optimizeIndices);
@@ -0,0 +1,206 @@
+#include "MeshTangents.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+// Meshes with at least this many triangles get their tangents on multiple threads
+#define TANGENT_PARALLEL_MIN_TRIANGLES 65536
+// Smallest number of triangles handed to a single thread
+#define TANGENT_MIN_CHUNK_TRIANGLES 16384
+
+namespace
+{
+	// --------------------------------------------------------
+	// Adds the (unnormalized) tangent of every triangle in
+	// [firstTri, endTri) to its 3 vertices in the given buffer.
+	//
+	// Triangles are handled 4 at a time: the positions and uvs
+	// of 4 triangles are transposed into x/y/z lanes so the math
+	// for all 4 happens in the same SIMD registers.  The adds to
+	// the vertices can't be vectorized (triangles share vertices),
+	// so those are done one lane at a time.
+	// --------------------------------------------------------
+	void AccumulateTangents(const Vertex* verts, const unsigned int* indices, size_t firstTri, size_t endTri, XMFLOAT3* tangents)
+	{
+		size_t tri = firstTri;
+		for (; tri + 4 <= endTri; tri += 4)
+		{
+			const unsigned int* idx = &indices[tri * 3];
+
+			// Gather the 4 triangles' corners as rows, then transpose
+			// so each register holds one component from all 4 triangles
+			XMMATRIX p1 = XMMatrixTranspose(XMMATRIX(
+				XMLoadFloat3(&verts[idx[0]].Position), XMLoadFloat3(&verts[idx[3]].Position),
+				XMLoadFloat3(&verts[idx[6]].Position), XMLoadFloat3(&verts[idx[9]].Position)));
+			XMMATRIX p2 = XMMatrixTranspose(XMMATRIX(
+				XMLoadFloat3(&verts[idx[1]].Position), XMLoadFloat3(&verts[idx[4]].Position),
+				XMLoadFloat3(&verts[idx[7]].Position), XMLoadFloat3(&verts[idx[10]].Position)));
+			XMMATRIX p3 = XMMatrixTranspose(XMMATRIX(
+				XMLoadFloat3(&verts[idx[2]].Position), XMLoadFloat3(&verts[idx[5]].Position),
+				XMLoadFloat3(&verts[idx[8]].Position), XMLoadFloat3(&verts[idx[11]].Position)));
+			XMMATRIX uv1 = XMMatrixTranspose(XMMATRIX(
+				XMLoadFloat2(&verts[idx[0]].UV), XMLoadFloat2(&verts[idx[3]].UV),
+				XMLoadFloat2(&verts[idx[6]].UV), XMLoadFloat2(&verts[idx[9]].UV)));
+			XMMATRIX uv2 = XMMatrixTranspose(XMMATRIX(
+				XMLoadFloat2(&verts[idx[1]].UV), XMLoadFloat2(&verts[idx[4]].UV),
+				XMLoadFloat2(&verts[idx[7]].UV), XMLoadFloat2(&verts[idx[10]].UV)));
+			XMMATRIX uv3 = XMMatrixTranspose(XMMATRIX(
+				XMLoadFloat2(&verts[idx[2]].UV), XMLoadFloat2(&verts[idx[5]].UV),
+				XMLoadFloat2(&verts[idx[8]].UV), XMLoadFloat2(&verts[idx[11]].UV)));
+
+			// Calculate vectors relative to triangle positions
+			XMVECTOR x1 = XMVectorSubtract(p2.r[0], p1.r[0]);
+			XMVECTOR y1 = XMVectorSubtract(p2.r[1], p1.r[1]);
+			XMVECTOR z1 = XMVectorSubtract(p2.r[2], p1.r[2]);
+
+			XMVECTOR x2 = XMVectorSubtract(p3.r[0], p1.r[0]);
+			XMVECTOR y2 = XMVectorSubtract(p3.r[1], p1.r[1]);
+			XMVECTOR z2 = XMVectorSubtract(p3.r[2], p1.r[2]);
+
+			// Do the same for vectors relative to triangle uv's
+			XMVECTOR s1 = XMVectorSubtract(uv2.r[0], uv1.r[0]);
+			XMVECTOR t1 = XMVectorSubtract(uv2.r[1], uv1.r[1]);
+
+			XMVECTOR s2 = XMVectorSubtract(uv3.r[0], uv1.r[0]);
+			XMVECTOR t2 = XMVectorSubtract(uv3.r[1], uv1.r[1]);
+
+			// Create vectors for tangent calculation
+			XMVECTOR r = XMVectorReciprocal(XMVectorSubtract(XMVectorMultiply(s1, t2), XMVectorMultiply(s2, t1)));
+
+			XMFLOAT4A tx, ty, tz;
+			XMStoreFloat4A(&tx, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, x1), XMVectorMultiply(t1, x2)), r));
+			XMStoreFloat4A(&ty, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, y1), XMVectorMultiply(t1, y2)), r));
+			XMStoreFloat4A(&tz, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, z1), XMVectorMultiply(t1, z2)), r));
+
+			// Adjust tangents of each vert of each triangle
+			const float lanesX[4] = { tx.x, tx.y, tx.z, tx.w };
+			const float lanesY[4] = { ty.x, ty.y, ty.z, ty.w };
+			const float lanesZ[4] = { tz.x, tz.y, tz.z, tz.w };
+			for (int lane = 0; lane < 4; lane++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					XMFLOAT3& tangent = tangents[idx[lane * 3 + k]];
+					tangent.x += lanesX[lane];
+					tangent.y += lanesY[lane];
+					tangent.z += lanesZ[lane];
+				}
+			}
+		}
+
+		// Leftover triangles one at a time
+		for (; tri < endTri; tri++)
+		{
+			const Vertex* v1 = &verts[indices[tri * 3 + 0]];
+			const Vertex* v2 = &verts[indices[tri * 3 + 1]];
+			const Vertex* v3 = &verts[indices[tri * 3 + 2]];
+
+			float x1 = v2->Position.x - v1->Position.x;
+			float y1 = v2->Position.y - v1->Position.y;
+			float z1 = v2->Position.z - v1->Position.z;
+
+			float x2 = v3->Position.x - v1->Position.x;
+			float y2 = v3->Position.y - v1->Position.y;
+			float z2 = v3->Position.z - v1->Position.z;
+
+			float s1 = v2->UV.x - v1->UV.x;
+			float t1 = v2->UV.y - v1->UV.y;
+
+			float s2 = v3->UV.x - v1->UV.x;
+			float t2 = v3->UV.y - v1->UV.y;
+
+			float r = 1.0f / (s1 * t2 - s2 * t1);
+
+			float tx = (t2 * x1 - t1 * x2) * r;
+			float ty = (t2 * y1 - t1 * y2) * r;
+			float tz = (t2 * z1 - t1 * z2) * r;
+
+			for (int k = 0; k < 3; k++)
+			{
+				XMFLOAT3& tangent = tangents[indices[tri * 3 + k]];
+				tangent.x += tx;
+				tangent.y += ty;
+				tangent.z += tz;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Author: Chris Cascioli
+// Purpose: Calculates the tangents of the vertices in a mesh
+// 
+// - You are allowed to directly copy/paste this into your code base
+//   for assignments, given that you clearly cite that this is not
+//   code of your own design.
+//
+// - Code originally adapted from: http://www.terathon.com/code/tangent.html
+//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
+//
+// - Note: For this code to work, your Vertex format must
+//         contain an XMFLOAT3 called Tangent
+//
+// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+//
+// - Modified to compute 4 triangles at a time (see AccumulateTangents)
+//   and to split large meshes across threads (threadCount 0 picks
+//   automatically, like ParseObj).  Each thread sums into
+//   its own buffer, and the buffers are added together in a fixed
+//   order afterwards, so results only differ from the original
+//   one-triangle-at-a-time loop by floating point summation order.
+// --------------------------------------------------------
+void CalculateTangents(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, unsigned int threadCount)
+{
+	if (numVerts <= 0)
+		return;
+
+	size_t triangleCount = numIndices / 3;
+
+	// Only split meshes that are big enough to be worth the threads
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+		if (triangleCount >= TANGENT_PARALLEL_MIN_TRIANGLES)
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+	}
+	threadCount = (unsigned int)(std::min<size_t>)(threadCount, triangleCount / TANGENT_MIN_CHUNK_TRIANGLES + 1);
+
+	// One zeroed tangent buffer per thread, so there are no write conflicts
+	std::vector<std::vector<XMFLOAT3>> threadTangents(threadCount, std::vector<XMFLOAT3>(numVerts, XMFLOAT3(0, 0, 0)));
+
+	RunOnThreads(threadCount, [&](size_t t)
+		{
+			size_t firstTri = triangleCount * t / threadCount;
+			size_t endTri = triangleCount * (t + 1) / threadCount;
+			AccumulateTangents(verts, indices, firstTri, endTri, &threadTangents[t][0]);
+		});
+
+	// Add the buffers together (always in thread order) and ensure all
+	// of the tangents are orthogonal to the normals.  Every vertex is
+	// independent here, so this is split across the threads too.
+	RunOnThreads(threadCount, [&](size_t t)
+		{
+			size_t firstVert = (size_t)numVerts * t / threadCount;
+			size_t endVert = (size_t)numVerts * (t + 1) / threadCount;
+
+			for (size_t i = firstVert; i < endVert; i++)
+			{
+				XMVECTOR tangent = XMLoadFloat3(&threadTangents[0][i]);
+				for (unsigned int b = 1; b < threadCount; b++)
+					tangent = XMVectorAdd(tangent, XMLoadFloat3(&threadTangents[b][i]));
+
+				// Use Gram-Schmidt orthonormalize to ensure
+				// the normal and tangent are exactly 90 degrees apart
+				XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+				tangent = XMVector3Normalize(
+					tangent - normal * XMVector3Dot(normal, tangent));
+
+				// Store the tangent
+				XMStoreFloat3(&verts[i].Tangent, tangent);
+			}
+		});
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "Vertex.h"
+
+// Calculates a tangent for every vertex from the triangles' positions and
+// uvs, orthogonal to the vertex normal (threadCount 0 = automatic).  Doesn't
+// need a device, so tools can run it too.
+void CalculateTangents(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, unsigned int threadCount = 0);
@@ -0,0 +1,476 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+	// Skips spaces, tabs and stray carriage returns
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+			p++;
+		return p;
+	}
+
+	// Returns the first character of the next line
+	inline const char* NextLine(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline + 1 : end;
+	}
+
+	inline const char* ParseFloat(const char* p, const char* end, float& value)
+	{
+		p = SkipSpaces(p, end);
+		if (p < end && *p == '+')
+			p++;
+
+		std::from_chars_result result = std::from_chars(p, end, value);
+		if (result.ec != std::errc())
+			value = 0.0f;
+		return result.ptr;
+	}
+
+	inline const char* ParseInt(const char* p, const char* end, int& value)
+	{
+		if (p < end && *p == '+')
+			p++;
+
+		std::from_chars_result result = std::from_chars(p, end, value);
+		if (result.ec != std::errc())
+			value = 0;
+		return result.ptr;
+	}
+
+	// OBJ indices are 1-based, or relative to the end of the
+	// list when negative.  Zero (or nothing) means "not given".
+	inline int ResolveIndex(int index, size_t count)
+	{
+		if (index > 0)
+			return index - 1;
+		if (index < 0)
+			return (int)count + index;
+		return -1;
+	}
+
+	// Bits for RelativeCorner::Mask
+	const unsigned char RelativePosition = 1;
+	const unsigned char RelativeUV = 2;
+	const unsigned char RelativeNormal = 4;
+
+	// A corner that used negative (relative) indices.  When a chunk is
+	// parsed on its own these were resolved against the chunk's local
+	// attribute counts, and need the chunk's base offsets added.
+	struct RelativeCorner
+	{
+		size_t Corner;
+		unsigned char Mask;
+	};
+
+	// One face corner along with which of its indices were relative
+	struct ParsedCorner
+	{
+		ObjIndex Index;
+		unsigned char RelativeMask;
+	};
+
+	// Reads one "v", "v/t", "v//n" or "v/t/n" face corner
+	const char* ParseCorner(const char* p, const char* end, const ObjData& obj, ParsedCorner& corner)
+	{
+		int position = 0;
+		int uv = 0;
+		int normal = 0;
+
+		p = ParseInt(p, end, position);
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (p < end && *p != '/')
+				p = ParseInt(p, end, uv);
+
+			if (p < end && *p == '/')
+			{
+				p++;
+				p = ParseInt(p, end, normal);
+			}
+		}
+
+		corner.Index.Position = ResolveIndex(position, obj.Positions.size());
+		corner.Index.UV = ResolveIndex(uv, obj.UVs.size());
+		corner.Index.Normal = ResolveIndex(normal, obj.Normals.size());
+		corner.RelativeMask =
+			(position < 0 ? RelativePosition : 0) |
+			(uv < 0 ? RelativeUV : 0) |
+			(normal < 0 ? RelativeNormal : 0);
+		return p;
+	}
+
+	inline void PushCorner(const ParsedCorner& corner, ObjData& obj, std::vector<RelativeCorner>* relative)
+	{
+		if (relative && corner.RelativeMask)
+			relative->push_back({ obj.Corners.size(), corner.RelativeMask });
+
+		obj.Corners.push_back(corner.Index);
+	}
+
+	// Reads a whole "f" line and triangulates it as a fan, flipping
+	// the winding order for the left-handed space.  Works for any
+	// number of corners without buffering the polygon.
+	void ParseFace(const char* p, const char* lineEnd, ObjData& obj, std::vector<RelativeCorner>* relative)
+	{
+		ParsedCorner first = {};
+		ParsedCorner previous = {};
+		int cornerCount = 0;
+
+		while (true)
+		{
+			p = SkipSpaces(p, lineEnd);
+			if (p >= lineEnd || *p == '#' || *p == '\n')
+				break;
+
+			ParsedCorner corner;
+			const char* next = ParseCorner(p, lineEnd, obj, corner);
+			if (next == p)
+				break; // Not a number, stop reading this line
+
+			p = next;
+
+			if (cornerCount == 0)
+				first = corner;
+			else if (cornerCount >= 2)
+			{
+				PushCorner(first, obj, relative);
+				PushCorner(corner, obj, relative);
+				PushCorner(previous, obj, relative);
+			}
+
+			previous = corner;
+			cornerCount++;
+		}
+	}
+
+	// Mixes the three indices of a corner into one hash value
+	inline size_t HashCorner(const ObjIndex& c)
+	{
+		size_t h = (unsigned int)c.Position * 0x9E3779B1u;
+		h ^= (unsigned int)c.UV * 0x85EBCA77u + (h << 6) + (h >> 2);
+		h ^= (unsigned int)c.Normal * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+		return h;
+	}
+
+	// Looks up the attributes of a single corner
+	Vertex MakeVertex(const ObjData& obj, const ObjIndex& c)
+	{
+		const XMFLOAT3 defaultPosition(0.0f, 0.0f, 0.0f);
+		const XMFLOAT3 defaultNormal(0.0f, 1.0f, 0.0f);
+		const XMFLOAT2 defaultUV(0.0f, 1.0f);
+
+		Vertex v = {};
+		v.Position = (c.Position >= 0 && (size_t)c.Position < obj.Positions.size()) ? obj.Positions[c.Position] : defaultPosition;
+		v.Normal = (c.Normal >= 0 && (size_t)c.Normal < obj.Normals.size()) ? obj.Normals[c.Normal] : defaultNormal;
+		v.UV = (c.UV >= 0 && (size_t)c.UV < obj.UVs.size()) ? obj.UVs[c.UV] : defaultUV;
+		return v;
+	}
+
+	// Quick pass that only looks at the start of every line,
+	// so the attribute vectors can be sized up front
+	void CountLines(const char* p, const char* end, size_t& positions, size_t& normals, size_t& uvs, size_t& faces)
+	{
+		while (p < end)
+		{
+			if (p + 1 < end && p[0] == 'v')
+			{
+				if (p[1] == ' ' || p[1] == '\t') positions++;
+				else if (p[1] == 'n') normals++;
+				else if (p[1] == 't') uvs++;
+			}
+			else if (p[0] == 'f')
+			{
+				faces++;
+			}
+
+			p = NextLine(p, end);
+		}
+	}
+}
+
+namespace
+{
+	// --------------------------------------------------------
+	// Parses the complete lines in [begin, end) and appends the
+	// results to obj.  Negative indices are resolved against what
+	// obj already holds, and recorded in "relative" if given.
+	// --------------------------------------------------------
+	void ParseRange(const char* begin, const char* end, ObjData& obj, std::vector<RelativeCorner>* relative)
+	{
+		//size everything up front (faces are assumed to be triangles)
+		{
+			size_t positions = 0, normals = 0, uvs = 0, faces = 0;
+			CountLines(begin, end, positions, normals, uvs, faces);
+
+			obj.Positions.reserve(obj.Positions.size() + positions);
+			obj.Normals.reserve(obj.Normals.size() + normals);
+			obj.UVs.reserve(obj.UVs.size() + uvs);
+			obj.Corners.reserve(obj.Corners.size() + faces * 3);
+		}
+
+		const char* p = begin;
+		while (p < end)
+		{
+			const char* lineStart = SkipSpaces(p, end);
+			const char* lineEnd = NextLine(lineStart, end);
+			p = lineEnd;
+
+			if (lineEnd - lineStart < 2)
+				continue;
+
+			// The model is most likely in a right-handed space, so while
+			// reading we convert to DirectX's left-handed space by inverting
+			// Z on positions and normals, and flip the UVs since DirectX
+			// defines (0,0) as the top left of the texture
+			if (lineStart[0] == 'v' && lineStart[1] == 'n')
+			{
+				XMFLOAT3 norm;
+				const char* c = ParseFloat(lineStart + 2, lineEnd, norm.x);
+				c = ParseFloat(c, lineEnd, norm.y);
+				ParseFloat(c, lineEnd, norm.z);
+
+				norm.z *= -1.0f;
+				obj.Normals.push_back(norm);
+			}
+			else if (lineStart[0] == 'v' && lineStart[1] == 't')
+			{
+				XMFLOAT2 uv;
+				const char* c = ParseFloat(lineStart + 2, lineEnd, uv.x);
+				ParseFloat(c, lineEnd, uv.y);
+
+				uv.y = 1.0f - uv.y;
+				obj.UVs.push_back(uv);
+			}
+			else if (lineStart[0] == 'v' && (lineStart[1] == ' ' || lineStart[1] == '\t'))
+			{
+				XMFLOAT3 pos;
+				const char* c = ParseFloat(lineStart + 1, lineEnd, pos.x);
+				c = ParseFloat(c, lineEnd, pos.y);
+				ParseFloat(c, lineEnd, pos.z);
+
+				pos.z *= -1.0f;
+				obj.Positions.push_back(pos);
+			}
+			else if (lineStart[0] == 'f' && (lineStart[1] == ' ' || lineStart[1] == '\t'))
+			{
+				ParseFace(lineStart + 1, lineEnd, obj, relative);
+			}
+		}
+	}
+
+	// Everything a worker thread produces for its slice of the file
+	struct ObjChunk
+	{
+		const char* Begin;
+		const char* End;
+		ObjData Data;
+		std::vector<RelativeCorner> Relative;
+
+		// Where this chunk's data starts in the merged arrays
+		size_t PositionBase;
+		size_t NormalBase;
+		size_t UVBase;
+		size_t CornerBase;
+	};
+
+	// Copies one chunk into its slot of the merged arrays,
+	// fixing up any indices that were relative to the chunk
+	void MergeChunk(const ObjChunk& chunk, ObjData& obj)
+	{
+		std::copy(chunk.Data.Positions.begin(), chunk.Data.Positions.end(), obj.Positions.begin() + chunk.PositionBase);
+		std::copy(chunk.Data.Normals.begin(), chunk.Data.Normals.end(), obj.Normals.begin() + chunk.NormalBase);
+		std::copy(chunk.Data.UVs.begin(), chunk.Data.UVs.end(), obj.UVs.begin() + chunk.UVBase);
+		std::copy(chunk.Data.Corners.begin(), chunk.Data.Corners.end(), obj.Corners.begin() + chunk.CornerBase);
+
+		for (const RelativeCorner& r : chunk.Relative)
+		{
+			ObjIndex& c = obj.Corners[chunk.CornerBase + r.Corner];
+			if (r.Mask & RelativePosition) c.Position += (int)chunk.PositionBase;
+			if (r.Mask & RelativeUV) c.UV += (int)chunk.UVBase;
+			if (r.Mask & RelativeNormal) c.Normal += (int)chunk.NormalBase;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Parses OBJ text that's already in memory.
+//
+// - Tokenizes in a single pass with no per-line allocations
+// - Supports positions, uvs and normals, any of which may be
+//   omitted from the face definitions
+// - Supports faces with any number of corners (fan triangulated)
+//   and negative (relative) indices
+//
+// threadCount - 0 picks automatically: small files are parsed on
+//               this thread, large ones are split across all cores
+//
+// Large files are split at line boundaries and each chunk is parsed
+// on its own thread.  The chunks are then stitched together in file
+// order using a prefix sum of their attribute counts, so the result
+// is identical to parsing the file serially.
+// --------------------------------------------------------
+bool ParseObj(const char* data, size_t size, ObjData& obj, unsigned int threadCount)
+{
+	obj.Positions.clear();
+	obj.Normals.clear();
+	obj.UVs.clear();
+	obj.Corners.clear();
+
+	if (!data || size == 0)
+		return false;
+
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+		if (size >= OBJ_PARALLEL_MIN_BYTES)
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+	}
+
+	// Don't bother splitting into chunks that are tiny
+	threadCount = (unsigned int)(std::min<size_t>)(threadCount, size / OBJ_MIN_CHUNK_BYTES + 1);
+
+	if (threadCount == 1)
+	{
+		ParseRange(data, data + size, obj, 0);
+		return true;
+	}
+
+	// Split into roughly even chunks, each ending on a newline
+	const char* end = data + size;
+	std::vector<ObjChunk> chunks(threadCount);
+	{
+		const char* chunkStart = data;
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			const char* chunkEnd = end;
+			if (i + 1 < threadCount)
+			{
+				const char* target = data + (size / threadCount) * (i + 1);
+				chunkEnd = target > chunkStart ? NextLine(target, end) : chunkStart;
+			}
+
+			chunks[i].Begin = chunkStart;
+			chunks[i].End = chunkEnd;
+			chunkStart = chunkEnd;
+		}
+	}
+
+	// Parse every chunk independently
+	RunOnThreads(chunks.size(), [&chunks](size_t i)
+		{
+			ParseRange(chunks[i].Begin, chunks[i].End, chunks[i].Data, &chunks[i].Relative);
+		});
+
+	// Prefix sum of the counts gives each chunk its place in the output
+	size_t positions = 0, normals = 0, uvs = 0, corners = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.PositionBase = positions;
+		chunk.NormalBase = normals;
+		chunk.UVBase = uvs;
+		chunk.CornerBase = corners;
+
+		positions += chunk.Data.Positions.size();
+		normals += chunk.Data.Normals.size();
+		uvs += chunk.Data.UVs.size();
+		corners += chunk.Data.Corners.size();
+	}
+
+	obj.Positions.resize(positions);
+	obj.Normals.resize(normals);
+	obj.UVs.resize(uvs);
+	obj.Corners.resize(corners);
+
+	// Chunks write to disjoint ranges, so merging is parallel too
+	RunOnThreads(chunks.size(), [&chunks, &obj](size_t i)
+		{
+			MergeChunk(chunks[i], obj);
+		});
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Memory-maps an OBJ file and parses it in place
+// --------------------------------------------------------
+bool LoadObjFile(const wchar_t* filename, ObjData& obj)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+		return false;
+
+	return ParseObj(file.GetData(), file.GetSize(), obj);
+}
+
+// --------------------------------------------------------
+// Welds the face corners into unique vertices and builds a
+// real index buffer referencing them.
+//
+// Two corners are the same vertex when they use the same
+// position/uv/normal triple, so the OBJ index triple itself is
+// the hash key - no float comparisons are needed.  Lookups use
+// an open-addressing table sized to twice the corner count.
+//
+// Corners that omit an attribute (or reference one that doesn't
+// exist) fall back to a default value instead of failing the load.
+// --------------------------------------------------------
+void BuildObjVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	const unsigned int emptySlot = 0xFFFFFFFF;
+
+	size_t cornerCount = obj.Corners.size();
+	verts.clear();
+	verts.reserve(cornerCount);
+	indices.resize(cornerCount);
+
+	size_t capacity = 16;
+	while (capacity < cornerCount * 2)
+		capacity <<= 1;
+	size_t mask = capacity - 1;
+
+	std::vector<unsigned int> table(capacity, emptySlot);	// Vertex index per slot
+	std::vector<ObjIndex> uniqueCorners;					// Key of each unique vertex
+	uniqueCorners.reserve(cornerCount);
+
+	for (size_t i = 0; i < cornerCount; i++)
+	{
+		const ObjIndex& c = obj.Corners[i];
+		size_t slot = HashCorner(c) & mask;
+
+		while (true)
+		{
+			unsigned int v = table[slot];
+			if (v == emptySlot)
+			{
+				// First time we've seen this triple
+				v = (unsigned int)verts.size();
+				table[slot] = v;
+				uniqueCorners.push_back(c);
+				verts.push_back(MakeVertex(obj, c));
+				indices[i] = v;
+				break;
+			}
+
+			const ObjIndex& existing = uniqueCorners[v];
+			if (existing.Position == c.Position && existing.UV == c.UV && existing.Normal == c.Normal)
+			{
+				indices[i] = v;
+				break;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+	}
+}
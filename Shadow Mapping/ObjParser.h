@@ -0,0 +1,47 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A single face corner as it appears in an OBJ "f" line.
+// Indices are 0-based, -1 means the attribute was omitted.
+// --------------------------------------------------------
+struct ObjIndex
+{
+	int Position;
+	int UV;
+	int Normal;
+};
+
+// --------------------------------------------------------
+// Raw attribute streams and triangulated face corners
+// read from an OBJ file.
+//
+// - Positions/normals are already converted to a left-handed
+//   space (Z flipped) and UVs are already flipped vertically
+// - Corners holds 3 entries per triangle, with the winding
+//   order already flipped to match the left-handed space
+// --------------------------------------------------------
+struct ObjData
+{
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT3> Normals;
+	std::vector<DirectX::XMFLOAT2> UVs;
+	std::vector<ObjIndex> Corners;
+};
+
+// Files at least this big are parsed on multiple threads by default
+#define OBJ_PARALLEL_MIN_BYTES (8 * 1024 * 1024)
+// Smallest slice of a file handed to a single thread
+#define OBJ_MIN_CHUNK_BYTES (1024 * 1024)
+
+// Parses OBJ text held in memory (threadCount 0 = automatic)
+bool ParseObj(const char* data, size_t size, ObjData& obj, unsigned int threadCount = 0);
+
+// Memory-maps the given file and parses it
+bool LoadObjFile(const wchar_t* filename, ObjData& obj);
+
+// Welds identical face corners into an indexed vertex list
+void BuildObjVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
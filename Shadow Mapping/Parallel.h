@@ -0,0 +1,28 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Runs func(i) for i in [0, count) with one thread per index.
+// The calling thread runs func(0) itself, and this doesn't
+// return until every call has finished.  A count of 0 runs
+// nothing.
+// --------------------------------------------------------
+template<typename Func>
+void RunOnThreads(size_t count, Func func)
+{
+	if (count == 0)
+		return;
+
+	std::vector<std::thread> workers;
+	workers.reserve(count - 1);
+	for (size_t i = 1; i < count; i++)
+		workers.emplace_back(func, i);
+
+	// The calling thread does its share too
+	func(0);
+
+	for (std::thread& t : workers)
+		t.join();
+}
@@ -7,23 +7,33 @@ Texture2D NormalMap : register(t1); //Normal texture
 Texture2D RoughnessMap : register(t2);
 Texture2D MetalnessMap : register(t3);
 
-//shadow map textures (fixed 3, ideally would prefer some sort of array for dynamic number of lights and shadows)
-Texture2D ShadowMap1 : register(t4);
-Texture2D ShadowMap2 : register(t5);
-Texture2D ShadowMap3 : register(t6);
+//shadow maps, a run of slices per shadow casting light (see Light.ShadowMapIndex)
+Texture2DArray ShadowMaps : register(t4);
 
 //samplers
 SamplerState BasicSampler : register(s0); // "s" registers for samplers 
 SamplerComparisonState ShadowSampler : register(s1);
 
-//constant buffer definition
-cbuffer ExternalData : register(b0)
+//constant buffers, split by how often they change
+cbuffer PerFrame : register(b0)
 {
-    float3 colorTint;
     float3 cameraPosition;
     float3 ambientTerm;
     Light lights[MAX_LIGHTS];
     int lightCount;
+    
+    //one per shadow map in use, light view and projection premultiplied
+    matrix shadowViewProjection[MAX_SHADOW_MAPS];
+    
+    //the camera's view depth is dot(float4(worldPosition, 1), viewDepthPlane),
+    //and each cascade (x first, up to 4) ends at that depth in cascadeEnds
+    float4 viewDepthPlane;
+    float4 cascadeEnds;
+}
+
+cbuffer PerMaterial : register(b1)
+{
+    float3 colorTint;
 }
 
 float4 main(VertexToPixel input) : SV_TARGET
@@ -62,38 +72,35 @@ float4 main(VertexToPixel input) : SV_TARGET
     
     float3 finalColor = float3(0.0f, 0.0f, 0.0f);
     
+    //the cascade is picked by view depth against the splits - the same
+    //slices the shadow casters were culled for, so every pixel's casters
+    //are in its cascade (the cascade's square reaches well past its slice)
+    float viewDepth = dot(float4(input.worldPosition, 1.0f), viewDepthPlane);
+    int cascade = (int)dot(viewDepth > cascadeEnds, 1.0f);
+    
     //directional and point terms
     for (int i = 0; i < lightCount; i++)
     {
         float shadowAmount = 1.0f;
         
-        //first 3 lights are directional lights with shadows
-        if(i<3)
+        //lights with shadows have one slice per cascade, nearest the
+        //camera first (past the last one is unshadowed)
+        if (cascade < lights[i].ShadowMapCount)
         {
             // SHADOW MAPPING --------------------------------
-	        // Note: This is only for a SINGLE light!  If you want multiple lights to cast shadows,
-	        // you need to do all of this multiple times IN THIS SHADER.
-            float2 shadowUV = input.posForShadow[i].xy / input.posForShadow[i].w * 0.5f + 0.5f;
+            int shadowMap = lights[i].ShadowMapIndex + cascade;
+            float4 posForShadow = mul(shadowViewProjection[shadowMap], float4(input.worldPosition, 1.0f));
+            float2 shadowUV = posForShadow.xy / posForShadow.w * 0.5f + 0.5f;
             shadowUV.y = 1.0f - shadowUV.y;
 
              // Calculate this pixel's depth from the light
-            float depthFromLight = input.posForShadow[i].z / input.posForShadow[i].w;
+            float depthFromLight = posForShadow.z / posForShadow.w;
     
              // Sample the shadow map using a comparison sampler, which
 	         // will compare the depth from the light and the value in the shadow map
 	         // Note: This is applied below, after we calc our DIRECTIONAL LIGHT
-            switch (i)
-            {
-                case 0:
-                    shadowAmount = ShadowMap1.SampleCmpLevelZero(ShadowSampler, shadowUV, depthFromLight);
-                    break;
-                case 1:
-                    shadowAmount = ShadowMap2.SampleCmpLevelZero(ShadowSampler, shadowUV, depthFromLight);
-                    break;
-                case 2:
-                    shadowAmount = ShadowMap3.SampleCmpLevelZero(ShadowSampler, shadowUV, depthFromLight);
-                    break;
-            } 
+            if (all(shadowUV >= 0.0f) && all(shadowUV <= 1.0f) && depthFromLight <= 1.0f)
+                shadowAmount = ShadowMaps.SampleCmpLevelZero(ShadowSampler, float3(shadowUV, shadowMap), depthFromLight);
         }
         
         if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
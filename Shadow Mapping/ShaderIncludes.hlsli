@@ -9,6 +9,32 @@ struct VertexShaderInput
 	float2 uv               : TEXCOORD;		//UV
 };
 
+// Per instance data for the instanced vertex shaders, from input slot 1.
+// The matrices come in as the rows stored on the CPU (see InstanceData)
+struct InstanceInput
+{
+    float4 world0               : WORLD_PER_INSTANCE0;
+    float4 world1               : WORLD_PER_INSTANCE1;
+    float4 world2               : WORLD_PER_INSTANCE2;
+    float4 world3               : WORLD_PER_INSTANCE3;
+    float4 worldInvTranspose0   : WORLDINVTRANSPOSE_PER_INSTANCE0;
+    float4 worldInvTranspose1   : WORLDINVTRANSPOSE_PER_INSTANCE1;
+    float4 worldInvTranspose2   : WORLDINVTRANSPOSE_PER_INSTANCE2;
+    float4 worldInvTranspose3   : WORLDINVTRANSPOSE_PER_INSTANCE3;
+};
+
+// Just the world matrix, for passes that don't need normals
+struct InstanceInput_Shadow
+{
+    float4 world0               : WORLD_PER_INSTANCE0;
+    float4 world1               : WORLD_PER_INSTANCE1;
+    float4 world2               : WORLD_PER_INSTANCE2;
+    float4 world3               : WORLD_PER_INSTANCE3;
+};
+
+
+// Slices in the shadow map array (must match Lights.h)
+#define MAX_SHADOW_MAPS 12
 
 struct VertexToPixel
 {
@@ -16,8 +42,7 @@ struct VertexToPixel
 	float2 uv : TEXCOORD; // UV
     float3 normal : NORMAL;
     float3 tangent : TANGENT;
-    float3 worldPosition : POSITION;
-    float4 posForShadow[3] : SHADOWPOS;
+    float3 worldPosition : POSITION; // The pixel shader finds its place in the shadow maps from this
 };
 
 struct VertexToPixel_Sky
@@ -48,7 +73,8 @@ struct Light
     float3 Color; 
     float SpotFalloff;
     int CastsShadows;
-    float2 Padding; 
+    int ShadowMapIndex; // -1 for none
+    int ShadowMapCount; // one per cascade
 };
 
 #endif
\ No newline at end of file
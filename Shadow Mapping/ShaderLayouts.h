@@ -0,0 +1,148 @@
+#pragma once
+
+// --------------------------------------------------------
+// Generated by Tools/ShaderLayoutGen from:
+//   VertexShader.hlsl
+//   PixelShader.hlsl
+//   VertexShader_Shadow.hlsl
+//   VertexShader_Sky.hlsl
+//   VertexShader_Instanced.hlsl
+//   VertexShader_Shadow_Instanced.hlsl
+// Don't edit - the game project regenerates it from the
+// shaders before every build.
+//
+// One struct per cbuffer, laid out exactly as HLSL packs
+// it, for ISimpleShader::SetBufferData().
+// --------------------------------------------------------
+
+#include <DirectXMath.h>
+#include <cstddef>
+
+namespace ShaderLayouts
+{
+
+// An array element padded out to a whole 16 byte register
+template<typename T, unsigned int PadFloats>
+struct SimplePaddedElement
+{
+	T Value;
+	float _pad[PadFloats];
+};
+
+struct Light
+{
+	int Type;
+	DirectX::XMFLOAT3 Direction;
+	float Range;
+	DirectX::XMFLOAT3 Position;
+	float Intensity;
+	DirectX::XMFLOAT3 Color;
+	float SpotFalloff;
+	int CastsShadows;
+	int ShadowMapIndex;
+	int ShadowMapCount;
+};
+static_assert(offsetof(Light, Type) == 0, "Light::Type isn't where HLSL puts it");
+static_assert(offsetof(Light, Direction) == 4, "Light::Direction isn't where HLSL puts it");
+static_assert(offsetof(Light, Range) == 16, "Light::Range isn't where HLSL puts it");
+static_assert(offsetof(Light, Position) == 20, "Light::Position isn't where HLSL puts it");
+static_assert(offsetof(Light, Intensity) == 32, "Light::Intensity isn't where HLSL puts it");
+static_assert(offsetof(Light, Color) == 36, "Light::Color isn't where HLSL puts it");
+static_assert(offsetof(Light, SpotFalloff) == 48, "Light::SpotFalloff isn't where HLSL puts it");
+static_assert(offsetof(Light, CastsShadows) == 52, "Light::CastsShadows isn't where HLSL puts it");
+static_assert(offsetof(Light, ShadowMapIndex) == 56, "Light::ShadowMapIndex isn't where HLSL puts it");
+static_assert(offsetof(Light, ShadowMapCount) == 60, "Light::ShadowMapCount isn't where HLSL puts it");
+static_assert(sizeof(Light) == 64, "Light isn't the size HLSL makes it");
+
+struct VertexShader_PerFrame
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+};
+static_assert(offsetof(VertexShader_PerFrame, view) == 0, "VertexShader_PerFrame::view isn't where HLSL puts it");
+static_assert(offsetof(VertexShader_PerFrame, projection) == 64, "VertexShader_PerFrame::projection isn't where HLSL puts it");
+static_assert(sizeof(VertexShader_PerFrame) == 128, "VertexShader_PerFrame isn't the size HLSL makes it");
+
+struct VertexShader_PerObject
+{
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+};
+static_assert(offsetof(VertexShader_PerObject, world) == 0, "VertexShader_PerObject::world isn't where HLSL puts it");
+static_assert(offsetof(VertexShader_PerObject, worldInvTranspose) == 64, "VertexShader_PerObject::worldInvTranspose isn't where HLSL puts it");
+static_assert(sizeof(VertexShader_PerObject) == 128, "VertexShader_PerObject isn't the size HLSL makes it");
+
+struct PixelShader_PerFrame
+{
+	DirectX::XMFLOAT3 cameraPosition;
+	float _pad0[1];
+	DirectX::XMFLOAT3 ambientTerm;
+	float _pad1[1];
+	Light lights[5];
+	int lightCount;
+	float _pad2[3];
+	DirectX::XMFLOAT4X4 shadowViewProjection[12];
+	DirectX::XMFLOAT4 viewDepthPlane;
+	DirectX::XMFLOAT4 cascadeEnds;
+};
+static_assert(offsetof(PixelShader_PerFrame, cameraPosition) == 0, "PixelShader_PerFrame::cameraPosition isn't where HLSL puts it");
+static_assert(offsetof(PixelShader_PerFrame, ambientTerm) == 16, "PixelShader_PerFrame::ambientTerm isn't where HLSL puts it");
+static_assert(offsetof(PixelShader_PerFrame, lights) == 32, "PixelShader_PerFrame::lights isn't where HLSL puts it");
+static_assert(offsetof(PixelShader_PerFrame, lightCount) == 352, "PixelShader_PerFrame::lightCount isn't where HLSL puts it");
+static_assert(offsetof(PixelShader_PerFrame, shadowViewProjection) == 368, "PixelShader_PerFrame::shadowViewProjection isn't where HLSL puts it");
+static_assert(offsetof(PixelShader_PerFrame, viewDepthPlane) == 1136, "PixelShader_PerFrame::viewDepthPlane isn't where HLSL puts it");
+static_assert(offsetof(PixelShader_PerFrame, cascadeEnds) == 1152, "PixelShader_PerFrame::cascadeEnds isn't where HLSL puts it");
+static_assert(sizeof(PixelShader_PerFrame) == 1168, "PixelShader_PerFrame isn't the size HLSL makes it");
+
+struct PixelShader_PerMaterial
+{
+	DirectX::XMFLOAT3 colorTint;
+	float _pad0[1];
+};
+static_assert(offsetof(PixelShader_PerMaterial, colorTint) == 0, "PixelShader_PerMaterial::colorTint isn't where HLSL puts it");
+static_assert(sizeof(PixelShader_PerMaterial) == 16, "PixelShader_PerMaterial isn't the size HLSL makes it");
+
+struct VertexShader_Shadow_PerFrame
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+};
+static_assert(offsetof(VertexShader_Shadow_PerFrame, view) == 0, "VertexShader_Shadow_PerFrame::view isn't where HLSL puts it");
+static_assert(offsetof(VertexShader_Shadow_PerFrame, projection) == 64, "VertexShader_Shadow_PerFrame::projection isn't where HLSL puts it");
+static_assert(sizeof(VertexShader_Shadow_PerFrame) == 128, "VertexShader_Shadow_PerFrame isn't the size HLSL makes it");
+
+struct VertexShader_Shadow_PerObject
+{
+	DirectX::XMFLOAT4X4 world;
+};
+static_assert(offsetof(VertexShader_Shadow_PerObject, world) == 0, "VertexShader_Shadow_PerObject::world isn't where HLSL puts it");
+static_assert(sizeof(VertexShader_Shadow_PerObject) == 64, "VertexShader_Shadow_PerObject isn't the size HLSL makes it");
+
+struct VertexShader_Sky_PerFrame
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+};
+static_assert(offsetof(VertexShader_Sky_PerFrame, view) == 0, "VertexShader_Sky_PerFrame::view isn't where HLSL puts it");
+static_assert(offsetof(VertexShader_Sky_PerFrame, projection) == 64, "VertexShader_Sky_PerFrame::projection isn't where HLSL puts it");
+static_assert(sizeof(VertexShader_Sky_PerFrame) == 128, "VertexShader_Sky_PerFrame isn't the size HLSL makes it");
+
+struct VertexShader_Instanced_PerFrame
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+};
+static_assert(offsetof(VertexShader_Instanced_PerFrame, view) == 0, "VertexShader_Instanced_PerFrame::view isn't where HLSL puts it");
+static_assert(offsetof(VertexShader_Instanced_PerFrame, projection) == 64, "VertexShader_Instanced_PerFrame::projection isn't where HLSL puts it");
+static_assert(sizeof(VertexShader_Instanced_PerFrame) == 128, "VertexShader_Instanced_PerFrame isn't the size HLSL makes it");
+
+struct VertexShader_Shadow_Instanced_PerFrame
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+};
+static_assert(offsetof(VertexShader_Shadow_Instanced_PerFrame, view) == 0, "VertexShader_Shadow_Instanced_PerFrame::view isn't where HLSL puts it");
+static_assert(offsetof(VertexShader_Shadow_Instanced_PerFrame, projection) == 64, "VertexShader_Shadow_Instanced_PerFrame::projection isn't where HLSL puts it");
+static_assert(sizeof(VertexShader_Shadow_Instanced_PerFrame) == 128, "VertexShader_Shadow_Instanced_PerFrame isn't the size HLSL makes it");
+
+}
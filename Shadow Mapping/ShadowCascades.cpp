@@ -0,0 +1,124 @@
+#include "ShadowCascades.h"
+#include "FrustumCulling.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+void ComputeCascadeSplits(float nearZ, float farZ, unsigned int cascadeCount, float lambda, float* splits)
+{
+	splits[0] = nearZ;
+	for (unsigned int i = 1; i < cascadeCount; i++)
+	{
+		float fraction = (float)i / cascadeCount;
+		float logarithmic = nearZ * powf(farZ / nearZ, fraction);
+		float uniform = nearZ + (farZ - nearZ) * fraction;
+		splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+	}
+	splits[cascadeCount] = farZ;
+}
+
+// --------------------------------------------------------
+// Every corner of the slice is the same distance from the
+// view axis at a given depth, so this is really fitting a
+// circle through two points: a near corner (n, n * slope)
+// and a far one (f, f * slope), in depth and distance from
+// the axis.  The center equidistant from both is at
+// (n + f)(1 + slope^2) / 2 - past f for wide, thin slices,
+// where the far cap's circle is the tightest fit instead.
+// --------------------------------------------------------
+void GetFrustumSliceSphere(float tanHalfFovY, float aspectRatio, float sliceNear, float sliceFar, float& centerZ, float& radius)
+{
+	float tanHalfFovX = tanHalfFovY * aspectRatio;
+	float slopeSquared = tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY;
+
+	centerZ = (sliceNear + sliceFar) * (1.0f + slopeSquared) * 0.5f;
+	if (centerZ > sliceFar)
+		centerZ = sliceFar;
+
+	float farOffset = sliceFar - centerZ;
+	radius = sqrtf(sliceFar * sliceFar * slopeSquared + farOffset * farOffset);
+}
+
+void GetFrustumSliceCorners(float tanHalfFovY, float aspectRatio, float sliceNear, float sliceFar, FXMMATRIX cameraWorld, XMFLOAT3* corners)
+{
+	float tanHalfFovX = tanHalfFovY * aspectRatio;
+	float depths[2] = { sliceNear, sliceFar };
+	for (int d = 0; d < 2; d++)
+	{
+		float x = depths[d] * tanHalfFovX;
+		float y = depths[d] * tanHalfFovY;
+		for (int c = 0; c < 4; c++)
+		{
+			XMVECTOR corner = XMVectorSet((c & 1) ? x : -x, (c & 2) ? y : -y, depths[d], 1.0f);
+			XMStoreFloat3(&corners[d * 4 + c], XMVector3TransformCoord(corner, cameraWorld));
+		}
+	}
+}
+
+//counts the slice ends the depth is past, like the pixel shader's
+//dot(viewDepth > cascadeEnds, 1)
+unsigned int GetCascadeForDepth(const float* splits, unsigned int cascadeCount, float viewDepth)
+{
+	unsigned int cascade = 0;
+	for (unsigned int i = 1; i <= cascadeCount; i++)
+		cascade += viewDepth > splits[i] ? 1 : 0;
+	return cascade;
+}
+
+ShadowCascade FitShadowCascade(XMFLOAT3 center, float radius, XMFLOAT3 lightDirection, unsigned int resolution, float casterDistance)
+{
+	//snapping moves the sphere by up to a texel, so the view is
+	//widened by a texel on each side to keep all of it inside
+	float halfWidth = radius * resolution / (resolution - 2.0f);
+	float texelSize = 2.0f * halfWidth / resolution;
+
+	//light space with no translation - it only turns with the light
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+	XMVECTOR up = fabsf(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0);
+	XMMATRIX lightRotation = XMMatrixLookToLH(XMVectorZero(), direction, up);
+
+	XMFLOAT3 lightCenter;
+	XMStoreFloat3(&lightCenter, XMVector3TransformCoord(XMLoadFloat3(&center), lightRotation));
+	lightCenter.x = floorf(lightCenter.x / texelSize) * texelSize;
+	lightCenter.y = floorf(lightCenter.y / texelSize) * texelSize;
+
+	//the sphere ends up between depths casterDistance and casterDistance + 2 * radius
+	XMMATRIX view = XMMatrixMultiply(lightRotation,
+		XMMatrixTranslation(-lightCenter.x, -lightCenter.y, radius + casterDistance - lightCenter.z));
+	XMMATRIX projection = XMMatrixOrthographicLH(2.0f * halfWidth, 2.0f * halfWidth, 0.0f, 2.0f * radius + casterDistance);
+
+	ShadowCascade cascade;
+	XMStoreFloat4x4(&cascade.View, view);
+	XMStoreFloat4x4(&cascade.Projection, projection);
+	return cascade;
+}
+
+// --------------------------------------------------------
+// The receivers all sit inside the cascade's sphere, so
+// their box is never bigger than the cascade - it's smaller
+// wherever the slice doesn't fill the sphere, which is most
+// of the way round for the thin near cascades
+// --------------------------------------------------------
+void GetShadowCasterPlanes(const ShadowCascade& cascade, const XMFLOAT3* receiverCorners, unsigned int cornerCount, XMFLOAT4* planes)
+{
+	XMMATRIX view = XMLoadFloat4x4(&cascade.View);
+
+	XMVECTOR boxMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR boxMax = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = 0; i < cornerCount; i++)
+	{
+		XMVECTOR corner = XMVector3TransformCoord(XMLoadFloat3(&receiverCorners[i]), view);
+		boxMin = XMVectorMin(boxMin, corner);
+		boxMax = XMVectorMax(boxMax, corner);
+	}
+
+	XMFLOAT3 lightMin, lightMax;
+	XMStoreFloat3(&lightMin, boxMin);
+	XMStoreFloat3(&lightMax, boxMax);
+
+	//the near plane is the cascade's own, casterDistance towards the light
+	XMMATRIX casterProjection = XMMatrixOrthographicOffCenterLH(lightMin.x, lightMax.x, lightMin.y, lightMax.y, 0.0f, lightMax.z);
+	ExtractFrustumPlanes(XMMatrixMultiply(view, casterProjection), planes);
+}
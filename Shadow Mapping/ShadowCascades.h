@@ -0,0 +1,58 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// Most cascades a directional light can be split into
+#define MAX_SHADOW_CASCADES 4
+
+// --------------------------------------------------------
+// Fitting cascaded shadow maps to a perspective camera.
+// The view out to some distance is split into slices, each
+// slice gets a bounding sphere, and each sphere gets its own
+// orthographic light view - the nearest slices are small, so
+// they get most of the texels per world unit.
+//
+// Only DirectXMath, so none of this needs a device.
+// --------------------------------------------------------
+
+// Where the view splits into cascades, by the "practical" scheme: a blend
+// of logarithmic splits (which match how perspective spreads texels out)
+// and uniform ones (which keep the nearest cascades from being tiny).
+// lambda 1 is all logarithmic and 0 all uniform.  splits gets
+// cascadeCount + 1 view depths, from nearZ to farZ.
+void ComputeCascadeSplits(float nearZ, float farZ, unsigned int cascadeCount, float lambda, float* splits);
+
+// The smallest sphere around the part of a perspective frustum between two
+// view depths, in view space.  Its center is always on the view's z axis, so
+// only the depth is returned.  It only depends on the slice's shape, so it
+// doesn't change size as the camera turns.
+void GetFrustumSliceSphere(float tanHalfFovY, float aspectRatio, float sliceNear, float sliceFar, float& centerZ, float& radius);
+
+// The 8 corners of the same slice, near ones first, in world space
+void GetFrustumSliceCorners(float tanHalfFovY, float aspectRatio, float sliceNear, float sliceFar, DirectX::FXMMATRIX cameraWorld, DirectX::XMFLOAT3* corners);
+
+// Which cascade draws the shadows at a view depth, the same way the pixel
+// shader picks one: the slice the depth is in, so a receiver's casters are
+// always the ones culled for its cascade.  cascadeCount past the last split.
+unsigned int GetCascadeForDepth(const float* splits, unsigned int cascadeCount, float viewDepth);
+
+// One cascade's light view and orthographic projection
+struct ShadowCascade
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+};
+
+// Fits a light view around a world space sphere.  The view is centered on
+// the sphere snapped to whole shadow map texels, measured in a light space
+// that only depends on the light's direction, so as the camera moves the
+// cascade slides a texel at a time instead of shimmering.  casterDistance
+// pulls the near plane back towards the light to catch casters outside
+// the sphere.
+ShadowCascade FitShadowCascade(DirectX::XMFLOAT3 center, float radius, DirectX::XMFLOAT3 lightDirection, unsigned int resolution, float casterDistance);
+
+// The 6 world space planes (as ExtractFrustumPlanes gives them) around
+// everything that can cast a shadow onto the given receivers: their box in
+// the cascade's light space, stretched back to the cascade's near plane.
+// Anything outside either misses the receivers or would have been clipped.
+void GetShadowCasterPlanes(const ShadowCascade& cascade, const DirectX::XMFLOAT3* receiverCorners, unsigned int cornerCount, DirectX::XMFLOAT4* planes);
@@ -0,0 +1,230 @@
+#include "SimpleReflectionCache.h"
+
+// Start of every blob, then the format version
+static const unsigned int ReflectionMagic = 0x43525353; // "SSRC"
+static const unsigned int ReflectionVersion = 2;
+
+// No shader comes anywhere near these, so anything
+// bigger means the blob is garbage
+static const unsigned int MaxReflectedCount = 4096;
+
+// --------------------------------------------------------
+// Helpers for writing little-endian values
+// --------------------------------------------------------
+namespace
+{
+	void WriteUInt(std::vector<unsigned char>& out, unsigned int value)
+	{
+		for (int i = 0; i < 4; i++)
+			out.push_back((unsigned char)(value >> (i * 8)));
+	}
+
+	void WriteUInt64(std::vector<unsigned char>& out, unsigned long long value)
+	{
+		for (int i = 0; i < 8; i++)
+			out.push_back((unsigned char)(value >> (i * 8)));
+	}
+
+	void WriteString(std::vector<unsigned char>& out, const std::string& value)
+	{
+		WriteUInt(out, (unsigned int)value.size());
+		out.insert(out.end(), value.begin(), value.end());
+	}
+
+	void WriteResources(std::vector<unsigned char>& out, const std::vector<SimpleReflectedResource>& resources)
+	{
+		WriteUInt(out, (unsigned int)resources.size());
+		for (auto& r : resources)
+		{
+			WriteString(out, r.Name);
+			WriteUInt(out, r.BindIndex);
+		}
+	}
+
+	// Reads values back, failing (for good) once it would run past the end
+	struct Reader
+	{
+		const unsigned char* Data;
+		size_t Size;
+		size_t Position;
+		bool Failed;
+
+		bool Has(size_t bytes)
+		{
+			if (Failed || Size - Position < bytes)
+				Failed = true;
+			return !Failed;
+		}
+
+		unsigned int UInt()
+		{
+			if (!Has(4)) return 0;
+			unsigned int value = 0;
+			for (int i = 0; i < 4; i++)
+				value |= (unsigned int)Data[Position++] << (i * 8);
+			return value;
+		}
+
+		unsigned long long UInt64()
+		{
+			if (!Has(8)) return 0;
+			unsigned long long value = 0;
+			for (int i = 0; i < 8; i++)
+				value |= (unsigned long long)Data[Position++] << (i * 8);
+			return value;
+		}
+
+		unsigned int Count()
+		{
+			unsigned int count = UInt();
+			if (count > MaxReflectedCount) Failed = true;
+			return Failed ? 0 : count;
+		}
+
+		std::string String()
+		{
+			unsigned int length = UInt();
+			if (!Has(length)) return std::string();
+			std::string value((const char*)Data + Position, length);
+			Position += length;
+			return value;
+		}
+
+		void Resources(std::vector<SimpleReflectedResource>& resources)
+		{
+			resources.resize(Count());
+			for (auto& r : resources)
+			{
+				r.Name = String();
+				r.BindIndex = UInt();
+			}
+		}
+	};
+}
+
+// --------------------------------------------------------
+// 64-bit FNV-1a hash of a block of memory
+// --------------------------------------------------------
+unsigned long long SimpleHashBytes(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Writes a header (magic, version, bytecode hash), then
+// each list as a count followed by its entries, and last
+// a hash of all of that.  Strings are a length and then
+// their characters.
+// --------------------------------------------------------
+void SerializeShaderReflection(const SimpleShaderReflection& reflection, unsigned long long bytecodeHash, std::vector<unsigned char>& destination)
+{
+	destination.clear();
+	WriteUInt(destination, ReflectionMagic);
+	WriteUInt(destination, ReflectionVersion);
+	WriteUInt64(destination, bytecodeHash);
+
+	WriteUInt(destination, (unsigned int)reflection.ConstantBuffers.size());
+	for (auto& b : reflection.ConstantBuffers)
+	{
+		WriteString(destination, b.Name);
+		WriteUInt(destination, b.Type);
+		WriteUInt(destination, b.BindIndex);
+		WriteUInt(destination, b.Size);
+
+		WriteUInt(destination, (unsigned int)b.Variables.size());
+		for (auto& v : b.Variables)
+		{
+			WriteString(destination, v.Name);
+			WriteUInt(destination, v.ByteOffset);
+			WriteUInt(destination, v.Size);
+		}
+	}
+
+	WriteResources(destination, reflection.ShaderResourceViews);
+	WriteResources(destination, reflection.Samplers);
+	WriteResources(destination, reflection.UnorderedAccessViews);
+
+	WriteUInt(destination, (unsigned int)reflection.InputElements.size());
+	for (auto& e : reflection.InputElements)
+	{
+		WriteString(destination, e.SemanticName);
+		WriteUInt(destination, e.SemanticIndex);
+		WriteUInt(destination, e.Format);
+		WriteUInt(destination, e.PerInstance ? 1 : 0);
+	}
+
+	// Catches a damaged file, whose values could be anything
+	WriteUInt64(destination, SimpleHashBytes(destination.data(), destination.size()));
+}
+
+// --------------------------------------------------------
+// Reads everything back, checking the hash and header first
+// and the size of every value before it's read
+// --------------------------------------------------------
+bool DeserializeShaderReflection(const void* data, size_t size, unsigned long long bytecodeHash, SimpleShaderReflection& reflection)
+{
+	reflection = SimpleShaderReflection();
+	if (!data || size < 8)
+		return false;
+
+	// Check the contents against the hash at the end first
+	Reader in = { (const unsigned char*)data, size - 8, 0, false };
+	Reader check = { (const unsigned char*)data, size, size - 8, false };
+	if (check.UInt64() != SimpleHashBytes(data, size - 8))
+		return false;
+
+	if (in.UInt() != ReflectionMagic ||
+		in.UInt() != ReflectionVersion ||
+		in.UInt64() != bytecodeHash)
+		return false;
+
+	reflection.ConstantBuffers.resize(in.Count());
+	for (auto& b : reflection.ConstantBuffers)
+	{
+		b.Name = in.String();
+		b.Type = in.UInt();
+		b.BindIndex = in.UInt();
+		b.Size = in.UInt();
+
+		b.Variables.resize(in.Count());
+		for (auto& v : b.Variables)
+		{
+			v.Name = in.String();
+			v.ByteOffset = in.UInt();
+			v.Size = in.UInt();
+
+			// Variables have to fit in their buffer
+			if (v.ByteOffset > b.Size || v.Size > b.Size - v.ByteOffset)
+				in.Failed = true;
+		}
+	}
+
+	in.Resources(reflection.ShaderResourceViews);
+	in.Resources(reflection.Samplers);
+	in.Resources(reflection.UnorderedAccessViews);
+
+	reflection.InputElements.resize(in.Count());
+	for (auto& e : reflection.InputElements)
+	{
+		e.SemanticName = in.String();
+		e.SemanticIndex = in.UInt();
+		e.Format = in.UInt();
+		e.PerInstance = in.UInt() != 0;
+	}
+
+	// Anything left over means it wasn't what we wrote
+	if (in.Failed || in.Position != in.Size)
+	{
+		reflection = SimpleShaderReflection();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Everything SimpleShader needs from reflecting a compiled
+// shader, in plain types so it can be saved next to the
+// .cso and loaded back on later runs without D3DReflect.
+// Enum values (buffer type, DXGI format) are stored as
+// the raw numbers Direct3D uses.
+// --------------------------------------------------------
+struct SimpleReflectedVariable
+{
+	std::string Name;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;
+};
+
+struct SimpleReflectedBuffer
+{
+	std::string Name;
+	unsigned int Type = 0;		// D3D_CBUFFER_TYPE
+	unsigned int BindIndex = 0;
+	unsigned int Size = 0;
+	std::vector<SimpleReflectedVariable> Variables;
+};
+
+// An SRV, sampler or UAV, in the order the shader lists them
+struct SimpleReflectedResource
+{
+	std::string Name;
+	unsigned int BindIndex = 0;
+};
+
+// One vertex shader input, ready for an input layout
+struct SimpleReflectedInputElement
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex = 0;
+	unsigned int Format = 0;	// DXGI_FORMAT
+	bool PerInstance = false;
+};
+
+struct SimpleShaderReflection
+{
+	std::vector<SimpleReflectedBuffer> ConstantBuffers;
+	std::vector<SimpleReflectedResource> ShaderResourceViews;
+	std::vector<SimpleReflectedResource> Samplers;
+	std::vector<SimpleReflectedResource> UnorderedAccessViews;
+	std::vector<SimpleReflectedInputElement> InputElements;
+};
+
+// 64-bit FNV-1a hash of a block of memory
+unsigned long long SimpleHashBytes(const void* data, size_t size);
+
+// Writes the reflection as a compact little-endian binary blob,
+// tagged with a hash of the bytecode it came from
+void SerializeShaderReflection(const SimpleShaderReflection& reflection, unsigned long long bytecodeHash, std::vector<unsigned char>& destination);
+
+// Reads a blob written by SerializeShaderReflection().  Returns false
+// (leaving reflection empty) if the blob is damaged, from another
+// version of the format, or was made from different bytecode.
+bool DeserializeShaderReflection(const void* data, size_t size, unsigned long long bytecodeHash, SimpleShaderReflection& reflection);
@@ -0,0 +1,102 @@
+#include "SimpleRingAllocator.h"
+
+// --------------------------------------------------------
+// Constructor takes the size of the ring in bytes and the
+// alignment of every range it hands out (a power of two)
+// --------------------------------------------------------
+SimpleRingAllocator::SimpleRingAllocator(unsigned int capacity, unsigned int alignment)
+{
+	this->alignment = alignment;
+	this->capacity = capacity & ~(alignment - 1);
+	Reset();
+}
+
+// --------------------------------------------------------
+// Allocates from the head of the ring.  When the space left
+// before the end is too small, the rest of the ring is
+// skipped (counted as used until its frame retires) and the
+// range comes from the start instead.
+// --------------------------------------------------------
+unsigned int SimpleRingAllocator::Allocate(unsigned int size)
+{
+	unsigned int alignedSize = (size + alignment - 1) & ~(alignment - 1);
+	if (alignedSize == 0 || alignedSize > capacity)
+		return InvalidOffset;
+
+	// Nothing in use, so start over from the beginning.  Any frames
+	// still waiting to retire are empty, so they move back too.
+	if (allocatedBytes == freedBytes && head != 0)
+	{
+		head = tail = 0;
+		for (unsigned int i = 0; i < frameCount; i++)
+			frames[(firstFrame + i) % MaxFramesInFlight].Head = 0;
+	}
+
+	unsigned int offset = InvalidOffset;
+	if (allocatedBytes == freedBytes || head > tail)
+	{
+		// Free space is [head, capacity) and then [0, tail)
+		if (capacity - head >= alignedSize)
+		{
+			offset = head;
+		}
+		else if (tail >= alignedSize)
+		{
+			allocatedBytes += capacity - head;
+			offset = 0;
+		}
+	}
+	else if (head < tail && tail - head >= alignedSize)
+	{
+		// Free space is [head, tail)
+		offset = head;
+	}
+
+	// head == tail with something in use means the ring is full
+	if (offset == InvalidOffset)
+		return InvalidOffset;
+
+	head = offset + alignedSize;
+	allocatedBytes += alignedSize;
+	return offset;
+}
+
+bool SimpleRingAllocator::EndFrame()
+{
+	if (frameCount == MaxFramesInFlight)
+		return false;
+
+	FrameFence& fence = frames[(firstFrame + frameCount) % MaxFramesInFlight];
+	fence.Head = head;
+	fence.AllocatedBytes = allocatedBytes;
+	frameCount++;
+	return true;
+}
+
+void SimpleRingAllocator::RetireFrame()
+{
+	if (frameCount == 0)
+		return;
+
+	// Everything up to where the frame ended is free again
+	FrameFence& fence = frames[firstFrame];
+	tail = fence.Head;
+	freedBytes = fence.AllocatedBytes;
+
+	// Nothing left in use at all
+	if (freedBytes == allocatedBytes)
+		tail = head;
+
+	firstFrame = (firstFrame + 1) % MaxFramesInFlight;
+	frameCount--;
+}
+
+void SimpleRingAllocator::Reset()
+{
+	head = 0;
+	tail = 0;
+	allocatedBytes = 0;
+	freedBytes = 0;
+	firstFrame = 0;
+	frameCount = 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// --------------------------------------------------------
+// Hands out aligned ranges of a fixed size ring, oldest
+// first, without touching any memory itself.  Everything
+// allocated between two EndFrame() calls belongs to that
+// frame, and its space only comes back once RetireFrame()
+// says the GPU is done with the frame.
+//
+// Knows nothing about Direct3D, so the bookkeeping can be
+// exercised on its own.
+// --------------------------------------------------------
+class SimpleRingAllocator
+{
+public:
+	// Most frames that can be waiting on the GPU at once
+	static constexpr unsigned int MaxFramesInFlight = 8;
+
+	// Returned by Allocate() when there's no room
+	static constexpr unsigned int InvalidOffset = (unsigned int)-1;
+
+	SimpleRingAllocator(unsigned int capacity, unsigned int alignment = 256);
+
+	// Offset of an aligned range of at least size bytes, or InvalidOffset
+	unsigned int Allocate(unsigned int size);
+
+	// Closes the current frame.  Returns false (and closes nothing)
+	// if MaxFramesInFlight frames are already waiting to retire.
+	bool EndFrame();
+
+	// Frees everything from the oldest closed frame
+	void RetireFrame();
+
+	// Forgets every allocation, as if the ring were brand new
+	void Reset();
+
+	unsigned int GetCapacity() { return capacity; }
+	unsigned int GetAlignment() { return alignment; }
+	unsigned int GetUsedBytes() { return (unsigned int)(allocatedBytes - freedBytes); }
+	unsigned int GetFramesInFlight() { return frameCount; }
+
+private:
+	// Where a closed frame ended, so retiring it knows what to free
+	struct FrameFence
+	{
+		unsigned int Head;
+		unsigned long long AllocatedBytes;
+	};
+
+	unsigned int capacity;
+	unsigned int alignment;
+
+	// Next free byte, and start of the oldest live allocation
+	unsigned int head;
+	unsigned int tail;
+
+	// Running totals (including space skipped when wrapping),
+	// whose difference is the space currently in use
+	unsigned long long allocatedBytes;
+	unsigned long long freedBytes;
+
+	// Closed frames, oldest first, as a small circular queue
+	FrameFence frames[MaxFramesInFlight];
+	unsigned int firstFrame;
+	unsigned int frameCount;
+};
@@ -1,5 +1,9 @@
 #include "SimpleShader.h"
 
+#include <algorithm>
+#include <chrono>
+#include <new>
+
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
@@ -11,6 +15,64 @@ bool ISimpleShader::ReportWarnings = false;
 // ISimpleShader::ReportErrors = true;
 // ISimpleShader::ReportWarnings = true;
 
+// Reflected layouts are saved next to each .cso and reused
+bool ISimpleShader::CacheReflection = true;
+
+// Buffer frequencies come from names unless this is set
+bool ISimpleShader::RecognizeBuffersByRegister = false;
+
+// Constant buffer upload tracking
+bool ISimpleShader::HashBufferContents = false;
+unsigned int ISimpleShader::BufferUploads = 0;
+unsigned int ISimpleShader::BufferUploadsSkipped = 0;
+unsigned long long ISimpleShader::BufferBytesUploaded = 0;
+
+// Handed out to each shader as it's made
+unsigned int ISimpleShader::nextShaderId = 0;
+
+// --------------------------------------------------------
+// Helpers for the metadata arena and its name lookups
+// --------------------------------------------------------
+namespace
+{
+	// Hands out aligned pieces of one block.  With no block
+	// it hands out nulls, and just measures what's needed.
+	struct ArenaCarver
+	{
+		unsigned char* Base;
+		size_t Used;
+
+		void* Take(size_t size, size_t alignment)
+		{
+			Used = (Used + alignment - 1) & ~(alignment - 1);
+			void* piece = Base ? Base + Used : 0;
+			Used += size;
+			return piece;
+		}
+
+		template<typename T>
+		T* TakeArray(size_t count) { return (T*)Take(sizeof(T) * count, alignof(T)); }
+	};
+
+	// Sorts a lookup by name, keeping the first of any duplicates first
+	void SortLookup(SimpleNameLookup* lookup, unsigned int count)
+	{
+		std::stable_sort(lookup, lookup + count,
+			[](const SimpleNameLookup& a, const SimpleNameLookup& b) { return strcmp(a.Name, b.Name) < 0; });
+	}
+
+	// Binary searches a sorted lookup, returning the first
+	// entry with the name or null
+	const SimpleNameLookup* FindName(const SimpleNameLookup* lookup, unsigned int count, const char* name)
+	{
+		const SimpleNameLookup* end = lookup + count;
+		const SimpleNameLookup* found = std::lower_bound(lookup, end, name,
+			[](const SimpleNameLookup& entry, const char* n) { return strcmp(entry.Name, n) < 0; });
+
+		return (found != end && strcmp(found->Name, name) == 0) ? found : 0;
+	}
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -27,8 +89,26 @@ ISimpleShader::ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Micros
 
 	// Set up fields
 	this->constantBufferCount = 0;
+	this->variableCount = 0;
+	this->shaderResourceViewCount = 0;
+	this->samplerCount = 0;
+	this->unorderedAccessViewCount = 0;
+	this->loadMilliseconds = 0;
+	this->metadataArena = 0;
+	this->metadataArenaSize = 0;
 	this->constantBuffers = 0;
+	this->variables = 0;
+	this->shaderResourceViews = 0;
+	this->samplerStates = 0;
+	this->cbLookup = 0;
+	this->varLookup = 0;
+	this->srvLookup = 0;
+	this->samplerLookup = 0;
+	this->uavLookup = 0;
+	this->constantBufferRing = 0;
+	this->stateCache = 0;
 	this->shaderValid = false;
+	this->shaderId = nextShaderId++;
 }
 
 // --------------------------------------------------------
@@ -45,34 +125,36 @@ ISimpleShader::~ISimpleShader()
 // --------------------------------------------------------
 void ISimpleShader::CleanUp()
 {
-	// Handle constant buffers and local data buffers
+	// Constant buffers were constructed in the arena (to
+	// hold their D3D buffers), so they're destroyed by hand
 	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		delete[] constantBuffers[i].LocalDataBuffer;
-	}
-
-	if (constantBuffers)
-	{
-		delete[] constantBuffers;
-		constantBufferCount = 0;
-	}
-
-	for (unsigned int i = 0; i < shaderResourceViews.size(); i++)
-		delete shaderResourceViews[i];
-	
-	for (unsigned int i = 0; i < samplerStates.size(); i++)
-		delete samplerStates[i];
-
-	// Clean up tables
-	varTable.clear();
-	cbTable.clear();
-	samplerTable.clear();
-	textureTable.clear();
+		constantBuffers[i].~SimpleConstantBuffer();
+
+	// Everything else is plain data in the same block
+	delete[] metadataArena;
+	metadataArena = 0;
+	metadataArenaSize = 0;
+
+	constantBufferCount = 0;
+	variableCount = 0;
+	shaderResourceViewCount = 0;
+	samplerCount = 0;
+	unorderedAccessViewCount = 0;
+	constantBuffers = 0;
+	variables = 0;
+	shaderResourceViews = 0;
+	samplerStates = 0;
+	cbLookup = 0;
+	varLookup = 0;
+	srvLookup = 0;
+	samplerLookup = 0;
+	uavLookup = 0;
 }
 
 // --------------------------------------------------------
 // Loads the specified shader and builds the variable table 
-// using shader reflection.
+// using shader reflection (or its saved results, when the
+// bytecode hasn't changed since they were saved).
 //
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
@@ -80,6 +162,8 @@ void ISimpleShader::CleanUp()
 // --------------------------------------------------------
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
+	std::chrono::high_resolution_clock::time_point loadStart = std::chrono::high_resolution_clock::now();
+
 	// Load the shader to a blob and ensure it worked
 	HRESULT hr = D3DReadFileToBlob(shaderFile, shaderBlob.GetAddressOf());
 	if (hr != S_OK)
@@ -94,9 +178,21 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Get the shader's layout, from the file saved next to it if that
+	// came from this exact bytecode, and otherwise by reflecting it
+	SimpleShaderReflection reflection;
+	unsigned long long bytecodeHash = SimpleHashBytes(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+	std::wstring cacheFile = std::wstring(shaderFile) + L".refl";
+	if (!CacheReflection || !LoadReflectionCache(cacheFile, bytecodeHash, reflection))
+	{
+		ReflectShader(reflection);
+		if (CacheReflection)
+			SaveReflectionCache(cacheFile, bytecodeHash, reflection);
+	}
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
+	shaderValid = CreateShader(shaderBlob, reflection);
 	if (!shaderValid)
 	{
 		if (ReportErrors)
@@ -109,6 +205,163 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Set up the buffers, variables and resources, all in one block
+	BuildMetadata(reflection);
+
+	// Create each constant buffer
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		D3D11_BUFFER_DESC newBuffDesc = {};
+		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
+		newBuffDesc.ByteWidth = ((constantBuffers[b].Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
+		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		newBuffDesc.CPUAccessFlags = 0;
+		newBuffDesc.MiscFlags = 0;
+		newBuffDesc.StructureByteStride = 0;
+		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
+	}
+
+	loadMilliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - loadStart).count();
+
+	// All set
+	return true;
+}
+
+// --------------------------------------------------------
+// Puts all of the shader's metadata in a single block:
+// the constant buffers, their variables, the SRVs and
+// samplers, the sorted name lookups (UAVs only have a
+// lookup, of their bind points), the names themselves
+// and every buffer's local data (each 16-byte aligned).
+// The layout is worked out once without a block to get
+// its size, then again to hand out the real pieces.
+// --------------------------------------------------------
+void ISimpleShader::BuildMetadata(const SimpleShaderReflection& reflection)
+{
+	// Count everything up front
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
+	shaderResourceViewCount = (unsigned int)reflection.ShaderResourceViews.size();
+	samplerCount = (unsigned int)reflection.Samplers.size();
+	unorderedAccessViewCount = (unsigned int)reflection.UnorderedAccessViews.size();
+	variableCount = 0;
+
+	size_t nameBytes = 0;
+	size_t localDataBytes = 0;
+	for (auto& b : reflection.ConstantBuffers)
+	{
+		variableCount += (unsigned int)b.Variables.size();
+		nameBytes += b.Name.size() + 1;
+		localDataBytes += ((b.Size + 15) / 16) * 16;
+
+		for (auto& v : b.Variables)
+			nameBytes += v.Name.size() + 1;
+	}
+	for (auto& r : reflection.ShaderResourceViews) nameBytes += r.Name.size() + 1;
+	for (auto& r : reflection.Samplers) nameBytes += r.Name.size() + 1;
+	for (auto& r : reflection.UnorderedAccessViews) nameBytes += r.Name.size() + 1;
+
+	// Measure, allocate, then carve up the real block
+	char* names = 0;
+	unsigned char* localData = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		ArenaCarver carver = { metadataArena, 0 };
+		constantBuffers = carver.TakeArray<SimpleConstantBuffer>(constantBufferCount);
+		variables = carver.TakeArray<SimpleShaderVariable>(variableCount);
+		shaderResourceViews = carver.TakeArray<SimpleSRV>(shaderResourceViewCount);
+		samplerStates = carver.TakeArray<SimpleSampler>(samplerCount);
+		cbLookup = carver.TakeArray<SimpleNameLookup>(constantBufferCount);
+		varLookup = carver.TakeArray<SimpleNameLookup>(variableCount);
+		srvLookup = carver.TakeArray<SimpleNameLookup>(shaderResourceViewCount);
+		samplerLookup = carver.TakeArray<SimpleNameLookup>(samplerCount);
+		uavLookup = carver.TakeArray<SimpleNameLookup>(unorderedAccessViewCount);
+		localData = (unsigned char*)carver.Take(localDataBytes, 16);
+		names = (char*)carver.Take(nameBytes, 1);
+
+		if (!metadataArena)
+		{
+			metadataArenaSize = carver.Used;
+			metadataArena = new unsigned char[metadataArenaSize];
+		}
+	}
+	ZeroMemory(localData, localDataBytes);
+
+	// Copies a name into the block, giving back where it went
+	auto addName = [&names](const std::string& name)
+	{
+		const char* copy = names;
+		memcpy(names, name.c_str(), name.size() + 1);
+		names += name.size() + 1;
+		return copy;
+	};
+
+	// Handle bound resources (like shaders and samplers)
+	for (unsigned int r = 0; r < shaderResourceViewCount; r++)
+	{
+		shaderResourceViews[r].Index = r;													// Raw index
+		shaderResourceViews[r].BindIndex = reflection.ShaderResourceViews[r].BindIndex;		// Shader bind point
+		srvLookup[r] = { addName(reflection.ShaderResourceViews[r].Name), r };
+	}
+
+	for (unsigned int s = 0; s < samplerCount; s++)
+	{
+		samplerStates[s].Index = s;												// Raw index
+		samplerStates[s].BindIndex = reflection.Samplers[s].BindIndex;			// Shader bind point
+		samplerLookup[s] = { addName(reflection.Samplers[s].Name), s };
+	}
+
+	for (unsigned int u = 0; u < unorderedAccessViewCount; u++)
+		uavLookup[u] = { addName(reflection.UnorderedAccessViews[u].Name), reflection.UnorderedAccessViews[u].BindIndex };
+
+	// Loop through all constant buffers
+	unsigned int firstVariable = 0;
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const SimpleReflectedBuffer& bufferDesc = reflection.ConstantBuffers[b];
+
+		// Buffers hold a ComPtr, so they're properly constructed
+		SimpleConstantBuffer* cb = new (&constantBuffers[b]) SimpleConstantBuffer();
+		cb->Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
+		cb->BindIndex = bufferDesc.BindIndex;
+		cb->Name = addName(bufferDesc.Name);
+		cb->Frequency = GetBufferFrequency(bufferDesc.Name, bufferDesc.BindIndex);
+		cb->Size = bufferDesc.Size;
+		cb->LocalDataBuffer = localData;
+		localData += ((bufferDesc.Size + 15) / 16) * 16;
+		cbLookup[b] = { cb->Name, b };
+
+		// Loop through all variables in this buffer
+		cb->Variables = variables + firstVariable;
+		cb->VariableCount = (unsigned int)bufferDesc.Variables.size();
+		for (unsigned int v = 0; v < cb->VariableCount; v++)
+		{
+			const SimpleReflectedVariable& var = bufferDesc.Variables[v];
+			cb->Variables[v].ConstantBufferIndex = b;
+			cb->Variables[v].ByteOffset = var.ByteOffset;
+			cb->Variables[v].Size = var.Size;
+			varLookup[firstVariable + v] = { addName(var.Name), firstVariable + v };
+		}
+		firstVariable += cb->VariableCount;
+	}
+
+	// Sort the lookups for binary searching
+	SortLookup(cbLookup, constantBufferCount);
+	SortLookup(varLookup, variableCount);
+	SortLookup(srvLookup, shaderResourceViewCount);
+	SortLookup(samplerLookup, samplerCount);
+	SortLookup(uavLookup, unorderedAccessViewCount);
+}
+
+// --------------------------------------------------------
+// Fills in the reflection data using shader reflection:
+// constant buffers and their variables, bound resources,
+// and (for vertex shaders) the input layout elements
+// --------------------------------------------------------
+void ISimpleShader::ReflectShader(SimpleShaderReflection& reflection)
+{
+	reflection = SimpleShaderReflection();
+
 	// Set up shader reflection to get information about
 	// this shader and its variables,  buffers, etc.
 	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
@@ -122,10 +375,6 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
 	// Handle bound resources (like shaders and samplers)
 	unsigned int resourceCount = shaderDesc.BoundResources;
 	for (unsigned int r = 0; r < resourceCount; r++)
@@ -139,33 +388,27 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
+			reflection.ShaderResourceViews.push_back({ resourceDesc.Name, resourceDesc.BindPoint });
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
+			reflection.Samplers.push_back({ resourceDesc.Name, resourceDesc.BindPoint });
+			break;
 
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
+		case D3D_SIT_UAV_APPEND_STRUCTURED: // Any kind of UAV
+		case D3D_SIT_UAV_CONSUME_STRUCTURED:
+		case D3D_SIT_UAV_RWBYTEADDRESS:
+		case D3D_SIT_UAV_RWSTRUCTURED:
+		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
+		case D3D_SIT_UAV_RWTYPED:
+			reflection.UnorderedAccessViews.push_back({ resourceDesc.Name, resourceDesc.BindPoint });
 			break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	reflection.ConstantBuffers.resize(shaderDesc.ConstantBuffers);
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
@@ -175,33 +418,16 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
 
-		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
-		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
-
-		// Create this constant buffer
-		D3D11_BUFFER_DESC newBuffDesc = {};
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = ((bufferDesc.Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
-		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
-		newBuffDesc.MiscFlags = 0;
-		newBuffDesc.StructureByteStride = 0;
-		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
 
-		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		SimpleReflectedBuffer& buffer = reflection.ConstantBuffers[b];
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = bufferDesc.Type;
+		buffer.BindIndex = bindDesc.BindPoint;
+		buffer.Size = bufferDesc.Size;
 
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
@@ -210,27 +436,106 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			ID3D11ShaderReflectionVariable* var =
 				cb->GetVariableByIndex(v);
 			
-			// Get the description of the variable and its type
+			// Get the description of the variable
 			D3D11_SHADER_VARIABLE_DESC varDesc;
 			var->GetDesc(&varDesc);
 
-			// Create the variable struct
-			SimpleShaderVariable varStruct = {};
-			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
+			buffer.Variables.push_back({ varDesc.Name, varDesc.StartOffset, varDesc.Size });
+		}
+	}
 
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
-			constantBuffers[b].Variables.push_back(varStruct);
+	// Only vertex shaders need their inputs, for the input layout.
+	// Approach adapted from:
+	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
+	if (D3D11_SHVER_GET_TYPE(shaderDesc.Version) != D3D11_SHVER_VERTEX_SHADER)
+		return;
+
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		SimpleReflectedInputElement element;
+		element.SemanticName = paramDesc.SemanticName;
+		element.SemanticIndex = paramDesc.SemanticIndex;
+
+		// Check the semantic name for "_PER_INSTANCE"
+		std::string perInstanceStr = "_PER_INSTANCE";
+		std::string sem = paramDesc.SemanticName;
+		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
+		element.PerInstance = 
+			lenDiff >= 0 &&
+			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+
+		// Determine DXGI format
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		if (paramDesc.Mask == 1)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32_FLOAT;
 		}
+		else if (paramDesc.Mask <= 3)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 7)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 15)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32A32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32A32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+		element.Format = format;
+
+		reflection.InputElements.push_back(element);
 	}
+}
 
-	// All set
-	return true;
+// --------------------------------------------------------
+// Loads the reflection data saved next to the shader, if
+// there is any and it was made from the same bytecode
+// --------------------------------------------------------
+bool ISimpleShader::LoadReflectionCache(std::wstring cacheFile, unsigned long long bytecodeHash, SimpleShaderReflection& reflection)
+{
+	Microsoft::WRL::ComPtr<ID3DBlob> cacheBlob;
+	if (D3DReadFileToBlob(cacheFile.c_str(), cacheBlob.GetAddressOf()) != S_OK)
+		return false;
+
+	return DeserializeShaderReflection(
+		cacheBlob->GetBufferPointer(),
+		cacheBlob->GetBufferSize(),
+		bytecodeHash,
+		reflection);
+}
+
+// --------------------------------------------------------
+// Saves the reflection data next to the shader.  Failing
+// (a read-only folder, say) just means reflecting again.
+// --------------------------------------------------------
+void ISimpleShader::SaveReflectionCache(std::wstring cacheFile, unsigned long long bytecodeHash, const SimpleShaderReflection& reflection)
+{
+	std::vector<unsigned char> data;
+	SerializeShaderReflection(reflection, bytecodeHash, data);
+
+	Microsoft::WRL::ComPtr<ID3DBlob> cacheBlob;
+	if (D3DCreateBlob(data.size(), cacheBlob.GetAddressOf()) != S_OK)
+		return;
+
+	memcpy(cacheBlob->GetBufferPointer(), data.data(), data.size());
+	if (D3DWriteBlobToFile(cacheBlob.Get(), cacheFile.c_str(), TRUE) != S_OK && ReportWarnings)
+	{
+		LogWarning("SimpleShader::SaveReflectionCache() - Unable to write '");
+		LogW(cacheFile);
+		LogWarning("'. The shader will be reflected again next time.\n");
+	}
 }
 
 // --------------------------------------------------------
@@ -242,16 +547,14 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // --------------------------------------------------------
 SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
-		varTable.find(name);
+	// Look for the name
+	const SimpleNameLookup* result = FindName(varLookup, variableCount, name.c_str());
 
-	// Did we find the key?
-	if (result == varTable.end())
+	// Did we find it?
+	if (!result)
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	SimpleShaderVariable* var = &variables[result->Index];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -266,16 +569,15 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
-		cbTable.find(name);
+	// Look for the name
+	const SimpleNameLookup* result = FindName(cbLookup, constantBufferCount, name.c_str());
 
-	// Did we find the key?
-	if (result == cbTable.end())
+	// Did we find it?
+	if (!result)
 		return 0;
 
 	// Success
-	return result->second;
+	return &constantBuffers[result->Index];
 }
 
 // --------------------------------------------------------
@@ -348,10 +650,8 @@ void ISimpleShader::CopyAllBufferData()
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		// Copy the entire local data buffer (if it changed)
+		UploadBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -379,10 +679,8 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -401,12 +699,195 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(cb);
+}
+
+
+// --------------------------------------------------------
+// Copies local data to every constant buffer that changes
+// at the given frequency, so that (for instance) only the
+// per object data goes up for each draw
+// --------------------------------------------------------
+void ISimpleShader::CopyBufferData(SimpleBufferFrequency frequency)
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return;
+
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		if (constantBuffers[i].Frequency == frequency)
+			UploadBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Works out how often a buffer changes from its name,
+// or from its register if RecognizeBuffersByRegister is set
+// --------------------------------------------------------
+SimpleBufferFrequency ISimpleShader::GetBufferFrequency(const std::string& name, unsigned int bindIndex)
+{
+	if (name == "PerFrame") return SIMPLE_BUFFER_PER_FRAME;
+	if (name == "PerMaterial") return SIMPLE_BUFFER_PER_MATERIAL;
+	if (name == "PerObject") return SIMPLE_BUFFER_PER_OBJECT;
+
+	if (RecognizeBuffersByRegister)
+	{
+		switch (bindIndex)
+		{
+		case 0: return SIMPLE_BUFFER_PER_FRAME;
+		case 1: return SIMPLE_BUFFER_PER_MATERIAL;
+		case 2: return SIMPLE_BUFFER_PER_OBJECT;
+		}
+	}
+
+	return SIMPLE_BUFFER_OTHER;
 }
 
+// --------------------------------------------------------
+// Copies a buffer's local data to the GPU if any of it has
+// been set since the last copy.  Constant buffers can only
+// be updated whole, so this is all or nothing per buffer.
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	// Ring ranges only last for the frame they were written in,
+	// so a buffer with nothing new still goes again next frame
+	bool useRing = constantBufferRing && constantBufferRing->IsSupported() && cb->Type == D3D11_CT_CBUFFER;
+	bool upToDate = !useRing || IsInRing(cb);
+
+	if (!cb->Dirty && upToDate)
+	{
+		BufferUploadsSkipped++;
+		return;
+	}
+	cb->Dirty = false;
+
+	// Set, but possibly to the same values as last time
+	if (HashBufferContents)
+	{
+		unsigned long long hash = SimpleHashBytes(cb->LocalDataBuffer, cb->Size);
+		if (hash == cb->UploadedHash && upToDate)
+		{
+			BufferUploadsSkipped++;
+			return;
+		}
+		cb->UploadedHash = hash;
+	}
+
+	unsigned long long ringFrame = useRing ? constantBufferRing->GetFrameIndex() : 0;
+	if (useRing && constantBufferRing->Upload(cb->LocalDataBuffer, cb->Size, &cb->RingFirstConstant, &cb->RingConstantCount))
+	{
+		// New range, so it needs binding even if the shader is already set
+		cb->RingFrame = constantBufferRing->GetFrameIndex();
+		BindConstantBuffer(cb);
+
+		// The ring overflowed making room, which threw away this
+		// shader's other ranges, and they're still bound
+		if (cb->RingFrame != ringFrame)
+		{
+			for (unsigned int i = 0; i < constantBufferCount; i++)
+			{
+				if (IsRingDataExpired(&constantBuffers[i]))
+					BindConstantBuffer(&constantBuffers[i]);
+			}
+		}
+	}
+	else
+	{
+		deviceContext->UpdateSubresource(
+			cb->ConstantBuffer.Get(), 0, 0,
+			cb->LocalDataBuffer, 0, 0);
+
+		// Too big for the ring, so go back to the shader's own buffer
+		if (useRing)
+		{
+			cb->RingFrame = (unsigned long long)-1;
+			BindConstantBuffer(cb);
+		}
+	}
+
+	BufferUploads++;
+	BufferBytesUploaded += cb->Size;
+}
+
+// --------------------------------------------------------
+// Whether a buffer's latest data is in the ring (and still
+// valid there), rather than in the buffer's own ID3D11Buffer
+// --------------------------------------------------------
+bool ISimpleShader::IsInRing(const SimpleConstantBuffer* cb)
+{
+	return constantBufferRing &&
+		constantBufferRing->IsSupported() &&
+		cb->RingFrame == constantBufferRing->GetFrameIndex();
+}
+
+// --------------------------------------------------------
+// Whether a buffer's latest data went into the ring in an
+// earlier frame (or before the ring overflowed), so it isn't
+// anywhere the GPU can still read it from
+// --------------------------------------------------------
+bool ISimpleShader::IsRingDataExpired(const SimpleConstantBuffer* cb)
+{
+	return constantBufferRing &&
+		constantBufferRing->IsSupported() &&
+		cb->Type == D3D11_CT_CBUFFER &&
+		cb->RingFrame != (unsigned long long)-1 &&
+		cb->RingFrame != constantBufferRing->GetFrameIndex();
+}
+
+// --------------------------------------------------------
+// Whether any of this shader's buffers needs copying into the
+// ring again before its next draw, after the ring overflowed
+// while it was bound.  SetShader() copies and binds them.
+// --------------------------------------------------------
+bool ISimpleShader::HasExpiredRingData()
+{
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		if (IsRingDataExpired(&constantBuffers[i]))
+			return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Switches this shader to copying its constant buffers into
+// the given ring (or back to its own buffers with null).
+// The ring must outlive the shader, or be unset first.
+// --------------------------------------------------------
+void ISimpleShader::SetConstantBufferRing(SimpleConstantBufferRing* ring)
+{
+	constantBufferRing = ring;
+
+	// Everything has to be copied to its new home before the next draw
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		constantBuffers[i].Dirty = true;
+		constantBuffers[i].RingFrame = (unsigned long long)-1;
+	}
+}
+
+// --------------------------------------------------------
+// Makes this shader bind through the given state cache,
+// which drops binds of things that are already bound (or
+// back to binding directly with null).  Every shader using
+// the same context should share one cache.
+// --------------------------------------------------------
+void ISimpleShader::SetStateCache(SimpleStateCache* cache)
+{
+	stateCache = cache;
+}
+
+// --------------------------------------------------------
+// Resets the upload statistics (once per frame, for instance)
+// --------------------------------------------------------
+void ISimpleShader::ResetUploadStats()
+{
+	BufferUploads = 0;
+	BufferUploadsSkipped = 0;
+	BufferBytesUploaded = 0;
+}
 
 // --------------------------------------------------------
 // Sets a variable by name with arbitrary data of the specified size
@@ -450,6 +931,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
 		data,
 		size);
+	constantBuffers[var->ConstantBufferIndex].Dirty = true;
 
 	// Success
 	return true;
@@ -535,6 +1017,198 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Looks up a variable by name and returns a handle for
+// setting it later without another lookup.  The handle
+// is invalid if the variable doesn't exist.
+// --------------------------------------------------------
+SimpleShaderVariableHandle ISimpleShader::GetVariableHandle(std::string name)
+{
+	SimpleShaderVariableHandle handle;
+
+	SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var == 0)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::GetVariableHandle() - Shader variable '");
+			Log(name);
+			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
+		}
+		return handle;
+	}
+
+	handle.ConstantBufferIndex = var->ConstantBufferIndex;
+	handle.ByteOffset = var->ByteOffset;
+	handle.Size = var->Size;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Looks up an SRV by name and returns a handle to it
+// --------------------------------------------------------
+SimpleSRVHandle ISimpleShader::GetShaderResourceViewHandle(std::string name)
+{
+	SimpleSRVHandle handle;
+
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	if (srvInfo == 0)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::GetShaderResourceViewHandle() - SRV named '");
+			Log(name);
+			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
+		}
+		return handle;
+	}
+
+	handle.BindIndex = srvInfo->BindIndex;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Looks up a sampler by name and returns a handle to it
+// --------------------------------------------------------
+SimpleSamplerHandle ISimpleShader::GetSamplerHandle(std::string name)
+{
+	SimpleSamplerHandle handle;
+
+	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	if (sampInfo == 0)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::GetSamplerHandle() - Sampler named '");
+			Log(name);
+			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
+		}
+		return handle;
+	}
+
+	handle.BindIndex = sampInfo->BindIndex;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Gets a handle to a whole constant buffer by name
+//
+// name - The name of the constant buffer in the shader
+//
+// Returns an invalid handle if no buffer has that name
+// --------------------------------------------------------
+SimpleBufferHandle ISimpleShader::GetBufferHandle(std::string name)
+{
+	SimpleBufferHandle handle;
+
+	SimpleConstantBuffer* cb = FindConstantBuffer(name);
+	if (cb == 0)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::GetBufferHandle() - Constant buffer named '");
+			Log(name);
+			LogWarning("' was not found in the shader. Ensure the name is spelled correctly and that it exists in the shader.\n");
+		}
+		return handle;
+	}
+
+	handle.Index = (unsigned int)(cb - constantBuffers);
+	handle.Size = cb->Size;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable through a handle with arbitrary data of
+// the specified size
+//
+// handle - A handle from GetVariableHandle() on this shader
+// data - The data to set in the buffer
+// size - The size of the data (this must be less than or equal to the variable's size)
+//
+// Returns true if data is copied, false if the handle is invalid
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderVariableHandle handle, const void* data, unsigned int size)
+{
+	// Invalid handles (and data that's too big) are skipped quietly,
+	// since the lookup that made the handle already warned about it
+	if (size > handle.Size || handle.ConstantBufferIndex >= constantBufferCount)
+		return false;
+
+	// Set the data in the local data buffer
+	memcpy(
+		constantBuffers[handle.ConstantBufferIndex].LocalDataBuffer + handle.ByteOffset,
+		data,
+		size);
+	constantBuffers[handle.ConstantBufferIndex].Dirty = true;
+
+	// Success
+	return true;
+}
+
+bool ISimpleShader::SetInt(SimpleShaderVariableHandle handle, int data)
+{
+	return this->SetData(handle, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(SimpleShaderVariableHandle handle, float data)
+{
+	return this->SetData(handle, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT2 data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT3 data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT4 data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 16);
+}
+
+// --------------------------------------------------------
+// Copies a whole buffer's worth of data (usually one of the
+// structs from ShaderLayouts.h) into its local data buffer
+//
+// handle - A handle from GetBufferHandle() on this shader
+// data - The data for the entire buffer
+// size - The size of the data, which must match the buffer's
+//
+// Returns true if data is copied, false if the handle is invalid
+// or the size doesn't match (the struct is out of date)
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferData(SimpleBufferHandle handle, const void* data, unsigned int size)
+{
+	if (handle.Index >= constantBufferCount)
+		return false;
+
+	SimpleConstantBuffer* cb = &constantBuffers[handle.Index];
+	if (size != cb->Size)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::SetBufferData() - Data for constant buffer '");
+			Log(cb->Name);
+			LogWarning("' is the wrong size. Regenerate ShaderLayouts.h if the shader has changed.\n");
+		}
+		return false;
+	}
+
+	memcpy(cb->LocalDataBuffer, data, size);
+	cb->Dirty = true;
+	return true;
+}
+
 // --------------------------------------------------------
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
@@ -575,16 +1249,15 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 // --------------------------------------------------------
 const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleSRV*>::iterator result =
-		textureTable.find(name);
+	// Look for the name
+	const SimpleNameLookup* result = FindName(srvLookup, shaderResourceViewCount, name.c_str());
 
-	// Did we find the key?
-	if (result == textureTable.end())
+	// Did we find it?
+	if (!result)
 		return 0;
 
 	// Success
-	return result->second;
+	return &shaderResourceViews[result->Index];
 }
 
 
@@ -596,10 +1269,10 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
 const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 {
 	// Valid index?
-	if (index >= shaderResourceViews.size()) return 0;
+	if (index >= shaderResourceViewCount) return 0;
 
 	// Grab the bind index
-	return shaderResourceViews[index];
+	return &shaderResourceViews[index];
 }
 
 
@@ -610,16 +1283,15 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 // --------------------------------------------------------
 const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleSampler*>::iterator result =
-		samplerTable.find(name);
+	// Look for the name
+	const SimpleNameLookup* result = FindName(samplerLookup, samplerCount, name.c_str());
 
-	// Did we find the key?
-	if (result == samplerTable.end())
+	// Did we find it?
+	if (!result)
 		return 0;
 
 	// Success
-	return result->second;
+	return &samplerStates[result->Index];
 }
 
 // --------------------------------------------------------
@@ -630,10 +1302,10 @@ const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
 const SimpleSampler* ISimpleShader::GetSamplerInfo(unsigned int index)
 {
 	// Valid index?
-	if (index >= samplerStates.size()) return 0;
+	if (index >= samplerCount) return 0;
 
 	// Grab the bind index
-	return samplerStates[index];
+	return &samplerStates[index];
 }
 
 
@@ -741,10 +1413,11 @@ void SimpleVertexShader::CleanUp()
 // Creates the  Direct3D vertex shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - Its layout, reflected or loaded from the cache
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -767,48 +1440,23 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
-	// matches what the vertex shader expects.  Code adapted from:
-	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
-
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
+	// reflected inputs to create an input layout that matches
+	// what the vertex shader expects
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (auto& input : reflection.InputElements)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
-		// Check the semantic name for "_PER_INSTANCE"
-		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
-		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
-		bool isPerInstance = 
-			lenDiff >= 0 &&
-			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
-
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
-		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
+		elementDesc.SemanticName = input.SemanticName.c_str();
+		elementDesc.SemanticIndex = input.SemanticIndex;
+		elementDesc.Format = (DXGI_FORMAT)input.Format;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 		elementDesc.InstanceDataStepRate = 0;
 
 		// Replace anything affected by "per instance" data
-		if (isPerInstance)
+		if (input.PerInstance)
 		{
 			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
 			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
@@ -817,32 +1465,6 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 			perInstanceCompatible = true;
 		}
 
-		// Determine DXGI format
-		if (paramDesc.Mask == 1)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 3)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 7)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 15)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		}
-
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
@@ -869,8 +1491,16 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	if (stateCache)
+	{
+		stateCache->SetInputLayout(inputLayout.Get());
+		stateCache->SetShader(SIMPLE_STAGE_VERTEX, shader.Get());
+	}
+	else
+	{
+		deviceContext->IASetInputLayout(inputLayout.Get());
+		deviceContext->VSSetShader(shader.Get(), 0, 0);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -879,12 +1509,48 @@ void SimpleVertexShader::SetShaderAndCBs()
 		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
 			continue;
 
-		// This is a real constant buffer, so set it
+		// This is a real constant buffer, so set it
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the vertex shader stage,
+// either the shader's own buffer or its range of the ring
+// --------------------------------------------------------
+void SimpleVertexShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	// Its data is only in a ring range that's gone, so copy it
+	// again (which binds the new range) rather than binding the
+	// shader's own buffer, which never got that data
+	if (IsRingDataExpired(cb))
+	{
+		UploadBuffer(cb);
+		return;
+	}
+
+	if (IsInRing(cb))
+	{
+		ID3D11Buffer* ringBuffer = constantBufferRing->GetBuffer();
+		if (stateCache)
+			stateCache->SetConstantBuffer(SIMPLE_STAGE_VERTEX, cb->BindIndex, ringBuffer, cb->RingFirstConstant, cb->RingConstantCount);
+		else
+			constantBufferRing->GetContext1()->VSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingConstantCount);
+		return;
+	}
+
+	if (stateCache)
+		stateCache->SetConstantBuffer(SIMPLE_STAGE_VERTEX, cb->BindIndex, cb->ConstantBuffer.Get());
+	else
 		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+			cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -911,7 +1577,8 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_VERTEX, srvInfo->BindIndex, srv.Get());
+	else deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -941,12 +1608,41 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_VERTEX, sampInfo->BindIndex, samplerState.Get());
+	else deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the vertex shader stage
+// through a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleVertexShader::SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_VERTEX, handle.BindIndex, srv.Get());
+	else deviceContext->VSSetShaderResources(handle.BindIndex, 1, srv.GetAddressOf());
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the vertex shader stage
+// through a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleVertexShader::SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_VERTEX, handle.BindIndex, samplerState.Get());
+	else deviceContext->VSSetSamplers(handle.BindIndex, 1, samplerState.GetAddressOf());
+	return true;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ SIMPLE PIXEL SHADER -------------------------------------------------
@@ -982,10 +1678,11 @@ void SimplePixelShader::CleanUp()
 // Creates the  Direct3D pixel shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - Its layout, reflected or loaded from the cache
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimplePixelShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1012,7 +1709,8 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	if (stateCache) stateCache->SetShader(SIMPLE_STAGE_PIXEL, shader.Get());
+	else deviceContext->PSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1022,11 +1720,47 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the pixel shader stage,
+// either the shader's own buffer or its range of the ring
+// --------------------------------------------------------
+void SimplePixelShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	// Its data is only in a ring range that's gone, so copy it
+	// again (which binds the new range) rather than binding the
+	// shader's own buffer, which never got that data
+	if (IsRingDataExpired(cb))
+	{
+		UploadBuffer(cb);
+		return;
+	}
+
+	if (IsInRing(cb))
+	{
+		ID3D11Buffer* ringBuffer = constantBufferRing->GetBuffer();
+		if (stateCache)
+			stateCache->SetConstantBuffer(SIMPLE_STAGE_PIXEL, cb->BindIndex, ringBuffer, cb->RingFirstConstant, cb->RingConstantCount);
+		else
+			constantBufferRing->GetContext1()->PSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingConstantCount);
+		return;
+	}
+
+	if (stateCache)
+		stateCache->SetConstantBuffer(SIMPLE_STAGE_PIXEL, cb->BindIndex, cb->ConstantBuffer.Get());
+	else
 		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+			cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1053,7 +1787,8 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_PIXEL, srvInfo->BindIndex, srv.Get());
+	else deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1083,12 +1818,41 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_PIXEL, sampInfo->BindIndex, samplerState.Get());
+	else deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the pixel shader stage
+// through a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimplePixelShader::SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_PIXEL, handle.BindIndex, srv.Get());
+	else deviceContext->PSSetShaderResources(handle.BindIndex, 1, srv.GetAddressOf());
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the pixel shader stage
+// through a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimplePixelShader::SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_PIXEL, handle.BindIndex, samplerState.Get());
+	else deviceContext->PSSetSamplers(handle.BindIndex, 1, samplerState.GetAddressOf());
+	return true;
+}
+
 
 
 
@@ -1126,10 +1890,11 @@ void SimpleDomainShader::CleanUp()
 // Creates the  Direct3D domain shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - Its layout, reflected or loaded from the cache
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleDomainShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1156,7 +1921,8 @@ void SimpleDomainShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->DSSetShader(shader.Get(), 0, 0);
+	if (stateCache) stateCache->SetShader(SIMPLE_STAGE_DOMAIN, shader.Get());
+	else deviceContext->DSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1166,11 +1932,47 @@ void SimpleDomainShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the domain shader stage,
+// either the shader's own buffer or its range of the ring
+// --------------------------------------------------------
+void SimpleDomainShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	// Its data is only in a ring range that's gone, so copy it
+	// again (which binds the new range) rather than binding the
+	// shader's own buffer, which never got that data
+	if (IsRingDataExpired(cb))
+	{
+		UploadBuffer(cb);
+		return;
+	}
+
+	if (IsInRing(cb))
+	{
+		ID3D11Buffer* ringBuffer = constantBufferRing->GetBuffer();
+		if (stateCache)
+			stateCache->SetConstantBuffer(SIMPLE_STAGE_DOMAIN, cb->BindIndex, ringBuffer, cb->RingFirstConstant, cb->RingConstantCount);
+		else
+			constantBufferRing->GetContext1()->DSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingConstantCount);
+		return;
+	}
+
+	if (stateCache)
+		stateCache->SetConstantBuffer(SIMPLE_STAGE_DOMAIN, cb->BindIndex, cb->ConstantBuffer.Get());
+	else
 		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+			cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1197,7 +1999,8 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_DOMAIN, srvInfo->BindIndex, srv.Get());
+	else deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1227,12 +2030,41 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_DOMAIN, sampInfo->BindIndex, samplerState.Get());
+	else deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the domain shader stage
+// through a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleDomainShader::SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_DOMAIN, handle.BindIndex, srv.Get());
+	else deviceContext->DSSetShaderResources(handle.BindIndex, 1, srv.GetAddressOf());
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the domain shader stage
+// through a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleDomainShader::SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_DOMAIN, handle.BindIndex, samplerState.Get());
+	else deviceContext->DSSetSamplers(handle.BindIndex, 1, samplerState.GetAddressOf());
+	return true;
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1269,10 +2101,11 @@ void SimpleHullShader::CleanUp()
 // Creates the  Direct3D hull shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - Its layout, reflected or loaded from the cache
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleHullShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1299,7 +2132,8 @@ void SimpleHullShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->HSSetShader(shader.Get(), 0, 0);
+	if (stateCache) stateCache->SetShader(SIMPLE_STAGE_HULL, shader.Get());
+	else deviceContext->HSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1309,11 +2143,47 @@ void SimpleHullShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the hull shader stage,
+// either the shader's own buffer or its range of the ring
+// --------------------------------------------------------
+void SimpleHullShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	// Its data is only in a ring range that's gone, so copy it
+	// again (which binds the new range) rather than binding the
+	// shader's own buffer, which never got that data
+	if (IsRingDataExpired(cb))
+	{
+		UploadBuffer(cb);
+		return;
+	}
+
+	if (IsInRing(cb))
+	{
+		ID3D11Buffer* ringBuffer = constantBufferRing->GetBuffer();
+		if (stateCache)
+			stateCache->SetConstantBuffer(SIMPLE_STAGE_HULL, cb->BindIndex, ringBuffer, cb->RingFirstConstant, cb->RingConstantCount);
+		else
+			constantBufferRing->GetContext1()->HSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingConstantCount);
+		return;
+	}
+
+	if (stateCache)
+		stateCache->SetConstantBuffer(SIMPLE_STAGE_HULL, cb->BindIndex, cb->ConstantBuffer.Get());
+	else
 		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+			cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1340,7 +2210,8 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 	}
 
 	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_HULL, srvInfo->BindIndex, srv.Get());
+	else deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1370,12 +2241,41 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 	}
 
 	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_HULL, sampInfo->BindIndex, samplerState.Get());
+	else deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the hull shader stage
+// through a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleHullShader::SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_HULL, handle.BindIndex, srv.Get());
+	else deviceContext->HSSetShaderResources(handle.BindIndex, 1, srv.GetAddressOf());
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the hull shader stage
+// through a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleHullShader::SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_HULL, handle.BindIndex, samplerState.Get());
+	else deviceContext->HSSetSamplers(handle.BindIndex, 1, samplerState.GetAddressOf());
+	return true;
+}
+
 
 
 
@@ -1417,10 +2317,11 @@ void SimpleGeometryShader::CleanUp()
 // Creates the  Direct3D Geometry shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - Its layout, reflected or loaded from the cache
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleGeometryShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1573,7 +2474,8 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->GSSetShader(shader.Get(), 0, 0);
+	if (stateCache) stateCache->SetShader(SIMPLE_STAGE_GEOMETRY, shader.Get());
+	else deviceContext->GSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1583,11 +2485,47 @@ void SimpleGeometryShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the geometry shader stage,
+// either the shader's own buffer or its range of the ring
+// --------------------------------------------------------
+void SimpleGeometryShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	// Its data is only in a ring range that's gone, so copy it
+	// again (which binds the new range) rather than binding the
+	// shader's own buffer, which never got that data
+	if (IsRingDataExpired(cb))
+	{
+		UploadBuffer(cb);
+		return;
+	}
+
+	if (IsInRing(cb))
+	{
+		ID3D11Buffer* ringBuffer = constantBufferRing->GetBuffer();
+		if (stateCache)
+			stateCache->SetConstantBuffer(SIMPLE_STAGE_GEOMETRY, cb->BindIndex, ringBuffer, cb->RingFirstConstant, cb->RingConstantCount);
+		else
+			constantBufferRing->GetContext1()->GSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingConstantCount);
+		return;
+	}
+
+	if (stateCache)
+		stateCache->SetConstantBuffer(SIMPLE_STAGE_GEOMETRY, cb->BindIndex, cb->ConstantBuffer.Get());
+	else
 		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+			cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1614,7 +2552,8 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 	}
 
 	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_GEOMETRY, srvInfo->BindIndex, srv.Get());
+	else deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1644,12 +2583,41 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 	}
 
 	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_GEOMETRY, sampInfo->BindIndex, samplerState.Get());
+	else deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the geometry shader stage
+// through a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_GEOMETRY, handle.BindIndex, srv.Get());
+	else deviceContext->GSSetShaderResources(handle.BindIndex, 1, srv.GetAddressOf());
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the geometry shader stage
+// through a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_GEOMETRY, handle.BindIndex, samplerState.Get());
+	else deviceContext->GSSetSamplers(handle.BindIndex, 1, samplerState.GetAddressOf());
+	return true;
+}
+
 // --------------------------------------------------------
 // Calculates the number of components specified by a parameter description mask
 //
@@ -1702,18 +2670,17 @@ SimpleComputeShader::~SimpleComputeShader()
 void SimpleComputeShader::CleanUp()
 {
 	ISimpleShader::CleanUp();
-
-	uavTable.clear();
 }
 
 // --------------------------------------------------------
 // Creates the  Direct3D Compute shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - Its layout, reflected or loaded from the cache
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1730,7 +2697,8 @@ bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBl
 	if (result != S_OK)
 		return false;
 
-	// Set up shader reflection to get information about UAV's
+	// Set up shader reflection to get the thread group size
+	// (the UAVs come in with the rest of the metadata)
 	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
 	D3DReflect(
 		shaderBlob->GetBufferPointer(),
@@ -1738,37 +2706,12 @@ bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBl
 		IID_ID3D11ShaderReflection,
 		(void**)refl.GetAddressOf());
 
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-	
 	// Grab the thread info
 	threadsTotal = refl->GetThreadGroupSize(
 		&threadsX,
 		&threadsY,
 		&threadsZ);
 
-	// Loop and get all UAV resources
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
-	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
-
-		// Check the type, looking for any kind of UAV
-		switch (resourceDesc.Type)
-		{
-		case D3D_SIT_UAV_APPEND_STRUCTURED:
-		case D3D_SIT_UAV_CONSUME_STRUCTURED:
-		case D3D_SIT_UAV_RWBYTEADDRESS:
-		case D3D_SIT_UAV_RWSTRUCTURED:
-		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
-		case D3D_SIT_UAV_RWTYPED:
-			uavTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
-		}
-	}
-
 	// All set
 	return true;
 }
@@ -1783,7 +2726,8 @@ void SimpleComputeShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->CSSetShader(shader.Get(), 0, 0);
+	if (stateCache) stateCache->SetShader(SIMPLE_STAGE_COMPUTE, shader.Get());
+	else deviceContext->CSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1793,11 +2737,47 @@ void SimpleComputeShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to the compute shader stage,
+// either the shader's own buffer or its range of the ring
+// --------------------------------------------------------
+void SimpleComputeShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	// Its data is only in a ring range that's gone, so copy it
+	// again (which binds the new range) rather than binding the
+	// shader's own buffer, which never got that data
+	if (IsRingDataExpired(cb))
+	{
+		UploadBuffer(cb);
+		return;
+	}
+
+	if (IsInRing(cb))
+	{
+		ID3D11Buffer* ringBuffer = constantBufferRing->GetBuffer();
+		if (stateCache)
+			stateCache->SetConstantBuffer(SIMPLE_STAGE_COMPUTE, cb->BindIndex, ringBuffer, cb->RingFirstConstant, cb->RingConstantCount);
+		else
+			constantBufferRing->GetContext1()->CSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingConstantCount);
+		return;
+	}
+
+	if (stateCache)
+		stateCache->SetConstantBuffer(SIMPLE_STAGE_COMPUTE, cb->BindIndex, cb->ConstantBuffer.Get());
+	else
 		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
-	}
+			cb->ConstantBuffer.GetAddressOf());
 }
 
 // --------------------------------------------------------
@@ -1885,7 +2865,8 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_COMPUTE, srvInfo->BindIndex, srv.Get());
+	else deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1915,12 +2896,41 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_COMPUTE, sampInfo->BindIndex, samplerState.Get());
+	else deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view in the compute shader stage
+// through a handle from GetShaderResourceViewHandle()
+// --------------------------------------------------------
+bool SimpleComputeShader::SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetShaderResourceView(SIMPLE_STAGE_COMPUTE, handle.BindIndex, srv.Get());
+	else deviceContext->CSSetShaderResources(handle.BindIndex, 1, srv.GetAddressOf());
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the compute shader stage
+// through a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleComputeShader::SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+{
+	if (!handle.IsValid())
+		return false;
+
+	if (stateCache) stateCache->SetSampler(SIMPLE_STAGE_COMPUTE, handle.BindIndex, samplerState.Get());
+	else deviceContext->CSSetSamplers(handle.BindIndex, 1, samplerState.GetAddressOf());
+	return true;
+}
+
 // --------------------------------------------------------
 // Sets an unordered access view in the Compute shader stage
 //
@@ -1957,14 +2967,149 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WR
 // --------------------------------------------------------
 int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
 {
-	// Look for the key
-	std::unordered_map<std::string, unsigned int>::iterator result =
-		uavTable.find(name);
+	// Look for the name
+	const SimpleNameLookup* result = FindName(uavLookup, unorderedAccessViewCount, name.c_str());
 
-	// Did we find the key?
-	if (result == uavTable.end())
+	// Did we find it?
+	if (!result)
 		return -1;
 
 	// Success
-	return result->second;
-}
\ No newline at end of file
+	return result->Index;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ CONSTANT BUFFER RING ------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// --------------------------------------------------------
+// Creates the ring's dynamic buffer and its frame queries,
+// if the device can bind constant buffers with offsets
+// --------------------------------------------------------
+SimpleConstantBufferRing::SimpleConstantBufferRing(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int sizeInBytes)
+	: allocator(sizeInBytes, 256) // Offsets must be multiples of 16 constants
+{
+	this->context = context;
+	this->supported = false;
+	this->discardNextMap = true;
+	this->frameIndex = 0;
+	this->overflowCount = 0;
+	this->firstQuery = 0;
+
+	// Offsets need the 11.1 context, plus driver support for both
+	// offsetting and NO_OVERWRITE maps of constant buffers
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	if (!options.ConstantBufferOffsetting ||
+		!options.MapNoOverwriteOnDynamicConstantBuffer ||
+		FAILED(context.As(&context1)))
+		return;
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.ByteWidth = allocator.GetCapacity();
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(device->CreateBuffer(&bufferDesc, 0, buffer.GetAddressOf())))
+		return;
+
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	for (unsigned int i = 0; i < SimpleRingAllocator::MaxFramesInFlight; i++)
+	{
+		if (FAILED(device->CreateQuery(&queryDesc, frameQueries[i].GetAddressOf())))
+			return;
+	}
+
+	supported = true;
+}
+
+SimpleConstantBufferRing::~SimpleConstantBufferRing() {}
+
+// --------------------------------------------------------
+// Starts a new frame, first freeing the space of every
+// frame the GPU has finished with (without waiting on it)
+// --------------------------------------------------------
+void SimpleConstantBufferRing::BeginFrame()
+{
+	frameIndex++;
+	if (!supported) return;
+
+	while (allocator.GetFramesInFlight() > 0 &&
+		context->GetData(frameQueries[firstQuery].Get(), 0, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+	{
+		allocator.RetireFrame();
+		firstQuery = (firstQuery + 1) % SimpleRingAllocator::MaxFramesInFlight;
+	}
+}
+
+// --------------------------------------------------------
+// Closes the frame and marks where its commands end, so
+// its space can be reused once the GPU gets that far
+// --------------------------------------------------------
+void SimpleConstantBufferRing::EndFrame()
+{
+	if (!supported) return;
+
+	// Too many frames queued up - wait on the oldest
+	if (allocator.GetFramesInFlight() == SimpleRingAllocator::MaxFramesInFlight)
+	{
+		while (context->GetData(frameQueries[firstQuery].Get(), 0, 0, 0) == S_FALSE) {}
+		allocator.RetireFrame();
+		firstQuery = (firstQuery + 1) % SimpleRingAllocator::MaxFramesInFlight;
+	}
+
+	unsigned int query = (firstQuery + allocator.GetFramesInFlight()) % SimpleRingAllocator::MaxFramesInFlight;
+	context->End(frameQueries[query].Get());
+	allocator.EndFrame();
+}
+
+// --------------------------------------------------------
+// Copies data into the next free range of the ring
+//
+// data - The data to copy
+// size - Its size in bytes (rounded up to 256 in the ring)
+// firstConstant, constantCount - The range to bind, in 16 byte constants
+//
+// Returns false if the data can't go in the ring at all
+// --------------------------------------------------------
+bool SimpleConstantBufferRing::Upload(const void* data, unsigned int size, unsigned int* firstConstant, unsigned int* constantCount)
+{
+	if (!supported) return false;
+
+	unsigned int offset = allocator.Allocate(size);
+	if (offset == SimpleRingAllocator::InvalidOffset)
+	{
+		// Bigger than the whole ring
+		if (size > allocator.GetCapacity())
+			return false;
+
+		// Full of frames the GPU hasn't finished, so let the
+		// driver hand over a fresh copy of the buffer instead
+		allocator.Reset();
+		firstQuery = 0;
+		discardNextMap = true;
+		overflowCount++;
+
+		// Ranges handed out earlier this frame are gone with the old
+		// copy, so act like a new frame and have everything copied again
+		frameIndex++;
+
+		offset = allocator.Allocate(size);
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	D3D11_MAP mapType = discardNextMap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (FAILED(context->Map(buffer.Get(), 0, mapType, 0, &mapped)))
+		return false;
+
+	memcpy((unsigned char*)mapped.pData + offset, data, size);
+	context->Unmap(buffer.Get(), 0);
+	discardNextMap = false;
+
+	unsigned int alignment = allocator.GetAlignment();
+	*firstConstant = offset / 16;
+	*constantCount = ((size + alignment - 1) / alignment) * (alignment / 16);
+	return true;
+}
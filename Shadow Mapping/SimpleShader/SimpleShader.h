@@ -3,14 +3,17 @@
 #pragma comment(lib, "d3dcompiler.lib")
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <wrl/client.h>
 
-#include <unordered_map>
 #include <vector>
 #include <string>
 
+#include "SimpleRingAllocator.h"
+#include "SimpleStateCache.h"
+#include "SimpleReflectionCache.h"
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -23,6 +26,18 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// --------------------------------------------------------
+// How often a constant buffer's data changes, recognized
+// from the buffer's name (PerFrame, PerMaterial, PerObject)
+// --------------------------------------------------------
+enum SimpleBufferFrequency
+{
+	SIMPLE_BUFFER_OTHER,		// Not named for a frequency
+	SIMPLE_BUFFER_PER_FRAME,
+	SIMPLE_BUFFER_PER_MATERIAL,
+	SIMPLE_BUFFER_PER_OBJECT
+};
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -30,13 +45,75 @@ struct SimpleShaderVariable
 // --------------------------------------------------------
 struct SimpleConstantBuffer
 {
-	std::string Name;
+	const char* Name = 0;
 	D3D_CBUFFER_TYPE Type = D3D_CBUFFER_TYPE::D3D11_CT_CBUFFER;
 	unsigned int Size = 0;
 	unsigned int BindIndex = 0;
+	SimpleBufferFrequency Frequency = SIMPLE_BUFFER_OTHER;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
-	std::vector<SimpleShaderVariable> Variables;
+	SimpleShaderVariable* Variables = 0;
+	unsigned int VariableCount = 0;
+	bool Dirty = true;						// Local data changed since the last upload
+	unsigned long long UploadedHash = 0;	// Hash of the last upload (only with HashBufferContents)
+
+	// Where the data went in the shader's constant buffer ring, if it has one
+	unsigned int RingFirstConstant = 0;
+	unsigned int RingConstantCount = 0;
+	unsigned long long RingFrame = (unsigned long long)-1;	// Ring frame of that upload
+};
+
+// --------------------------------------------------------
+// One large dynamic constant buffer that shaders can copy
+// their per-draw data into, each draw getting its own range
+// for the frame, rather than every shader rewriting its own
+// buffers over and over.  Ranges are bound with offsets
+// (VSSetConstantBuffers1 and friends), which needs a
+// Direct3D 11.1 driver - check IsSupported().
+//
+// Writes use MAP_WRITE_NO_OVERWRITE, with a frame's space
+// only reused once an event query says the GPU is past it.
+// MAP_WRITE_DISCARD is only used the first time, or if the
+// ring ever fills up while frames are still in flight.
+// --------------------------------------------------------
+class SimpleConstantBufferRing
+{
+public:
+	SimpleConstantBufferRing(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int sizeInBytes = 4 * 1024 * 1024);
+	~SimpleConstantBufferRing();
+
+	bool IsSupported() { return supported; }
+
+	// Call at the start and end of every frame that uses the ring
+	void BeginFrame();
+	void EndFrame();
+
+	// Copies data into the ring and gives back the range to bind,
+	// in shader constants (16 bytes each).  False if it won't fit.
+	bool Upload(const void* data, unsigned int size, unsigned int* firstConstant, unsigned int* constantCount);
+
+	ID3D11Buffer* GetBuffer() { return buffer.Get(); }
+	ID3D11DeviceContext1* GetContext1() { return context1.Get(); }
+	// Changes every frame (and if the ring overflows), invalidating older ranges
+	unsigned long long GetFrameIndex() { return frameIndex; }
+
+	// Times the ring had to be thrown away (DISCARD) because it was full
+	unsigned int GetOverflowCount() { return overflowCount; }
+
+private:
+	SimpleRingAllocator allocator;
+	bool supported;
+	bool discardNextMap;
+	unsigned long long frameIndex;
+	unsigned int overflowCount;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+
+	// One event query per frame in flight, in the same order as the allocator's frames
+	Microsoft::WRL::ComPtr<ID3D11Query> frameQueries[SimpleRingAllocator::MaxFramesInFlight];
+	unsigned int firstQuery;
 };
 
 // --------------------------------------------------------
@@ -57,6 +134,61 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// --------------------------------------------------------
+// One entry in a shader's name lookups, which are kept
+// sorted by name and binary searched
+// --------------------------------------------------------
+struct SimpleNameLookup
+{
+	const char* Name;
+	unsigned int Index;
+};
+
+// --------------------------------------------------------
+// Handle to a constant buffer variable, found by name once
+// so that setting it later skips the table lookup entirely.
+// Only valid for the shader that handed it out.
+// --------------------------------------------------------
+struct SimpleShaderVariableHandle
+{
+	unsigned int ConstantBufferIndex = 0;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;	// Zero if the variable wasn't found
+
+	bool IsValid() const { return Size > 0; }
+};
+
+// --------------------------------------------------------
+// Handles to an SRV or sampler, which boil down to the
+// register to bind to
+// --------------------------------------------------------
+struct SimpleSRVHandle
+{
+	unsigned int BindIndex = (unsigned int)-1;
+
+	bool IsValid() const { return BindIndex != (unsigned int)-1; }
+};
+
+struct SimpleSamplerHandle
+{
+	unsigned int BindIndex = (unsigned int)-1;
+
+	bool IsValid() const { return BindIndex != (unsigned int)-1; }
+};
+
+// --------------------------------------------------------
+// Handle to a whole constant buffer, for setting all of
+// its data at once from a matching struct (see the
+// generated ShaderLayouts.h)
+// --------------------------------------------------------
+struct SimpleBufferHandle
+{
+	unsigned int Index = (unsigned int)-1;
+	unsigned int Size = 0;
+
+	bool IsValid() const { return Index != (unsigned int)-1; }
+};
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
@@ -69,11 +201,17 @@ public:
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
+	// Small number unique to this shader object (counting up from
+	// zero as shaders are made), for things like draw sort keys
+	unsigned int GetShaderId() { return shaderId; }
+
 	// Activating the shader and copying data
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(SimpleBufferFrequency frequency);
+	bool HasExpiredRingData();
 
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
@@ -89,9 +227,38 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Looking up handles (once, ahead of time)
+	SimpleShaderVariableHandle GetVariableHandle(std::string name);
+	SimpleSRVHandle GetShaderResourceViewHandle(std::string name);
+	SimpleSamplerHandle GetSamplerHandle(std::string name);
+	SimpleBufferHandle GetBufferHandle(std::string name);
+
+	// Sets shader data through a handle, straight into the local data buffer
+	bool SetData(SimpleShaderVariableHandle handle, const void* data, unsigned int size);
+
+	bool SetInt(SimpleShaderVariableHandle handle, int data);
+	bool SetFloat(SimpleShaderVariableHandle handle, float data);
+	bool SetFloat2(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT4X4& data);
+
+	// Replaces a buffer's whole local data, which must be exactly its size
+	bool SetBufferData(SimpleBufferHandle handle, const void* data, unsigned int size);
+
+	// Copies constant buffers into a shared ring instead of the shader's
+	// own buffers, or back to normal with null.  Not owned by the shader.
+	void SetConstantBufferRing(SimpleConstantBufferRing* ring);
+
+	// Binds through a shared cache that skips redundant binds,
+	// or directly with null.  Not owned by the shader.
+	void SetStateCache(SimpleStateCache* cache);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
 	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
+	virtual bool SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
+	virtual bool SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
 
 	// Simple resource checking
 	bool HasVariable(std::string name);
@@ -103,11 +270,11 @@ public:
 	
 	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
-	size_t GetShaderResourceViewCount() { return textureTable.size(); }
+	size_t GetShaderResourceViewCount() { return shaderResourceViewCount; }
 	
 	const SimpleSampler* GetSamplerInfo(std::string name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
-	size_t GetSamplerCount() { return samplerTable.size(); }
+	size_t GetSamplerCount() { return samplerCount; }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
@@ -118,35 +285,93 @@ public:
 	// Misc getters
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
 
+	// Bytes of metadata (buffers, variables, resources, names and
+	// local data) and how long the shader took to load
+	size_t GetMetadataSize() { return metadataArenaSize; }
+	double GetLoadMilliseconds() { return loadMilliseconds; }
+
 	// Error reporting
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Save each shader's reflected layout next to its .cso (as .cso.refl)
+	// and load it from there on later runs, skipping reflection
+	static bool CacheReflection;
+
+	// Also recognize buffer frequencies by register when the name doesn't
+	// say: b0 is per frame, b1 per material and b2 per object
+	static bool RecognizeBuffersByRegister;
+
+	// Also skip uploads of dirty buffers whose contents hash the same
+	// as what was last uploaded (catches values re-set to the same thing)
+	static bool HashBufferContents;
+
+	// Upload statistics across all shaders, since the last reset
+	static unsigned int BufferUploads;
+	static unsigned int BufferUploadsSkipped;
+	static unsigned long long BufferBytesUploaded;
+	static void ResetUploadStats();
+
 protected:
 	
 	bool shaderValid;
+	unsigned int shaderId;
+	static unsigned int nextShaderId;
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 
 	// Resource counts
 	unsigned int constantBufferCount;
+	unsigned int variableCount;
+	unsigned int shaderResourceViewCount;
+	unsigned int samplerCount;
+	unsigned int unorderedAccessViewCount;
+
+	// Time spent in LoadShaderFile()
+	double loadMilliseconds;
 	
-	// Maps for variables and buffers
-	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
-	std::vector<SimpleSRV*>		shaderResourceViews;
-	std::vector<SimpleSampler*>	samplerStates;
-	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
-	std::unordered_map<std::string, SimpleSRV*> textureTable;
-	std::unordered_map<std::string, SimpleSampler*> samplerTable;
+	// Optional shared ring for constant buffer data
+	SimpleConstantBufferRing* constantBufferRing;
+
+	// Optional shared cache of what's bound to the context
+	SimpleStateCache* stateCache;
+
+	// One block holding everything below, along with the names
+	// and local data buffers, so a shader makes a single allocation
+	unsigned char* metadataArena;
+	size_t metadataArenaSize;
+
+	// Arrays for index-based lookup
+	SimpleConstantBuffer*	constantBuffers;
+	SimpleShaderVariable*	variables;	// Every buffer's variables, in buffer order
+	SimpleSRV*				shaderResourceViews;
+	SimpleSampler*			samplerStates;
+
+	// Name lookups, sorted by name (Index is into the arrays above)
+	SimpleNameLookup* cbLookup;
+	SimpleNameLookup* varLookup;
+	SimpleNameLookup* srvLookup;
+	SimpleNameLookup* samplerLookup;
+	SimpleNameLookup* uavLookup;	// Index is the UAV's bind point
 
 	// Initialization method
 	bool LoadShaderFile(LPCWSTR shaderFile);
 
+	// Lays out and fills in the metadata arena from the reflection
+	void BuildMetadata(const SimpleShaderReflection& reflection);
+
+	// Getting the shader's layout, and saving it for next time.  The
+	// layout only lives through LoadShaderFile() - once the metadata
+	// and input layout are built from it, it isn't needed
+	void ReflectShader(SimpleShaderReflection& reflection);
+	bool LoadReflectionCache(std::wstring cacheFile, unsigned long long bytecodeHash, SimpleShaderReflection& reflection);
+	void SaveReflectionCache(std::wstring cacheFile, unsigned long long bytecodeHash, const SimpleShaderReflection& reflection);
+
 	// Pure virtual functions for dealing with shader types
-	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
+	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection) = 0;
 	virtual void SetShaderAndCBs() = 0;
+	virtual void BindConstantBuffer(SimpleConstantBuffer* cb) = 0;
 
 	virtual void CleanUp();
 
@@ -154,6 +379,18 @@ protected:
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
 
+	// Uploads one buffer's local data, unless nothing changed
+	void UploadBuffer(SimpleConstantBuffer* cb);
+
+	// Buffer frequency from its name or register
+	SimpleBufferFrequency GetBufferFrequency(const std::string& name, unsigned int bindIndex);
+
+	// Whether a buffer should be bound from the ring right now
+	bool IsInRing(const SimpleConstantBuffer* cb);
+
+	// Whether a buffer's data was only in a ring range that's gone
+	bool IsRingDataExpired(const SimpleConstantBuffer* cb);
+
 	// Error logging
 	void Log(std::string message, WORD color);
 	void LogW(std::wstring message, WORD color);
@@ -180,13 +417,16 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	bool perInstanceCompatible;
 	 Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -203,11 +443,14 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -223,11 +466,14 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -243,11 +489,14 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -263,6 +512,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, int vertexCount);
 
@@ -277,9 +528,10 @@ protected:
 	bool allowStreamOutRasterization;
 	unsigned int streamOutVertexSize;
 
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection);
 	bool CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 
 	// Helpers
@@ -304,20 +556,22 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleSRVHandle handle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool SetSamplerState(SimpleSamplerHandle handle, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 	bool SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11ComputeShader> shader;
-	std::unordered_map<std::string, unsigned int> uavTable;
 
 	unsigned int threadsX;
 	unsigned int threadsY;
 	unsigned int threadsZ;
 	unsigned int threadsTotal;
 
-	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob, const SimpleShaderReflection& reflection);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
\ No newline at end of file
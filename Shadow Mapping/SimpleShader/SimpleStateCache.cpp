@@ -0,0 +1,175 @@
+#include "SimpleStateCache.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Constructor takes the context whose state it shadows.
+// Nothing is known to be bound yet.
+// --------------------------------------------------------
+SimpleStateCache::SimpleStateCache(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	this->context = context;
+	context.As(&context1);
+
+	issuedCalls = 0;
+	elidedCalls = 0;
+	Invalidate();
+}
+
+SimpleStateCache::~SimpleStateCache()
+{
+}
+
+// --------------------------------------------------------
+// Forgets everything, for after something other than the
+// cache has changed the context's state
+// --------------------------------------------------------
+void SimpleStateCache::Invalidate()
+{
+	memset(stages, 0xFF, sizeof(stages));
+	memset(&inputLayout, 0xFF, sizeof(inputLayout));
+}
+
+// --------------------------------------------------------
+// Sets the shader for a stage (with no class instances)
+// --------------------------------------------------------
+void SimpleStateCache::SetShader(SimpleShaderStage stage, ID3D11DeviceChild* shader)
+{
+	if (!Changes(stages[stage].Shader != shader))
+		return;
+	stages[stage].Shader = shader;
+
+	switch (stage)
+	{
+	case SIMPLE_STAGE_VERTEX:	context->VSSetShader(static_cast<ID3D11VertexShader*>(shader), 0, 0); break;
+	case SIMPLE_STAGE_PIXEL:	context->PSSetShader(static_cast<ID3D11PixelShader*>(shader), 0, 0); break;
+	case SIMPLE_STAGE_DOMAIN:	context->DSSetShader(static_cast<ID3D11DomainShader*>(shader), 0, 0); break;
+	case SIMPLE_STAGE_HULL:		context->HSSetShader(static_cast<ID3D11HullShader*>(shader), 0, 0); break;
+	case SIMPLE_STAGE_GEOMETRY:	context->GSSetShader(static_cast<ID3D11GeometryShader*>(shader), 0, 0); break;
+	case SIMPLE_STAGE_COMPUTE:	context->CSSetShader(static_cast<ID3D11ComputeShader*>(shader), 0, 0); break;
+	}
+}
+
+// --------------------------------------------------------
+// Sets the input assembler's input layout
+// --------------------------------------------------------
+void SimpleStateCache::SetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	if (!Changes(this->inputLayout != inputLayout))
+		return;
+	this->inputLayout = inputLayout;
+
+	context->IASetInputLayout(inputLayout);
+}
+
+// --------------------------------------------------------
+// Binds a whole constant buffer to a slot.  Remembered as
+// a range of zero constants, which offset binds never use.
+// --------------------------------------------------------
+void SimpleStateCache::SetConstantBuffer(SimpleShaderStage stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+	StageState& s = stages[stage];
+	if (!Changes(s.ConstantBuffers[slot] != buffer || s.ConstantCounts[slot] != 0))
+		return;
+	s.ConstantBuffers[slot] = buffer;
+	s.FirstConstants[slot] = 0;
+	s.ConstantCounts[slot] = 0;
+
+	switch (stage)
+	{
+	case SIMPLE_STAGE_VERTEX:	context->VSSetConstantBuffers(slot, 1, &buffer); break;
+	case SIMPLE_STAGE_PIXEL:	context->PSSetConstantBuffers(slot, 1, &buffer); break;
+	case SIMPLE_STAGE_DOMAIN:	context->DSSetConstantBuffers(slot, 1, &buffer); break;
+	case SIMPLE_STAGE_HULL:		context->HSSetConstantBuffers(slot, 1, &buffer); break;
+	case SIMPLE_STAGE_GEOMETRY:	context->GSSetConstantBuffers(slot, 1, &buffer); break;
+	case SIMPLE_STAGE_COMPUTE:	context->CSSetConstantBuffers(slot, 1, &buffer); break;
+	}
+}
+
+// --------------------------------------------------------
+// Binds a range of a constant buffer to a slot.  The same
+// buffer at a different offset is still a change.
+// --------------------------------------------------------
+void SimpleStateCache::SetConstantBuffer(SimpleShaderStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int constantCount)
+{
+	if (!context1) return;
+
+	StageState& s = stages[stage];
+	if (!Changes(
+		s.ConstantBuffers[slot] != buffer ||
+		s.FirstConstants[slot] != firstConstant ||
+		s.ConstantCounts[slot] != constantCount))
+		return;
+	s.ConstantBuffers[slot] = buffer;
+	s.FirstConstants[slot] = firstConstant;
+	s.ConstantCounts[slot] = constantCount;
+
+	switch (stage)
+	{
+	case SIMPLE_STAGE_VERTEX:	context1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount); break;
+	case SIMPLE_STAGE_PIXEL:	context1->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount); break;
+	case SIMPLE_STAGE_DOMAIN:	context1->DSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount); break;
+	case SIMPLE_STAGE_HULL:		context1->HSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount); break;
+	case SIMPLE_STAGE_GEOMETRY:	context1->GSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount); break;
+	case SIMPLE_STAGE_COMPUTE:	context1->CSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount); break;
+	}
+}
+
+// --------------------------------------------------------
+// Binds a shader resource view to a slot
+// --------------------------------------------------------
+void SimpleStateCache::SetShaderResourceView(SimpleShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	if (!Changes(stages[stage].ShaderResourceViews[slot] != srv))
+		return;
+	stages[stage].ShaderResourceViews[slot] = srv;
+
+	switch (stage)
+	{
+	case SIMPLE_STAGE_VERTEX:	context->VSSetShaderResources(slot, 1, &srv); break;
+	case SIMPLE_STAGE_PIXEL:	context->PSSetShaderResources(slot, 1, &srv); break;
+	case SIMPLE_STAGE_DOMAIN:	context->DSSetShaderResources(slot, 1, &srv); break;
+	case SIMPLE_STAGE_HULL:		context->HSSetShaderResources(slot, 1, &srv); break;
+	case SIMPLE_STAGE_GEOMETRY:	context->GSSetShaderResources(slot, 1, &srv); break;
+	case SIMPLE_STAGE_COMPUTE:	context->CSSetShaderResources(slot, 1, &srv); break;
+	}
+}
+
+// --------------------------------------------------------
+// Binds a sampler state to a slot
+// --------------------------------------------------------
+void SimpleStateCache::SetSampler(SimpleShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	if (!Changes(stages[stage].Samplers[slot] != sampler))
+		return;
+	stages[stage].Samplers[slot] = sampler;
+
+	switch (stage)
+	{
+	case SIMPLE_STAGE_VERTEX:	context->VSSetSamplers(slot, 1, &sampler); break;
+	case SIMPLE_STAGE_PIXEL:	context->PSSetSamplers(slot, 1, &sampler); break;
+	case SIMPLE_STAGE_DOMAIN:	context->DSSetSamplers(slot, 1, &sampler); break;
+	case SIMPLE_STAGE_HULL:		context->HSSetSamplers(slot, 1, &sampler); break;
+	case SIMPLE_STAGE_GEOMETRY:	context->GSSetSamplers(slot, 1, &sampler); break;
+	case SIMPLE_STAGE_COMPUTE:	context->CSSetSamplers(slot, 1, &sampler); break;
+	}
+}
+
+// --------------------------------------------------------
+// Starts the issued and elided counts over
+// --------------------------------------------------------
+void SimpleStateCache::ResetStats()
+{
+	issuedCalls = 0;
+	elidedCalls = 0;
+}
+
+// --------------------------------------------------------
+// Counts a bind as issued or elided
+// --------------------------------------------------------
+bool SimpleStateCache::Changes(bool different)
+{
+	if (different) issuedCalls++;
+	else elidedCalls++;
+	return different;
+}
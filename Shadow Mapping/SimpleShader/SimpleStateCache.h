@@ -0,0 +1,86 @@
+#pragma once
+
+#include <d3d11.h>
+#include <d3d11_1.h>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// The programmable stages a shader can be bound to
+// --------------------------------------------------------
+enum SimpleShaderStage
+{
+	SIMPLE_STAGE_VERTEX,
+	SIMPLE_STAGE_PIXEL,
+	SIMPLE_STAGE_DOMAIN,
+	SIMPLE_STAGE_HULL,
+	SIMPLE_STAGE_GEOMETRY,
+	SIMPLE_STAGE_COMPUTE,
+	SIMPLE_STAGE_COUNT
+};
+
+// --------------------------------------------------------
+// Shadows the shader-related state of one device context
+// (shaders, input layout, constant buffers, SRVs and
+// samplers) and only calls into the context when a bind
+// would actually change something.  Shaders share one of
+// these per context - see ISimpleShader::SetStateCache().
+//
+// Only binds made through the cache are tracked, so call
+// Invalidate() after anything else touches that state:
+// drawing ImGui, binding a texture as a render target,
+// depth buffer or UAV (which unbinds its SRVs), or a direct call
+// on the context.  Once per frame is usually enough.
+//
+// Raw pointers are compared, not held - the context keeps
+// anything bound alive, so an address can't be reused
+// while the cache still thinks it's bound.
+// --------------------------------------------------------
+class SimpleStateCache
+{
+public:
+	SimpleStateCache(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~SimpleStateCache();
+
+	// Forgets what's bound, so the next bind of everything goes through
+	void Invalidate();
+
+	// Shader must match the stage (ID3D11VertexShader for VERTEX, etc.)
+	void SetShader(SimpleShaderStage stage, ID3D11DeviceChild* shader);
+	void SetInputLayout(ID3D11InputLayout* inputLayout);
+	void SetConstantBuffer(SimpleShaderStage stage, unsigned int slot, ID3D11Buffer* buffer);
+	// A range of a buffer, in 16 byte constants (needs Direct3D 11.1)
+	void SetConstantBuffer(SimpleShaderStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int constantCount);
+	void SetShaderResourceView(SimpleShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(SimpleShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler);
+
+	// Binds that reached the context, and ones dropped as redundant
+	unsigned int GetIssuedCalls() { return issuedCalls; }
+	unsigned int GetElidedCalls() { return elidedCalls; }
+	void ResetStats();
+
+private:
+	// What one stage has bound
+	struct StageState
+	{
+		ID3D11DeviceChild* Shader;
+		ID3D11Buffer* ConstantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		unsigned int FirstConstants[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		unsigned int ConstantCounts[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		ID3D11ShaderResourceView* ShaderResourceViews[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+		ID3D11SamplerState* Samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+
+	// Unknown state is all bits set, which no real pointer or range
+	// matches, so the first bind of anything always goes through
+	StageState stages[SIMPLE_STAGE_COUNT];
+	ID3D11InputLayout* inputLayout;
+
+	unsigned int issuedCalls;
+	unsigned int elidedCalls;
+
+	// Counts the call either way, returning true if it's needed
+	bool Changes(bool different);
+};
@@ -1,4 +1,5 @@
 #include "Sky.h"
+#include "ShaderLayouts.h"
 
 Sky::Sky(std::shared_ptr<Mesh> cubeMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState, 
   Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skySRV,
@@ -12,6 +13,10 @@ Sky::Sky(std::shared_ptr<Mesh> cubeMesh, Microsoft::WRL::ComPtr<ID3D11SamplerSta
 	skyPixelShader = skyPS;
 	skyVertexShader = skyVS;
 
+	perFrameHandle = skyVertexShader->GetBufferHandle("PerFrame");
+	cubeMapHandle = skyPixelShader->GetShaderResourceViewHandle("CubeMap");
+	samplerHandle = skyPixelShader->GetSamplerHandle("BasicSampler");
+
 	//creating rasterizer state
 	D3D11_RASTERIZER_DESC rasterizerDesc = {};
 	rasterizerDesc.FillMode = D3D11_FILL_SOLID;
@@ -27,17 +32,19 @@ Sky::Sky(std::shared_ptr<Mesh> cubeMesh, Microsoft::WRL::ComPtr<ID3D11SamplerSta
 
 Sky::~Sky() {}
 
-void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
+void Sky::Draw(ID3D11DeviceContext* context, Camera* camera)
 {
 	context->RSSetState(rasterizerState.Get());
 	context->OMSetDepthStencilState(stencilState.Get(), 0);
 
-	skyVertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
-	skyVertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+	ShaderLayouts::VertexShader_Sky_PerFrame perFrame;
+	perFrame.view = camera->GetViewMatrix();
+	perFrame.projection = camera->GetProjectionMatrix();
+	skyVertexShader->SetBufferData(perFrameHandle, &perFrame, sizeof(perFrame));
 	skyVertexShader->CopyAllBufferData();
 
-	skyPixelShader->SetShaderResourceView("CubeMap", textureSRV);
-	skyPixelShader->SetSamplerState("BasicSampler", sampler);
+	skyPixelShader->SetShaderResourceView(cubeMapHandle, textureSRV);
+	skyPixelShader->SetSamplerState(samplerHandle, sampler);
 	skyPixelShader->CopyAllBufferData();
 
 	skyVertexShader->SetShader();
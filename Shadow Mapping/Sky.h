@@ -17,7 +17,7 @@ public:
 	
 	~Sky();
 
-	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera);
+	void Draw(ID3D11DeviceContext* context, Camera* camera);
 
 
 private:
@@ -29,4 +29,8 @@ private:
 	std::shared_ptr<Mesh> skyMesh;
 	std::shared_ptr<SimplePixelShader> skyPixelShader;
 	std::shared_ptr<SimpleVertexShader> skyVertexShader;
+
+	SimpleBufferHandle perFrameHandle;
+	SimpleSRVHandle cubeMapHandle;
+	SimpleSamplerHandle samplerHandle;
 };
@@ -0,0 +1,118 @@
+// --------------------------------------------------------
+// InstancingBenchmark - times the CPU side of instanced
+// drawing the way Game::Draw() does it: keying a list of
+// draws, radix sorting it, then grouping the sorted draws
+// into instance batches while packing their matrices.
+//
+// Usage:
+//   InstancingBenchmark [entities] [meshes] [materials] [frames]
+//   (defaults: 100000 entities, 16 meshes, 32 materials, 100 frames)
+//
+// Meshes and materials are only compared by address, so
+// fake ones stand in for them and no device is needed.
+// Builds with the game's DrawSorting and InstanceBatcher:
+//   cl /std:c++17 /O2 /EHsc /I..\.. InstancingBenchmark.cpp ..\..\DrawSorting.cpp ..\..\InstanceBatcher.cpp
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "DrawSorting.h"
+#include "InstanceBatcher.h"
+
+using namespace DirectX;
+
+// Stand-ins for what each entity would have
+struct BenchmarkEntity
+{
+	unsigned int Mesh;
+	unsigned int Material;
+	unsigned int Lod;
+	float Distance;
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 WorldInvTranspose;
+};
+
+int main(int argc, char* argv[])
+{
+	unsigned int entityCount = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+	unsigned int meshCount = argc > 2 ? (unsigned int)atoi(argv[2]) : 16;
+	unsigned int materialCount = argc > 3 ? (unsigned int)atoi(argv[3]) : 32;
+	unsigned int frameCount = argc > 4 ? (unsigned int)atoi(argv[4]) : 100;
+	if (entityCount == 0 || meshCount == 0 || materialCount == 0 || frameCount == 0)
+	{
+		printf("Usage: InstancingBenchmark [entities] [meshes] [materials] [frames]\n");
+		return 1;
+	}
+
+	// Random scene, in no particular order
+	std::mt19937 random(1234);
+	std::vector<BenchmarkEntity> entities(entityCount);
+	for (auto& e : entities)
+	{
+		e.Mesh = random() % meshCount;
+		e.Material = random() % materialCount;
+		e.Distance = (float)(random() % 1000);
+		e.Lod = e.Distance < 100.0f ? 0 : e.Distance < 300.0f ? 1 : 2;
+		for (int i = 0; i < 16; i++)
+		{
+			e.World.m[i / 4][i % 4] = (float)(random() % 100);
+			e.WorldInvTranspose.m[i / 4][i % 4] = (float)(random() % 100);
+		}
+	}
+
+	// Any distinct addresses will do for meshes and materials
+	std::vector<char> fakeMeshes(meshCount);
+	std::vector<char> fakeMaterials(materialCount);
+
+	std::vector<DrawItem> drawItems;
+	std::vector<DrawItem> scratch;
+	InstanceBatcher batcher;
+
+	double keyMilliseconds = 0;
+	double sortMilliseconds = 0;
+	double batchMilliseconds = 0;
+
+	for (unsigned int frame = 0; frame < frameCount; frame++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		drawItems.clear();
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			const BenchmarkEntity& e = entities[i];
+			drawItems.push_back({ MakeDrawSortKey(DRAW_PASS_OPAQUE, 0, e.Material, e.Mesh, GetDepthBucket(e.Distance, 1000.0f)), i });
+		}
+		std::chrono::high_resolution_clock::time_point keyed = std::chrono::high_resolution_clock::now();
+
+		SortDrawItems(drawItems, scratch);
+		std::chrono::high_resolution_clock::time_point sorted = std::chrono::high_resolution_clock::now();
+
+		batcher.Begin();
+		for (const DrawItem& item : drawItems)
+		{
+			const BenchmarkEntity& e = entities[item.Index];
+			batcher.Add((Mesh*)&fakeMeshes[e.Mesh], (Material*)&fakeMaterials[e.Material], e.Lod, e.World, e.WorldInvTranspose);
+		}
+		std::chrono::high_resolution_clock::time_point batched = std::chrono::high_resolution_clock::now();
+
+		keyMilliseconds += std::chrono::duration<double, std::milli>(keyed - start).count();
+		sortMilliseconds += std::chrono::duration<double, std::milli>(sorted - keyed).count();
+		batchMilliseconds += std::chrono::duration<double, std::milli>(batched - sorted).count();
+	}
+
+	printf("%u entities, %u meshes, %u materials, %u frames\n", entityCount, meshCount, materialCount, frameCount);
+	printf("%zu batches, %zu instances (%zu bytes)\n",
+		batcher.GetBatches().size(),
+		batcher.GetInstances().size(),
+		batcher.GetInstances().size() * sizeof(InstanceData));
+	printf("Per frame: keys %.3f ms, sort %.3f ms, batch and pack %.3f ms, total %.3f ms\n",
+		keyMilliseconds / frameCount,
+		sortMilliseconds / frameCount,
+		batchMilliseconds / frameCount,
+		(keyMilliseconds + sortMilliseconds + batchMilliseconds) / frameCount);
+	return 0;
+}
@@ -0,0 +1,238 @@
+// --------------------------------------------------------
+// ObjLoadBenchmark - times the original getline/sscanf_s
+// OBJ loader against the memory-mapped single pass parser
+// (LoadObjFile) on every .obj file in a folder, checks that
+// both produce the same triangles, and shows how many face
+// corners the parser welds down to unique vertices and what
+// the index optimization Mesh runs does to the simulated
+// post-transform cache (ACMR / ATVR, see MeshOptimizer.h).
+//
+// Usage:
+//   ObjLoadBenchmark [models folder] [runs]
+//   (defaults: ..\..\Assets\Models, 20 runs)
+//
+// Both are timed from the file to a vertex list - for the
+// parser that includes welding (BuildObjVertices).  Each
+// loader's best and average time over the runs is reported
+// per file, after one untimed run of each so both read from
+// the file cache.  Builds with the game's parser and optimizer:
+//   cl /std:c++17 /O2 /EHsc /I..\.. ObjLoadBenchmark.cpp ..\..\ObjParser.cpp ..\..\MappedFile.cpp ..\..\MeshOptimizer.cpp
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
+
+#ifndef _MSC_VER
+#define sscanf_s sscanf
+#endif
+
+// --------------------------------------------------------
+// The loader Mesh used before ParseObj, minus the buffer
+// creation: one vertex per face corner, in triangle order
+// --------------------------------------------------------
+static bool LoadObjGetline(const std::filesystem::path& filename, std::vector<Vertex>& verts)
+{
+	std::ifstream obj(filename);
+	if (!obj.is_open())
+		return false;
+
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	char chars[100];
+
+	while (obj.good())
+	{
+		obj.getline(chars, 100);
+
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			DirectX::XMFLOAT3 norm;
+			sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			DirectX::XMFLOAT2 uv;
+			sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+			uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			DirectX::XMFLOAT3 pos;
+			sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			unsigned int i[12];
+			int numbersRead = sscanf_s(
+				chars,
+				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2],
+				&i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8],
+				&i[9], &i[10], &i[11]);
+
+			if (numbersRead == 1)
+			{
+				numbersRead = sscanf_s(
+					chars,
+					"f %d//%d %d//%d %d//%d %d//%d",
+					&i[0], &i[2],
+					&i[3], &i[5],
+					&i[6], &i[8],
+					&i[9], &i[11]);
+
+				i[1] = 1;
+				i[4] = 1;
+				i[7] = 1;
+				i[10] = 1;
+
+				if (uvs.size() == 0)
+					uvs.push_back(DirectX::XMFLOAT2(0, 0));
+			}
+
+			// Flip the UV, Z pos and normal's Z for a left-handed space
+			Vertex v[4] = {};
+			int cornerCount = (numbersRead == 12 || numbersRead == 8) ? 4 : 3;
+			for (int c = 0; c < cornerCount; c++)
+			{
+				v[c].Position = positions[i[c * 3] - 1];
+				v[c].UV = uvs[i[c * 3 + 1] - 1];
+				v[c].Normal = normals[i[c * 3 + 2] - 1];
+				v[c].UV.y = 1.0f - v[c].UV.y;
+				v[c].Position.z *= -1.0f;
+				v[c].Normal.z *= -1.0f;
+			}
+
+			// Flipping the winding order too
+			verts.push_back(v[0]);
+			verts.push_back(v[2]);
+			verts.push_back(v[1]);
+			if (cornerCount == 4)
+			{
+				verts.push_back(v[0]);
+				verts.push_back(v[3]);
+				verts.push_back(v[2]);
+			}
+		}
+	}
+
+	return true;
+}
+
+// Whether the indexed triangles are exactly the old loader's vertices
+static bool SameTriangles(const std::vector<Vertex>& oldVerts, const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices)
+{
+	if (oldVerts.size() != indices.size())
+		return false;
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		const Vertex& v = oldVerts[i];
+		if (memcmp(&v.Position, &verts[indices[i]].Position, sizeof(v.Position)) != 0 ||
+			memcmp(&v.Normal, &verts[indices[i]].Normal, sizeof(v.Normal)) != 0 ||
+			memcmp(&v.UV, &verts[indices[i]].UV, sizeof(v.UV)) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+// Best and total time of some number of runs
+struct Timing
+{
+	double Best = 1e30;
+	double Total = 0;
+
+	void Add(std::chrono::high_resolution_clock::time_point start)
+	{
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		Best = ms < Best ? ms : Best;
+		Total += ms;
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	std::filesystem::path folder = argc > 1 ? argv[1] : "../../Assets/Models";
+	unsigned int runCount = argc > 2 ? (unsigned int)atoi(argv[2]) : 20;
+	if (runCount == 0 || !std::filesystem::is_directory(folder))
+	{
+		printf("Usage: ObjLoadBenchmark [models folder] [runs]\n");
+		return 1;
+	}
+
+	printf("%-24s %10s %10s %10s %12s %12s %12s %12s %8s %14s %14s\n", "File", "Triangles", "Corners", "Welded", "getline best", "getline avg", "parser best", "parser avg", "Speedup", "ACMR", "ATVR");
+
+	int failures = 0;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(folder))
+	{
+		const std::filesystem::path& path = entry.path();
+		if (path.extension() != ".obj")
+			continue;
+
+		// Untimed first runs warm the file cache and check the output
+		std::vector<Vertex> oldVerts;
+		ObjData obj;
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!LoadObjGetline(path, oldVerts) || !LoadObjFile(path.wstring().c_str(), obj))
+		{
+			printf("%-24s couldn't be loaded\n", path.filename().string().c_str());
+			failures++;
+			continue;
+		}
+		BuildObjVertices(obj, verts, indices);
+		if (!SameTriangles(oldVerts, verts, indices))
+		{
+			printf("%-24s MISMATCH between the loaders\n", path.filename().string().c_str());
+			failures++;
+			continue;
+		}
+
+		Timing oldTiming;
+		Timing newTiming;
+		for (unsigned int run = 0; run < runCount; run++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			std::vector<Vertex> runVerts;
+			LoadObjGetline(path, runVerts);
+			oldTiming.Add(start);
+
+			start = std::chrono::high_resolution_clock::now();
+			ObjData runObj;
+			LoadObjFile(path.wstring().c_str(), runObj);
+			BuildObjVertices(runObj, verts, indices);
+			newTiming.Add(start);
+		}
+
+		// Same passes Mesh runs with OptimizeIndices on (overdraw off)
+		VertexCacheStats before = AnalyzeVertexCache(indices.data(), indices.size(), verts.size());
+		OptimizeVertexCache(indices.data(), indices.size(), verts.size());
+		OptimizeVertexFetch(verts, indices);
+		VertexCacheStats after = AnalyzeVertexCache(indices.data(), indices.size(), verts.size());
+
+		printf("%-24s %10zu %10zu %10zu %9.3f ms %9.3f ms %9.3f ms %9.3f ms %7.1fx %6.3f->%6.3f %6.3f->%6.3f\n",
+			path.filename().string().c_str(),
+			obj.Corners.size() / 3,
+			obj.Corners.size(),
+			verts.size(),
+			oldTiming.Best, oldTiming.Total / runCount,
+			newTiming.Best, newTiming.Total / runCount,
+			oldTiming.Best / newTiming.Best,
+			before.ACMR, after.ACMR,
+			before.ATVR, after.ATVR);
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+// --------------------------------------------------------
+// ObjParseBenchmark - times ParseObj on a large synthetic
+// OBJ with 1 thread up to N, to show how the threaded path
+// scales, and checks every thread count gives exactly the
+// same result as parsing serially.
+//
+// Usage:
+//   ObjParseBenchmark [triangles] [max threads] [runs]
+//   (defaults: 10000000 triangles, all cores, 5 runs)
+//
+// The OBJ is a grid of quads with positions, uvs and normals,
+// written the way exporters usually write it, and is built
+// in memory so disk speed doesn't come into it.  Builds with
+// the game's parser:
+//   cl /std:c++17 /O2 /EHsc /I..\.. ObjParseBenchmark.cpp ..\..\ObjParser.cpp ..\..\MappedFile.cpp
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "ObjParser.h"
+
+// --------------------------------------------------------
+// A square grid of at least the given number of triangles,
+// as OBJ text: every vertex has a position, uv and normal,
+// and every quad is one "f" line
+// --------------------------------------------------------
+static std::string MakeGridObj(size_t triangleCount)
+{
+	size_t quadsPerSide = (size_t)ceil(sqrt((double)(triangleCount + 1) / 2.0));
+	size_t vertsPerSide = quadsPerSide + 1;
+
+	std::string text;
+	text.reserve(vertsPerSide * vertsPerSide * 100 + quadsPerSide * quadsPerSide * 80);
+
+	char line[256];
+	text += "# Synthetic grid for ObjParseBenchmark\n";
+	for (size_t z = 0; z < vertsPerSide; z++)
+	{
+		for (size_t x = 0; x < vertsPerSide; x++)
+		{
+			float u = (float)x / quadsPerSide;
+			float v = (float)z / quadsPerSide;
+			int length = snprintf(line, sizeof(line),
+				"v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+				u * 100.0f, sinf(u * 20.0f) * cosf(v * 20.0f), v * 100.0f,
+				u, v,
+				0.0f, 1.0f, 0.0f);
+			text.append(line, length);
+		}
+	}
+
+	for (size_t z = 0; z < quadsPerSide; z++)
+	{
+		for (size_t x = 0; x < quadsPerSide; x++)
+		{
+			// OBJ indices are 1-based
+			size_t a = z * vertsPerSide + x + 1;
+			size_t b = a + 1;
+			size_t c = a + vertsPerSide + 1;
+			size_t d = a + vertsPerSide;
+			int length = snprintf(line, sizeof(line), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+				a, a, a, b, b, b, c, c, c, d, d, d);
+			text.append(line, length);
+		}
+	}
+
+	return text;
+}
+
+// Whether two parses produced exactly the same data
+static bool SameObj(const ObjData& a, const ObjData& b)
+{
+	return a.Positions.size() == b.Positions.size() &&
+		a.Normals.size() == b.Normals.size() &&
+		a.UVs.size() == b.UVs.size() &&
+		a.Corners.size() == b.Corners.size() &&
+		memcmp(a.Positions.data(), b.Positions.data(), a.Positions.size() * sizeof(a.Positions[0])) == 0 &&
+		memcmp(a.Normals.data(), b.Normals.data(), a.Normals.size() * sizeof(a.Normals[0])) == 0 &&
+		memcmp(a.UVs.data(), b.UVs.data(), a.UVs.size() * sizeof(a.UVs[0])) == 0 &&
+		memcmp(a.Corners.data(), b.Corners.data(), a.Corners.size() * sizeof(a.Corners[0])) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t triangleCount = argc > 1 ? (size_t)atoll(argv[1]) : 10000000;
+	unsigned int maxThreads = argc > 2 ? (unsigned int)atoi(argv[2]) : std::thread::hardware_concurrency();
+	unsigned int runCount = argc > 3 ? (unsigned int)atoi(argv[3]) : 5;
+	if (triangleCount == 0 || maxThreads == 0 || runCount == 0)
+	{
+		printf("Usage: ObjParseBenchmark [triangles] [max threads] [runs]\n");
+		return 1;
+	}
+
+	printf("Building a %zu triangle OBJ...\n", triangleCount);
+	std::string text = MakeGridObj(triangleCount);
+
+	// Serial parse is the reference every other thread count must match
+	ObjData reference;
+	if (!ParseObj(text.data(), text.size(), reference, 1))
+	{
+		printf("Parse failed\n");
+		return 1;
+	}
+	printf("%.1f MB, %zu positions, %zu triangles\n\n", text.size() / (1024.0 * 1024.0), reference.Positions.size(), reference.Corners.size() / 3);
+
+	printf("%8s %12s %12s %10s %8s\n", "Threads", "Best", "Average", "MB/s", "Speedup");
+
+	double serialBest = 0;
+	int failures = 0;
+	ObjData obj;
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		double best = 1e30;
+		double total = 0;
+		for (unsigned int run = 0; run < runCount; run++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			ParseObj(text.data(), text.size(), obj, threads);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			best = ms < best ? ms : best;
+			total += ms;
+		}
+
+		if (threads == 1)
+			serialBest = best;
+
+		bool same = SameObj(obj, reference);
+		failures += same ? 0 : 1;
+
+		printf("%8u %9.1f ms %9.1f ms %10.0f %7.2fx%s\n",
+			threads, best, total / runCount,
+			text.size() / (1024.0 * 1024.0) / (best / 1000.0),
+			serialBest / best,
+			same ? "" : "  MISMATCH with the serial parse");
+	}
+
+	return failures > 0 ? 1 : 0;
+}
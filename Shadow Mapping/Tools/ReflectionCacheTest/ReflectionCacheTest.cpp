@@ -0,0 +1,264 @@
+// --------------------------------------------------------
+// ReflectionCacheTest - checks SimpleShader's reflection
+// cache format: that a reflection survives being written
+// and read back, and that every kind of bad blob (other
+// bytecode, other version, cut short, damaged, extra bytes
+// on the end, absurd counts) is turned away.
+//
+// Usage:
+//   ReflectionCacheTest
+//
+// Damaged blobs are checked twice where it matters - once
+// as they are, and once with the hash at the end redone so
+// the check behind the hash gets tested too.  No device is
+// needed.  Builds with the game's cache code:
+//   cl /std:c++17 /O2 /EHsc /I..\.. ReflectionCacheTest.cpp ..\..\SimpleShader\SimpleReflectionCache.cpp
+// --------------------------------------------------------
+
+#include <cstdio>
+#include <vector>
+
+#include "SimpleShader/SimpleReflectionCache.h"
+#include "../TestCheck.h"
+
+// Where the header's values sit in a blob
+static const size_t VersionOffset = 4;
+static const size_t FirstCountOffset = 16;
+
+// Something like the game's vertex shader, touching every field
+static SimpleShaderReflection MakeReflection()
+{
+	SimpleShaderReflection reflection;
+
+	SimpleReflectedBuffer perFrame;
+	perFrame.Name = "PerFrame";
+	perFrame.Type = 0;
+	perFrame.BindIndex = 0;
+	perFrame.Size = 400;
+	perFrame.Variables.push_back({ "view", 0, 64 });
+	perFrame.Variables.push_back({ "projection", 64, 64 });
+	perFrame.Variables.push_back({ "shadowViewProjection", 128, 256 });
+	perFrame.Variables.push_back({ "shadowMapCount", 384, 4 });
+	reflection.ConstantBuffers.push_back(perFrame);
+
+	SimpleReflectedBuffer perObject;
+	perObject.Name = "PerObject";
+	perObject.Type = 0;
+	perObject.BindIndex = 2;
+	perObject.Size = 128;
+	perObject.Variables.push_back({ "world", 0, 64 });
+	perObject.Variables.push_back({ "worldInvTranspose", 64, 64 });
+	reflection.ConstantBuffers.push_back(perObject);
+
+	SimpleReflectedBuffer empty;
+	empty.Name = "";
+	empty.Type = 1;
+	empty.BindIndex = 7;
+	empty.Size = 16;
+	reflection.ConstantBuffers.push_back(empty);
+
+	reflection.ShaderResourceViews.push_back({ "AlbedoMap", 0 });
+	reflection.ShaderResourceViews.push_back({ "ShadowMaps", 4 });
+	reflection.Samplers.push_back({ "BasicSampler", 0 });
+	reflection.Samplers.push_back({ "ShadowSampler", 1 });
+	reflection.UnorderedAccessViews.push_back({ "Particles", 0 });
+	reflection.UnorderedAccessViews.push_back({ "DeadList", 3 });
+
+	reflection.InputElements.push_back({ "POSITION", 0, 6, false });
+	reflection.InputElements.push_back({ "TEXCOORD", 0, 16, false });
+	reflection.InputElements.push_back({ "WORLD", 3, 2, true });
+	return reflection;
+}
+
+static bool SameResources(const std::vector<SimpleReflectedResource>& a, const std::vector<SimpleReflectedResource>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].Name != b[i].Name || a[i].BindIndex != b[i].BindIndex)
+			return false;
+	}
+	return true;
+}
+
+static bool SameReflection(const SimpleShaderReflection& a, const SimpleShaderReflection& b)
+{
+	if (a.ConstantBuffers.size() != b.ConstantBuffers.size() ||
+		a.InputElements.size() != b.InputElements.size() ||
+		!SameResources(a.ShaderResourceViews, b.ShaderResourceViews) ||
+		!SameResources(a.Samplers, b.Samplers) ||
+		!SameResources(a.UnorderedAccessViews, b.UnorderedAccessViews))
+		return false;
+
+	for (size_t i = 0; i < a.ConstantBuffers.size(); i++)
+	{
+		const SimpleReflectedBuffer& x = a.ConstantBuffers[i];
+		const SimpleReflectedBuffer& y = b.ConstantBuffers[i];
+		if (x.Name != y.Name || x.Type != y.Type || x.BindIndex != y.BindIndex || x.Size != y.Size || x.Variables.size() != y.Variables.size())
+			return false;
+
+		for (size_t v = 0; v < x.Variables.size(); v++)
+		{
+			if (x.Variables[v].Name != y.Variables[v].Name ||
+				x.Variables[v].ByteOffset != y.Variables[v].ByteOffset ||
+				x.Variables[v].Size != y.Variables[v].Size)
+				return false;
+		}
+	}
+
+	for (size_t i = 0; i < a.InputElements.size(); i++)
+	{
+		const SimpleReflectedInputElement& x = a.InputElements[i];
+		const SimpleReflectedInputElement& y = b.InputElements[i];
+		if (x.SemanticName != y.SemanticName || x.SemanticIndex != y.SemanticIndex || x.Format != y.Format || x.PerInstance != y.PerInstance)
+			return false;
+	}
+
+	return true;
+}
+
+// Little-endian, like the format
+static void PutUInt(std::vector<unsigned char>& blob, size_t offset, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+		blob[offset + i] = (unsigned char)(value >> (i * 8));
+}
+
+// Redoes the hash at the end, so a change gets past the damage check
+static void Rehash(std::vector<unsigned char>& blob)
+{
+	unsigned long long hash = SimpleHashBytes(blob.data(), blob.size() - 8);
+	for (int i = 0; i < 8; i++)
+		blob[blob.size() - 8 + i] = (unsigned char)(hash >> (i * 8));
+}
+
+// Whether a blob is turned away, and leaves the reflection empty
+static bool Rejected(const std::vector<unsigned char>& blob, unsigned long long bytecodeHash)
+{
+	SimpleShaderReflection reflection = MakeReflection();
+	bool loaded = DeserializeShaderReflection(blob.data(), blob.size(), bytecodeHash, reflection);
+	return !loaded && SameReflection(reflection, SimpleShaderReflection());
+}
+
+int main()
+{
+	const unsigned long long bytecodeHash = 0x0123456789abcdefull;
+	SimpleShaderReflection source = MakeReflection();
+
+	std::vector<unsigned char> blob;
+	SerializeShaderReflection(source, bytecodeHash, blob);
+
+	// Round trip, and writing it again gives the same bytes
+	{
+		SimpleShaderReflection loaded;
+		bool ok = DeserializeShaderReflection(blob.data(), blob.size(), bytecodeHash, loaded);
+		Check(ok && SameReflection(source, loaded), "round trip gives back the same reflection");
+
+		std::vector<unsigned char> again;
+		SerializeShaderReflection(loaded, bytecodeHash, again);
+		Check(again == blob, "writing it back out gives the same bytes");
+
+		std::vector<unsigned char> emptyBlob;
+		SerializeShaderReflection(SimpleShaderReflection(), bytecodeHash, emptyBlob);
+		SimpleShaderReflection emptyLoaded = MakeReflection();
+		ok = DeserializeShaderReflection(emptyBlob.data(), emptyBlob.size(), bytecodeHash, emptyLoaded);
+		Check(ok && SameReflection(emptyLoaded, SimpleShaderReflection()), "round trip of an empty reflection");
+	}
+
+	// Made from other bytecode
+	Check(Rejected(blob, bytecodeHash + 1), "wrong bytecode hash is rejected");
+
+	// Another version of the format
+	{
+		std::vector<unsigned char> changed = blob;
+		PutUInt(changed, VersionOffset, 1);	// Before UAVs were saved
+		Check(Rejected(changed, bytecodeHash), "wrong version is rejected");
+		Rehash(changed);
+		Check(Rejected(changed, bytecodeHash), "wrong version with a good hash is rejected");
+	}
+
+	// Cut short, at every length
+	{
+		bool allRejected = true;
+		bool allRejectedRehashed = true;
+		for (size_t size = 0; size < blob.size(); size++)
+		{
+			std::vector<unsigned char> truncated(blob.begin(), blob.begin() + size);
+			allRejected = allRejected && Rejected(truncated, bytecodeHash);
+
+			// Keep the real hash on the end of what's left
+			if (size >= 8)
+			{
+				Rehash(truncated);
+				allRejectedRehashed = allRejectedRehashed && Rejected(truncated, bytecodeHash);
+			}
+		}
+		Check(allRejected, "truncated blobs are rejected");
+		Check(allRejectedRehashed, "truncated blobs with a good hash are rejected");
+		SimpleShaderReflection nothing = MakeReflection();
+		Check(!DeserializeShaderReflection(0, 0, bytecodeHash, nothing) && nothing.ConstantBuffers.empty(), "no data is rejected");
+	}
+
+	// Every single bit flipped, one at a time
+	{
+		bool allRejected = true;
+		for (size_t i = 0; i < blob.size(); i++)
+		{
+			for (int bit = 0; bit < 8; bit++)
+			{
+				std::vector<unsigned char> damaged = blob;
+				damaged[i] ^= (unsigned char)(1 << bit);
+				allRejected = allRejected && Rejected(damaged, bytecodeHash);
+			}
+		}
+		Check(allRejected, "flipped bits are rejected");
+	}
+
+	// Extra bytes after the real data
+	{
+		std::vector<unsigned char> longer = blob;
+		longer.push_back(0);
+		Check(Rejected(longer, bytecodeHash), "trailing byte is rejected");
+
+		// Slipped in before the hash, which is then redone
+		longer = blob;
+		longer.insert(longer.end() - 8, 4, (unsigned char)0);
+		Rehash(longer);
+		Check(Rejected(longer, bytecodeHash), "trailing bytes with a good hash are rejected");
+	}
+
+	// Counts past MaxReflectedCount (4096) mustn't be trusted
+	// with an allocation, even with the hash redone
+	{
+		std::vector<unsigned char> empty;
+		SerializeShaderReflection(SimpleShaderReflection(), bytecodeHash, empty);
+
+		std::vector<unsigned char> huge = empty;
+		PutUInt(huge, FirstCountOffset, 0xffffffffu);
+		Rehash(huge);
+		Check(Rejected(huge, bytecodeHash), "huge buffer count is rejected");
+
+		std::vector<unsigned char> justOver = empty;
+		PutUInt(justOver, FirstCountOffset, 4097);
+		Rehash(justOver);
+		Check(Rejected(justOver, bytecodeHash), "buffer count of 4097 is rejected");
+
+		// The last count in the blob is the input elements'
+		std::vector<unsigned char> lastCount = empty;
+		PutUInt(lastCount, lastCount.size() - 12, 0x80000000u);
+		Rehash(lastCount);
+		Check(Rejected(lastCount, bytecodeHash), "huge input element count is rejected");
+	}
+
+	// A variable that runs past the end of its buffer
+	{
+		SimpleShaderReflection outside = MakeReflection();
+		outside.ConstantBuffers[1].Variables[1].ByteOffset = 100;
+		std::vector<unsigned char> outsideBlob;
+		SerializeShaderReflection(outside, bytecodeHash, outsideBlob);
+		Check(Rejected(outsideBlob, bytecodeHash), "variable outside its buffer is rejected");
+	}
+
+	return TestResult();
+}
@@ -0,0 +1,269 @@
+// --------------------------------------------------------
+// RingAllocatorTest - checks SimpleRingAllocator's book-
+// keeping: that ranges are aligned, that the space skipped
+// when wrapping counts as used until its frame retires,
+// that frames retire oldest first, that EndFrame() refuses
+// past MaxFramesInFlight, that an empty ring starts over
+// from 0, and that no two live ranges ever overlap.
+//
+// Usage:
+//   RingAllocatorTest [frames]
+//   (default: 100000 frames of random allocations)
+//
+// No device is needed.  Builds with the game's allocator:
+//   cl /std:c++17 /O2 /EHsc /I..\.. RingAllocatorTest.cpp ..\..\SimpleShader\SimpleRingAllocator.cpp
+// --------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "SimpleShader/SimpleRingAllocator.h"
+#include "../TestCheck.h"
+
+static const unsigned int Invalid = SimpleRingAllocator::InvalidOffset;
+
+// --------------------------------------------------------
+// Every range starts on the alignment and is rounded up to
+// it, and sizes that can never fit are turned away
+// --------------------------------------------------------
+static void TestAlignment()
+{
+	SimpleRingAllocator ring(1000);
+	Check(ring.GetAlignment() == 256 && ring.GetCapacity() == 768, "capacity is rounded down to the 256 byte alignment");
+
+	unsigned int a = ring.Allocate(1);
+	unsigned int b = ring.Allocate(257);
+	Check(a == 0 && b == 256 && ring.GetUsedBytes() == 768, "sizes are rounded up to whole 256 byte steps");
+	Check(ring.Allocate(1) == Invalid, "a full ring turns allocations away");
+
+	SimpleRingAllocator empty(4096);
+	Check(empty.Allocate(0) == Invalid && empty.Allocate(4097) == Invalid && empty.GetUsedBytes() == 0, "empty and oversized allocations are turned away");
+	Check(empty.Allocate(4096) == 0, "an allocation the size of the whole ring fits");
+}
+
+// --------------------------------------------------------
+// A range that doesn't fit before the end comes from the
+// start, and the skipped end stays used until the frame
+// that skipped it retires
+// --------------------------------------------------------
+static void TestWrapSkip()
+{
+	SimpleRingAllocator ring(1024);
+
+	unsigned int first = ring.Allocate(512);
+	ring.EndFrame();
+	unsigned int second = ring.Allocate(256);
+	ring.EndFrame();
+	ring.RetireFrame();
+	Check(first == 0 && second == 512 && ring.GetUsedBytes() == 256, "retiring the first frame frees its range");
+
+	// Only 256 bytes are left before the end, so this wraps
+	unsigned int wrapped = ring.Allocate(512);
+	Check(wrapped == 0, "a range that doesn't fit before the end wraps to 0");
+	Check(ring.GetUsedBytes() == 1024, "the skipped end counts as used");
+	Check(ring.Allocate(256) == Invalid, "the skipped end isn't handed out");
+	ring.EndFrame();
+
+	// The second frame's range comes back, the skipped end doesn't
+	ring.RetireFrame();
+	Check(ring.GetUsedBytes() == 768, "the skipped end stays used while the wrapping frame is in flight");
+	Check(ring.Allocate(256) == 512, "the retired range is reused");
+
+	ring.RetireFrame();
+	Check(ring.GetUsedBytes() == 256, "retiring the wrapping frame frees the skipped end");
+}
+
+// --------------------------------------------------------
+// Only MaxFramesInFlight frames can wait at once, and a
+// refused EndFrame() leaves the allocations in the open one
+// --------------------------------------------------------
+static void TestFrameLimit()
+{
+	SimpleRingAllocator ring(65536);
+
+	bool allClosed = true;
+	for (unsigned int f = 0; f < SimpleRingAllocator::MaxFramesInFlight; f++)
+	{
+		ring.Allocate(256);
+		allClosed = allClosed && ring.EndFrame();
+	}
+	Check(allClosed && ring.GetFramesInFlight() == SimpleRingAllocator::MaxFramesInFlight, "MaxFramesInFlight frames can be closed");
+
+	ring.Allocate(256);
+	Check(!ring.EndFrame() && ring.GetFramesInFlight() == SimpleRingAllocator::MaxFramesInFlight, "EndFrame refuses past MaxFramesInFlight");
+
+	// The refused frame's 256 bytes are still open, so retiring
+	// everything in flight leaves just them
+	ring.RetireFrame();
+	Check(ring.EndFrame(), "EndFrame works again once a frame retires");
+	for (unsigned int f = 0; f < SimpleRingAllocator::MaxFramesInFlight; f++)
+		ring.RetireFrame();
+	Check(ring.GetFramesInFlight() == 0 && ring.GetUsedBytes() == 0, "the refused frame's allocations retire with the next frame closed");
+
+	ring.RetireFrame();
+	Check(ring.GetFramesInFlight() == 0 && ring.GetUsedBytes() == 0, "retiring with nothing in flight does nothing");
+}
+
+// --------------------------------------------------------
+// Frames free their space oldest first, each exactly what
+// was allocated while it was open
+// --------------------------------------------------------
+static void TestRetireOrder()
+{
+	SimpleRingAllocator ring(65536);
+	const unsigned int sizes[] = { 1024, 256, 4096, 512, 2048 };
+
+	unsigned int total = 0;
+	for (unsigned int size : sizes)
+	{
+		ring.Allocate(size);
+		ring.EndFrame();
+		total += size;
+	}
+
+	bool inOrder = true;
+	for (unsigned int size : sizes)
+	{
+		ring.RetireFrame();
+		total -= size;
+		inOrder = inOrder && ring.GetUsedBytes() == total;
+	}
+	Check(inOrder, "frames retire oldest first, freeing just their own ranges");
+}
+
+// --------------------------------------------------------
+// With nothing in use, allocation starts over from 0, even
+// with empty frames still waiting to retire
+// --------------------------------------------------------
+static void TestResetOnEmpty()
+{
+	SimpleRingAllocator ring(4096);
+	ring.Allocate(1024);
+	ring.EndFrame();
+	ring.RetireFrame();
+	Check(ring.Allocate(512) == 0, "an empty ring starts over from 0");
+
+	// Empty frames in flight move back to the start with it
+	ring.EndFrame();
+	ring.RetireFrame();
+	ring.EndFrame();
+	ring.EndFrame();
+	unsigned int restarted = ring.Allocate(256);
+	ring.RetireFrame();
+	ring.RetireFrame();
+	Check(restarted == 0 && ring.GetUsedBytes() == 256 && ring.Allocate(256) == 256, "empty frames in flight don't free the restarted range");
+
+	ring.Reset();
+	Check(ring.GetUsedBytes() == 0 && ring.GetFramesInFlight() == 0 && ring.Allocate(4096) == 0, "Reset forgets every allocation and frame");
+}
+
+// --------------------------------------------------------
+// Random sizes and frames retiring a random number of
+// frames late: every range handed out must be aligned,
+// inside the ring, and clear of every range still live
+// --------------------------------------------------------
+static void TestNoOverlap(unsigned int frameCount)
+{
+	struct Range { unsigned int Offset; unsigned int Size; };
+
+	SimpleRingAllocator ring(64 * 1024);
+	std::mt19937 random(1234);
+	std::deque<std::vector<Range>> inFlight;
+	std::vector<Range> open;
+
+	bool aligned = true;
+	bool inside = true;
+	bool apart = true;
+	bool usedCovers = true;
+	unsigned int wraps = 0;
+	unsigned int turnedAway = 0;
+	unsigned int lastOffset = 0;
+	for (unsigned int frame = 0; frame < frameCount && aligned && inside && apart && usedCovers; frame++)
+	{
+		unsigned int drawCount = random() % 24;
+		for (unsigned int d = 0; d < drawCount; d++)
+		{
+			unsigned int size = 1 + random() % 4096;
+			bool inUse = ring.GetUsedBytes() > 0;
+			unsigned int offset = ring.Allocate(size);
+			if (offset == Invalid)
+			{
+				turnedAway++;
+				continue;
+			}
+
+			// Back at the start with ranges still live is a wrap
+			wraps += inUse && offset < lastOffset ? 1 : 0;
+			lastOffset = offset;
+
+			unsigned int alignedSize = (size + 255) & ~255u;
+			aligned = aligned && offset % 256 == 0;
+			inside = inside && offset + alignedSize <= ring.GetCapacity();
+
+			auto clear = [&](const std::vector<Range>& ranges)
+			{
+				for (const Range& r : ranges)
+				{
+					if (offset < r.Offset + r.Size && r.Offset < offset + alignedSize)
+						return false;
+				}
+				return true;
+			};
+			apart = apart && clear(open);
+			for (const std::vector<Range>& ranges : inFlight)
+				apart = apart && clear(ranges);
+
+			open.push_back({ offset, alignedSize });
+		}
+
+		// The used bytes must at least cover every live range
+		unsigned long long live = 0;
+		for (const Range& r : open)
+			live += r.Size;
+		for (const std::vector<Range>& ranges : inFlight)
+			for (const Range& r : ranges)
+				live += r.Size;
+		usedCovers = usedCovers && ring.GetUsedBytes() >= live && ring.GetUsedBytes() <= ring.GetCapacity();
+
+		// The GPU is a random number of frames behind
+		if (ring.EndFrame())
+		{
+			inFlight.push_back(open);
+			open.clear();
+		}
+		unsigned int lag = random() % (SimpleRingAllocator::MaxFramesInFlight + 1);
+		while (inFlight.size() > lag)
+		{
+			ring.RetireFrame();
+			inFlight.pop_front();
+		}
+	}
+
+	Check(aligned, "random ranges are all aligned");
+	Check(inside, "random ranges all fit inside the ring");
+	Check(apart, "no two live ranges overlap");
+	Check(usedCovers, "the used bytes cover every live range");
+	Check(wraps > 0 && turnedAway > 0, "the random frames both fill the ring and wrap it");
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int frameCount = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+	if (frameCount == 0)
+	{
+		printf("Usage: RingAllocatorTest [frames]\n");
+		return 1;
+	}
+
+	TestAlignment();
+	TestWrapSkip();
+	TestFrameLimit();
+	TestRetireOrder();
+	TestResetOnEmpty();
+	TestNoOverlap(frameCount);
+
+	return TestResult();
+}
@@ -0,0 +1,209 @@
+// --------------------------------------------------------
+// ShaderHandleBenchmark - times the per draw SimpleShader
+// calls Game::Draw() makes (world matrices, color tint,
+// textures and sampler) set by name against the same calls
+// through handles looked up once up front, and checks both
+// leave exactly the same bytes in the shaders' buffers.
+//
+// Usage:
+//   ShaderHandleBenchmark [draws] [frames] [shader folder]
+//   (defaults: 100000 draws, 20 frames, the current folder)
+//
+// The game's compiled VertexShader.cso and PixelShader.cso
+// are loaded from the shader folder.  Each path is timed
+// just setting values, and again with the per draw buffer
+// uploads, through a state cache like the game's so that
+// repeated binds don't reach the driver.  Nothing is drawn,
+// so a WARP device stands in when there's no hardware one.
+// Builds with the game's SimpleShader:
+//   cl /std:c++17 /O2 /EHsc /I..\.. ShaderHandleBenchmark.cpp ..\..\SimpleShader\SimpleShader.cpp ..\..\SimpleShader\SimpleReflectionCache.cpp ..\..\SimpleShader\SimpleRingAllocator.cpp ..\..\SimpleShader\SimpleStateCache.cpp d3d11.lib
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "SimpleShader/SimpleShader.h"
+#include "SimpleShader/SimpleStateCache.h"
+
+using namespace DirectX;
+
+// What one draw sets, made up front so only the calls are timed
+struct BenchmarkDraw
+{
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 WorldInvTranspose;
+	XMFLOAT3 ColorTint;
+};
+
+// Everything a draw looks up by name, resolved once
+struct DrawHandles
+{
+	SimpleShaderVariableHandle World;
+	SimpleShaderVariableHandle WorldInvTranspose;
+	SimpleShaderVariableHandle ColorTint;
+	SimpleSRVHandle Textures[4];
+	SimpleSamplerHandle Sampler;
+};
+
+static const char* textureNames[4] = { "AlbedoMap", "NormalMap", "RoughnessMap", "MetalnessMap" };
+
+// Every byte of a shader's local buffers, to compare the two paths
+static std::vector<unsigned char> LocalData(ISimpleShader* shader)
+{
+	std::vector<unsigned char> data;
+	for (unsigned int i = 0; i < shader->GetBufferCount(); i++)
+	{
+		const SimpleConstantBuffer* cb = shader->GetBufferInfo(i);
+		data.insert(data.end(), cb->LocalDataBuffer, cb->LocalDataBuffer + cb->Size);
+	}
+	return data;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int drawCount = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+	unsigned int frameCount = argc > 2 ? (unsigned int)atoi(argv[2]) : 20;
+	std::string folder = argc > 3 ? argv[3] : ".";
+	if (drawCount == 0 || frameCount == 0)
+	{
+		printf("Usage: ShaderHandleBenchmark [draws] [frames] [shader folder]\n");
+		return 1;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	if (FAILED(D3D11CreateDevice(0, D3D_DRIVER_TYPE_HARDWARE, 0, 0, 0, 0, D3D11_SDK_VERSION, device.GetAddressOf(), 0, context.GetAddressOf())) &&
+		FAILED(D3D11CreateDevice(0, D3D_DRIVER_TYPE_WARP, 0, 0, 0, 0, D3D11_SDK_VERSION, device.GetAddressOf(), 0, context.GetAddressOf())))
+	{
+		printf("Couldn't create a Direct3D 11 device\n");
+		return 1;
+	}
+
+	std::wstring wideFolder(folder.begin(), folder.end());
+	SimpleVertexShader vs(device, context, (wideFolder + L"/VertexShader.cso").c_str());
+	SimplePixelShader ps(device, context, (wideFolder + L"/PixelShader.cso").c_str());
+	if (!vs.IsShaderValid() || !ps.IsShaderValid())
+	{
+		printf("Couldn't load VertexShader.cso and PixelShader.cso from %s\n", folder.c_str());
+		return 1;
+	}
+
+	SimpleStateCache stateCache(context);
+	vs.SetStateCache(&stateCache);
+	ps.SetStateCache(&stateCache);
+
+	DrawHandles handles;
+	handles.World = vs.GetVariableHandle("world");
+	handles.WorldInvTranspose = vs.GetVariableHandle("worldInvTranspose");
+	handles.ColorTint = ps.GetVariableHandle("colorTint");
+	for (int t = 0; t < 4; t++)
+		handles.Textures[t] = ps.GetShaderResourceViewHandle(textureNames[t]);
+	handles.Sampler = ps.GetSamplerHandle("BasicSampler");
+
+	// Null views and samplers are enough, since nothing is drawn
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
+
+	std::vector<BenchmarkDraw> draws(drawCount);
+	for (unsigned int i = 0; i < drawCount; i++)
+	{
+		XMMATRIX world = XMMatrixTranslation((float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+		XMStoreFloat4x4(&draws[i].World, world);
+		XMStoreFloat4x4(&draws[i].WorldInvTranspose, XMMatrixInverse(0, XMMatrixTranspose(world)));
+		draws[i].ColorTint = XMFLOAT3((i % 7) / 7.0f, (i % 11) / 11.0f, (i % 13) / 13.0f);
+	}
+
+	struct Variant
+	{
+		const char* Name;
+		bool Handles;
+		bool Upload;
+	};
+	const Variant variants[] =
+	{
+		{ "Strings", false, false },
+		{ "Handles", true, false },
+		{ "Strings + upload", false, true },
+		{ "Handles + upload", true, true },
+	};
+
+	printf("%u draws, %u frames\n\n", drawCount, frameCount);
+	printf("%-18s %12s %12s %12s %8s\n", "Path", "Best", "Average", "Per draw", "Speedup");
+
+	double stringBest = 0;
+	int failures = 0;
+	std::vector<unsigned char> stringVSData;
+	std::vector<unsigned char> stringPSData;
+	for (const Variant& variant : variants)
+	{
+		double best = 1e30;
+		double total = 0;
+		for (unsigned int frame = 0; frame < frameCount; frame++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			for (const BenchmarkDraw& draw : draws)
+			{
+				if (variant.Handles)
+				{
+					vs.SetMatrix4x4(handles.World, draw.World);
+					vs.SetMatrix4x4(handles.WorldInvTranspose, draw.WorldInvTranspose);
+					ps.SetFloat3(handles.ColorTint, draw.ColorTint);
+					for (int t = 0; t < 4; t++)
+						ps.SetShaderResourceView(handles.Textures[t], srv);
+					ps.SetSamplerState(handles.Sampler, sampler);
+				}
+				else
+				{
+					vs.SetMatrix4x4("world", draw.World);
+					vs.SetMatrix4x4("worldInvTranspose", draw.WorldInvTranspose);
+					ps.SetFloat3("colorTint", draw.ColorTint);
+					for (int t = 0; t < 4; t++)
+						ps.SetShaderResourceView(textureNames[t], srv);
+					ps.SetSamplerState("BasicSampler", sampler);
+				}
+
+				if (variant.Upload)
+				{
+					vs.CopyBufferData(SIMPLE_BUFFER_PER_OBJECT);
+					ps.CopyBufferData(SIMPLE_BUFFER_PER_MATERIAL);
+				}
+			}
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			best = ms < best ? ms : best;
+			total += ms;
+		}
+
+		// Both paths have to leave the buffers holding the last draw
+		bool same = true;
+		if (!variant.Handles)
+		{
+			stringBest = best;
+			stringVSData = LocalData(&vs);
+			stringPSData = LocalData(&ps);
+		}
+		else
+		{
+			same = LocalData(&vs) == stringVSData && LocalData(&ps) == stringPSData;
+			failures += same ? 0 : 1;
+		}
+
+		printf("%-18s %9.3f ms %9.3f ms %9.1f ns %7.2fx%s\n",
+			variant.Name, best, total / frameCount,
+			best * 1000000.0 / drawCount,
+			stringBest / best,
+			same ? "" : "  MISMATCH with setting by name");
+
+		// Clear the buffers so the next path has to write them itself
+		for (unsigned int i = 0; i < vs.GetBufferCount(); i++)
+			memset(vs.GetBufferInfo(i)->LocalDataBuffer, 0, vs.GetBufferInfo(i)->Size);
+		for (unsigned int i = 0; i < ps.GetBufferCount(); i++)
+			memset(ps.GetBufferInfo(i)->LocalDataBuffer, 0, ps.GetBufferInfo(i)->Size);
+	}
+
+	return failures > 0 ? 1 : 0;
+}
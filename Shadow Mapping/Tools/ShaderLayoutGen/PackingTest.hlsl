@@ -0,0 +1,58 @@
+// Fixture for ShaderLayoutGenTest - cbuffers that hit each
+// packing rule, with the offsets fxc gives them alongside.
+// Never compiled into the game.
+
+#define PAIR_COUNT 2
+
+// Vectors that would straddle a register start the next one
+cbuffer Straddle : register(b0)
+{
+	float2 a;			// 0
+	float3 b;			// 16 (8 + 12 would cross 16)
+	float c;			// 28
+	float3 d;			// 32
+	float2 e;			// 48 (44 + 8 would cross 48)
+	float f;			// 56
+	float g;			// 60
+	float3 h;			// 64
+};						// 80
+
+// ...and ones that fit pack in behind what's there
+cbuffer Packed : register(b1)
+{
+	float x;			// 0
+	float3 y;			// 4
+	float2 z;			// 16
+	float w;			// 24
+};						// 32
+
+// Every element starts a register, but the last isn't padded
+cbuffer Arrays : register(b2)
+{
+	float values[3];		// 0, 36 bytes
+	float afterValues;		// 36
+	float2 pairs[PAIR_COUNT];	// 48, 24 bytes
+	float2 afterPairs;		// 72
+	float3 triples[2];		// 80, 28 bytes
+	float afterTriples;		// 108
+	float4 quads[2];		// 112, 32 bytes
+	float afterQuads;		// 144
+};						// 160
+
+// Column-major (the default) is a register per column,
+// row_major a register per row, the last one unpadded
+cbuffer Matrices : register(b3)
+{
+	float4x4 full;			// 0, 64 bytes
+	float3x4 columns;		// 64, 60 bytes
+	float afterColumns;		// 124
+	row_major float3x4 rows;	// 128, 48 bytes
+	float afterRows;		// 176
+	float2x2 small;			// 192, 24 bytes
+	float afterSmall;		// 216
+	row_major float2x3 rows23;	// 224, 28 bytes
+	float afterRows23;		// 252
+	column_major float4x3 columns43;	// 256, 48 bytes
+	matrix array[2];		// 304, 128 bytes
+	float afterArray;		// 432
+};						// 448
@@ -0,0 +1,682 @@
+// --------------------------------------------------------
+// ShaderLayoutGen - reads the cbuffers out of HLSL source
+// files and writes a C++ header with a struct for each,
+// laid out by the HLSL constant buffer packing rules and
+// with every offset and size checked by static_assert.
+// A whole buffer can then be filled as one struct and
+// handed to ISimpleShader::SetBufferData().
+//
+// Usage:
+//   ShaderLayoutGen <output header> <shader.hlsl> [more shaders...]
+//
+// The output is only rewritten when its contents change, so
+// the game project can run this before every build (see the
+// GenerateShaderLayouts target in DX11Starter.vcxproj)
+// without recompiling everything that includes the header.
+//
+// Structs are named <shader file>_<cbuffer>, and HLSL structs
+// used inside cbuffers get their own C++ struct, all in the
+// ShaderLayouts namespace.  Follows #include "..." and
+// integer #defines, and skips everything that isn't a struct
+// or cbuffer.  Standard C++17 only, so it builds anywhere:
+//   cl /std:c++17 /EHsc ShaderLayoutGen.cpp
+//   g++ -std=c++17 ShaderLayoutGen.cpp -o ShaderLayoutGen
+// --------------------------------------------------------
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// A member of a struct or cbuffer, with its place in the
+// packed layout once PackMembers() has run
+// --------------------------------------------------------
+struct HlslMember
+{
+	std::string Name;
+	std::string Type;			// Scalar base (float, int, uint, bool) or struct name
+	unsigned int Rows = 1;		// Matrices only
+	unsigned int Columns = 1;	// Vector size, or matrix columns
+	bool IsMatrix = false;
+	bool RowMajor = false;
+	bool IsStruct = false;
+	unsigned int ArrayCount = 0;	// Zero if not an array
+
+	unsigned int Offset = 0;
+	unsigned int ElementSize = 0;	// Size of one element, unpadded
+	unsigned int Size = 0;			// Whole member, with array padding
+};
+
+struct HlslStruct
+{
+	std::string Name;
+	std::vector<HlslMember> Members;
+	unsigned int Size = 0;			// Packed size, not rounded up
+};
+
+struct HlslCBuffer
+{
+	std::string Name;
+	std::string Shader;
+	std::vector<HlslMember> Members;
+	unsigned int Size = 0;			// Rounded up to a whole register
+};
+
+// Registers are 16 bytes (4 components of 4 bytes)
+static const unsigned int RegisterSize = 16;
+
+static unsigned int AlignToRegister(unsigned int offset)
+{
+	return (offset + RegisterSize - 1) / RegisterSize * RegisterSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ PACKING RULES ------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// --------------------------------------------------------
+// Size of one element of a member, before any array padding.
+// Matrices are a register per column (or per row, for
+// row_major), with the last one only as long as it needs.
+// --------------------------------------------------------
+static unsigned int ElementSize(const HlslMember& m, const std::map<std::string, HlslStruct>& structs)
+{
+	if (m.IsStruct)
+		return structs.at(m.Type).Size;
+
+	if (m.IsMatrix)
+	{
+		unsigned int registers = m.RowMajor ? m.Rows : m.Columns;
+		unsigned int components = m.RowMajor ? m.Columns : m.Rows;
+		return RegisterSize * (registers - 1) + 4 * components;
+	}
+
+	return 4 * m.Columns;
+}
+
+// --------------------------------------------------------
+// Lays members out one after the other:
+//  - Vectors and scalars pack tightly, but never straddle
+//    a 16 byte register; if one would, it starts the next
+//  - Arrays, structs and matrices always start a register
+//  - Every array element starts a register, but the last
+//    element isn't padded, so what follows can pack into
+//    the rest of its register
+// Returns the end of the last member (not rounded up).
+// --------------------------------------------------------
+static unsigned int PackMembers(std::vector<HlslMember>& members, const std::map<std::string, HlslStruct>& structs)
+{
+	unsigned int offset = 0;
+	for (auto& m : members)
+	{
+		m.ElementSize = ElementSize(m, structs);
+
+		bool startsRegister = m.ArrayCount > 0 || m.IsStruct || m.IsMatrix;
+		if (startsRegister || offset % RegisterSize + m.ElementSize > RegisterSize)
+			offset = AlignToRegister(offset);
+
+		m.Offset = offset;
+		m.Size = m.ArrayCount > 0 ?
+			AlignToRegister(m.ElementSize) * (m.ArrayCount - 1) + m.ElementSize :
+			m.ElementSize;
+		offset += m.Size;
+	}
+	return offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ PARSING -------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// --------------------------------------------------------
+// Pulls the structs and cbuffers out of HLSL source
+// --------------------------------------------------------
+class HlslParser
+{
+public:
+	std::map<std::string, HlslStruct> Structs;
+	std::vector<HlslCBuffer> CBuffers;
+
+	void ParseFile(const std::string& path)
+	{
+		currentShader = ShaderName(path);
+		tokens.clear();
+		position = 0;
+		Tokenize(Preprocess(path));
+
+		while (position < tokens.size())
+		{
+			if (tokens[position] == "struct")
+				ParseStruct();
+			else if (tokens[position] == "cbuffer")
+				ParseCBuffer();
+			else if (tokens[position] == "{")
+				SkipBlock();
+			else
+				position++;
+		}
+	}
+
+private:
+	std::vector<std::string> tokens;
+	size_t position = 0;
+	std::map<std::string, std::string> defines;
+	std::set<std::string> included;
+	std::string currentShader;
+
+	static std::string ShaderName(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		return name.substr(0, name.find('.'));
+	}
+
+	static std::string Directory(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	// Reads a file with its includes pasted in, comments removed
+	// and defines remembered.  Other directives are ignored.
+	std::string Preprocess(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file)
+			throw std::runtime_error("Unable to open " + path);
+		std::stringstream contents;
+		contents << file.rdbuf();
+		std::string source = StripComments(contents.str());
+
+		std::string result;
+		std::istringstream lines(source);
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			std::istringstream words(line);
+			std::string directive;
+			words >> directive;
+
+			if (directive == "#include")
+			{
+				size_t open = line.find('"');
+				size_t close = line.find('"', open + 1);
+				if (open == std::string::npos || close == std::string::npos)
+					continue;
+
+				std::string includePath = Directory(path) + line.substr(open + 1, close - open - 1);
+				if (included.insert(includePath).second)
+					result += Preprocess(includePath);
+			}
+			else if (directive == "#define")
+			{
+				std::string name, value;
+				words >> name >> value;
+				defines[name] = value;
+			}
+			else if (directive.empty() || directive[0] != '#')
+			{
+				result += line + "\n";
+			}
+		}
+		return result;
+	}
+
+	static std::string StripComments(const std::string& source)
+	{
+		std::string result;
+		for (size_t i = 0; i < source.size(); i++)
+		{
+			if (source.compare(i, 2, "//") == 0)
+			{
+				while (i < source.size() && source[i] != '\n') i++;
+				result += '\n';
+			}
+			else if (source.compare(i, 2, "/*") == 0)
+			{
+				size_t end = source.find("*/", i + 2);
+				i = end == std::string::npos ? source.size() : end + 1;
+				result += ' ';
+			}
+			else
+			{
+				result += source[i];
+			}
+		}
+		return result;
+	}
+
+	void Tokenize(const std::string& source)
+	{
+		for (size_t i = 0; i < source.size();)
+		{
+			char c = source[i];
+			if (isspace((unsigned char)c))
+			{
+				i++;
+			}
+			else if (isalnum((unsigned char)c) || c == '_')
+			{
+				size_t start = i;
+				while (i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_' || source[i] == '.'))
+					i++;
+				tokens.push_back(source.substr(start, i - start));
+			}
+			else
+			{
+				tokens.push_back(std::string(1, c));
+				i++;
+			}
+		}
+	}
+
+	const std::string& Next()
+	{
+		if (position >= tokens.size())
+			throw std::runtime_error("Unexpected end of " + currentShader);
+		return tokens[position++];
+	}
+
+	void Expect(const std::string& token)
+	{
+		if (Next() != token)
+			throw std::runtime_error("Expected '" + token + "' in " + currentShader + " near '" + tokens[position - 1] + "'");
+	}
+
+	void SkipBlock()
+	{
+		int depth = 0;
+		do
+		{
+			const std::string& t = Next();
+			if (t == "{") depth++;
+			else if (t == "}") depth--;
+		} while (depth > 0);
+	}
+
+	unsigned int Number(const std::string& token)
+	{
+		auto define = defines.find(token);
+		const std::string& text = define != defines.end() ? define->second : token;
+		if (text.empty() || !isdigit((unsigned char)text[0]))
+			throw std::runtime_error("Array size '" + token + "' isn't a number in " + currentShader);
+		return (unsigned int)std::stoul(text);
+	}
+
+	void ParseStruct()
+	{
+		Expect("struct");
+		HlslStruct s;
+		s.Name = Next();
+		if (tokens[position] != "{")
+			return; // Just a use of the type, like "struct Light light"
+
+		s.Members = ParseMembers();
+		s.Size = PackMembers(s.Members, Structs);
+		Structs[s.Name] = s;
+	}
+
+	void ParseCBuffer()
+	{
+		Expect("cbuffer");
+		HlslCBuffer cb;
+		cb.Name = Next();
+		cb.Shader = currentShader;
+		while (tokens[position] != "{")
+			position++; // register(bN)
+
+		cb.Members = ParseMembers();
+		cb.Size = AlignToRegister(PackMembers(cb.Members, Structs));
+		CBuffers.push_back(cb);
+	}
+
+	// Reads "{ members }", each member being
+	// [modifiers] type name[size]... [: semantic] [, name...] ;
+	std::vector<HlslMember> ParseMembers()
+	{
+		std::vector<HlslMember> members;
+		Expect("{");
+		while (tokens[position] != "}")
+		{
+			HlslMember base;
+			std::string type = Next();
+			while (type == "row_major" || type == "column_major" || type == "precise" ||
+				type == "nointerpolation" || type == "linear" || type == "centroid" ||
+				type == "noperspective" || type == "sample" || type == "uniform" || type == "const")
+			{
+				if (type == "row_major") base.RowMajor = true;
+				type = Next();
+			}
+			ParseType(type, base);
+
+			for (;;)
+			{
+				HlslMember m = base;
+				m.Name = Next();
+				while (tokens[position] == "[")
+				{
+					Next();
+					unsigned int count = Number(Next());
+					m.ArrayCount = m.ArrayCount ? m.ArrayCount * count : count;
+					Expect("]");
+				}
+				if (tokens[position] == ":")
+				{
+					Next();
+					Next(); // semantic, which doesn't matter here
+				}
+				members.push_back(m);
+
+				if (tokens[position] != ",") break;
+				Next();
+			}
+			Expect(";");
+		}
+		Expect("}");
+		return members;
+	}
+
+	void ParseType(const std::string& type, HlslMember& m)
+	{
+		if (type == "matrix")
+		{
+			m.Type = "float";
+			m.IsMatrix = true;
+			m.Rows = m.Columns = 4;
+			return;
+		}
+
+		if (Structs.count(type))
+		{
+			m.Type = type;
+			m.IsStruct = true;
+			return;
+		}
+
+		static const char* scalars[] = { "float", "half", "int", "uint", "dword", "bool" };
+		for (const char* scalar : scalars)
+		{
+			std::string s = scalar;
+			if (type.compare(0, s.size(), s) != 0)
+				continue;
+
+			std::string dims = type.substr(s.size());
+			m.Type = s == "half" ? "float" : s == "dword" ? "uint" : s;
+			if (dims.empty())
+				return;
+			if (dims.size() == 1 && dims[0] >= '1' && dims[0] <= '4')
+			{
+				m.Columns = dims[0] - '0';
+				return;
+			}
+			if (dims.size() == 3 && dims[1] == 'x' &&
+				dims[0] >= '1' && dims[0] <= '4' && dims[2] >= '1' && dims[2] <= '4')
+			{
+				m.IsMatrix = true;
+				m.Rows = dims[0] - '0';
+				m.Columns = dims[2] - '0';
+				return;
+			}
+		}
+
+		// Anything else (textures, doubles...) can't be in a cbuffer we handle,
+		// but plain structs full of them (shader inputs) are fine to skip
+		m.Type = type;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ OUTPUT --------------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// --------------------------------------------------------
+// The C++ type for one element of a member
+// --------------------------------------------------------
+static std::string CppType(const HlslMember& m)
+{
+	if (m.IsStruct)
+		return m.Type;
+
+	if (m.IsMatrix)
+		return m.Rows == 4 && m.Columns == 4 ? "DirectX::XMFLOAT4X4" : "";
+
+	std::string scalar =
+		m.Type == "float" ? "float" :
+		m.Type == "uint" ? "unsigned int" :
+		"int"; // HLSL bools are 4 bytes
+
+	if (m.Columns == 1)
+		return scalar;
+
+	std::string prefix =
+		m.Type == "float" ? "DirectX::XMFLOAT" :
+		m.Type == "uint" ? "DirectX::XMUINT" :
+		"DirectX::XMINT";
+	return prefix + std::to_string(m.Columns);
+}
+
+// --------------------------------------------------------
+// Whether member i is an array of small elements with
+// something packed into the register of its last element,
+// so the last one has to be written unpadded on its own
+// --------------------------------------------------------
+static bool SplitsLastElement(const std::vector<HlslMember>& members, size_t i, unsigned int size)
+{
+	const HlslMember& m = members[i];
+	unsigned int stride = AlignToRegister(m.ElementSize);
+	if (m.ArrayCount == 0 || stride == m.ElementSize || CppType(m).empty())
+		return false;
+
+	unsigned int next = i + 1 < members.size() ? members[i + 1].Offset : size;
+	return next < m.Offset + stride * m.ArrayCount;
+}
+
+// --------------------------------------------------------
+// Writes a struct's members with explicit padding wherever
+// the packing rules leave a gap, then the static_asserts
+// --------------------------------------------------------
+static void WriteStruct(std::ostream& out, const std::string& name, const std::vector<HlslMember>& members, unsigned int size)
+{
+	for (auto& m : members)
+	{
+		if (m.Type.empty() || (!m.IsStruct && m.Type != "float" && m.Type != "int" && m.Type != "uint" && m.Type != "bool"))
+			throw std::runtime_error("Type '" + m.Type + "' of " + name + "::" + m.Name + " can't go in a constant buffer");
+	}
+
+	out << "struct " << name << "\n{\n";
+
+	unsigned int cursor = 0;
+	unsigned int padCount = 0;
+	for (size_t i = 0; i < members.size(); i++)
+	{
+		const HlslMember& m = members[i];
+		if (m.Offset > cursor)
+			out << "\tfloat _pad" << padCount++ << "[" << (m.Offset - cursor) / 4 << "];\n";
+
+		std::string type = CppType(m);
+		unsigned int stride = AlignToRegister(m.ElementSize);
+		if (type.empty())
+		{
+			// Odd sized matrices are written as their raw registers
+			out << "\tfloat " << m.Name << "[" << m.Size / 4 << "];\t// " << m.Rows << "x" << m.Columns
+				<< (m.RowMajor ? " row_major" : " column_major") << (m.ArrayCount ? ", array" : "") << "\n";
+		}
+		else if (m.ArrayCount == 0)
+		{
+			out << "\t" << type << " " << m.Name << ";\n";
+		}
+		else if (stride == m.ElementSize)
+		{
+			out << "\t" << type << " " << m.Name << "[" << m.ArrayCount << "];\n";
+		}
+		else
+		{
+			// Each element padded out to its register, except that the last
+			// one has to stop short if the next member packs in after it
+			std::string padded = "SimplePaddedElement<" + type + ", " + std::to_string((stride - m.ElementSize) / 4) + ">";
+			if (!SplitsLastElement(members, i, size))
+			{
+				out << "\t" << padded << " " << m.Name << "[" << m.ArrayCount << "];\n";
+				cursor = m.Offset + stride * m.ArrayCount;
+				continue;
+			}
+
+			if (m.ArrayCount > 1)
+				out << "\t" << padded << " " << m.Name << "[" << m.ArrayCount - 1 << "];\n";
+			out << "\t" << type << " " << m.Name << "Last;\n";
+		}
+		cursor = m.Offset + m.Size;
+	}
+	if (size > cursor)
+		out << "\tfloat _pad" << padCount++ << "[" << (size - cursor) / 4 << "];\n";
+	out << "};\n";
+
+	for (size_t i = 0; i < members.size(); i++)
+	{
+		const HlslMember& m = members[i];
+		bool onlyLast = m.ArrayCount == 1 && SplitsLastElement(members, i, size);
+		std::string field = onlyLast ? m.Name + "Last" : m.Name;
+		out << "static_assert(offsetof(" << name << ", " << field << ") == " << m.Offset
+			<< ", \"" << name << "::" << m.Name << " isn't where HLSL puts it\");\n";
+	}
+	out << "static_assert(sizeof(" << name << ") == " << size
+		<< ", \"" << name << " isn't the size HLSL makes it\");\n\n";
+}
+
+// --------------------------------------------------------
+// Writes the whole header: structs used by cbuffers first
+// (in the order they were declared), then the cbuffers
+// --------------------------------------------------------
+static void WriteHeader(std::ostream& out, const HlslParser& parser, const std::vector<std::string>& sources)
+{
+	out << "#pragma once\n\n";
+	out << "// --------------------------------------------------------\n";
+	out << "// Generated by Tools/ShaderLayoutGen from:\n";
+	for (auto& s : sources)
+		out << "//   " << s << "\n";
+	out << "// Don't edit - the game project regenerates it from the\n";
+	out << "// shaders before every build.\n";
+	out << "//\n";
+	out << "// One struct per cbuffer, laid out exactly as HLSL packs\n";
+	out << "// it, for ISimpleShader::SetBufferData().\n";
+	out << "// --------------------------------------------------------\n\n";
+	out << "#include <DirectXMath.h>\n#include <cstddef>\n\n";
+	out << "namespace ShaderLayouts\n{\n\n";
+
+	out << "// An array element padded out to a whole 16 byte register\n";
+	out << "template<typename T, unsigned int PadFloats>\n";
+	out << "struct SimplePaddedElement\n{\n\tT Value;\n\tfloat _pad[PadFloats];\n};\n\n";
+
+	// Structs, in dependency order, only if some cbuffer uses them
+	std::set<std::string> used;
+	std::vector<std::string> order;
+	std::vector<std::string> pending;
+	for (auto& cb : parser.CBuffers)
+		for (auto& m : cb.Members)
+			if (m.IsStruct) pending.push_back(m.Type);
+	while (!pending.empty())
+	{
+		std::string name = pending.back();
+		pending.pop_back();
+		if (!used.insert(name).second) continue;
+		for (auto& m : parser.Structs.at(name).Members)
+			if (m.IsStruct) pending.push_back(m.Type);
+	}
+	for (auto& s : parser.Structs)
+		if (used.count(s.first)) order.push_back(s.first);
+
+	// Members before the structs that contain them
+	std::vector<std::string> sorted;
+	std::set<std::string> written;
+	while (sorted.size() < order.size())
+	{
+		for (auto& name : order)
+		{
+			if (written.count(name)) continue;
+			bool ready = true;
+			for (auto& m : parser.Structs.at(name).Members)
+				if (m.IsStruct && !written.count(m.Type)) ready = false;
+			if (ready)
+			{
+				sorted.push_back(name);
+				written.insert(name);
+			}
+		}
+	}
+
+	for (auto& name : sorted)
+	{
+		const HlslStruct& s = parser.Structs.at(name);
+		WriteStruct(out, s.Name, s.Members, s.Size);
+	}
+
+	for (auto& cb : parser.CBuffers)
+		WriteStruct(out, cb.Shader + "_" + cb.Name, cb.Members, cb.Size);
+
+	out << "}\n";
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		printf("Usage: ShaderLayoutGen <output header> <shader.hlsl> [more shaders...]\n");
+		return 1;
+	}
+
+	try
+	{
+		HlslParser parser;
+		std::vector<std::string> sources;
+		for (int i = 2; i < argc; i++)
+		{
+			HlslParser fileParser;
+			fileParser.ParseFile(argv[i]);
+
+			// Shaders share include files, so a struct can turn up more than once
+			for (auto& s : fileParser.Structs)
+			{
+				auto existing = parser.Structs.find(s.first);
+				if (existing != parser.Structs.end() && existing->second.Size != s.second.Size)
+					throw std::runtime_error("Struct " + s.first + " has different layouts in different shaders");
+				parser.Structs[s.first] = s.second;
+			}
+			parser.CBuffers.insert(parser.CBuffers.end(), fileParser.CBuffers.begin(), fileParser.CBuffers.end());
+
+			std::string source = argv[i];
+			size_t slash = source.find_last_of("/\\");
+			sources.push_back(slash == std::string::npos ? source : source.substr(slash + 1));
+		}
+
+		std::ostringstream header;
+		WriteHeader(header, parser, sources);
+
+		// Leave an up to date header (and its timestamp) alone
+		{
+			std::ifstream existing(argv[1]);
+			std::ostringstream existingText;
+			existingText << existing.rdbuf();
+			if (existing && existingText.str() == header.str())
+				return 0;
+		}
+
+		std::ofstream out(argv[1]);
+		if (!out)
+			throw std::runtime_error(std::string("Unable to write ") + argv[1]);
+		out << header.str();
+		printf("ShaderLayoutGen: wrote %s\n", argv[1]);
+	}
+	catch (const std::exception& e)
+	{
+		fprintf(stderr, "ShaderLayoutGen: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
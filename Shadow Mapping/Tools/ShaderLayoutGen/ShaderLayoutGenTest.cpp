@@ -0,0 +1,164 @@
+// --------------------------------------------------------
+// ShaderLayoutGenTest - checks ShaderLayoutGen's packing
+// (PackMembers and ElementSize) against the offsets fxc
+// gives the cbuffers in PackingTest.hlsl: float3s that
+// would straddle a register, arrays whose last element
+// isn't padded, and row and column-major matrices.
+//
+// Usage:
+//   ShaderLayoutGenTest [fixture]
+//   (default: PackingTest.hlsl in the current folder)
+//
+// Pulls the tool itself in, so it tests exactly what the
+// tool runs.  Builds like the tool:
+//   cl /std:c++17 /EHsc ShaderLayoutGenTest.cpp
+//   g++ -std=c++17 ShaderLayoutGenTest.cpp -o ShaderLayoutGenTest
+// --------------------------------------------------------
+
+#define main ShaderLayoutGenMain
+#include "ShaderLayoutGen.cpp"
+#undef main
+
+// Where fxc puts one member
+struct ExpectedMember
+{
+	const char* CBuffer;
+	const char* Name;
+	unsigned int Offset;
+	unsigned int Size;
+};
+
+// What fxc reports for PackingTest.hlsl
+static const ExpectedMember expectedMembers[] =
+{
+	{ "Straddle", "a", 0, 8 },
+	{ "Straddle", "b", 16, 12 },
+	{ "Straddle", "c", 28, 4 },
+	{ "Straddle", "d", 32, 12 },
+	{ "Straddle", "e", 48, 8 },
+	{ "Straddle", "f", 56, 4 },
+	{ "Straddle", "g", 60, 4 },
+	{ "Straddle", "h", 64, 12 },
+
+	{ "Packed", "x", 0, 4 },
+	{ "Packed", "y", 4, 12 },
+	{ "Packed", "z", 16, 8 },
+	{ "Packed", "w", 24, 4 },
+
+	{ "Arrays", "values", 0, 36 },
+	{ "Arrays", "afterValues", 36, 4 },
+	{ "Arrays", "pairs", 48, 24 },
+	{ "Arrays", "afterPairs", 72, 8 },
+	{ "Arrays", "triples", 80, 28 },
+	{ "Arrays", "afterTriples", 108, 4 },
+	{ "Arrays", "quads", 112, 32 },
+	{ "Arrays", "afterQuads", 144, 4 },
+
+	{ "Matrices", "full", 0, 64 },
+	{ "Matrices", "columns", 64, 60 },
+	{ "Matrices", "afterColumns", 124, 4 },
+	{ "Matrices", "rows", 128, 48 },
+	{ "Matrices", "afterRows", 176, 4 },
+	{ "Matrices", "small", 192, 24 },
+	{ "Matrices", "afterSmall", 216, 4 },
+	{ "Matrices", "rows23", 224, 28 },
+	{ "Matrices", "afterRows23", 252, 4 },
+	{ "Matrices", "columns43", 256, 48 },
+	{ "Matrices", "array", 304, 128 },
+	{ "Matrices", "afterArray", 432, 4 },
+};
+
+// Whole buffer sizes, rounded up to a register
+struct ExpectedCBuffer
+{
+	const char* Name;
+	unsigned int Size;
+	size_t MemberCount;
+};
+
+static const ExpectedCBuffer expectedCBuffers[] =
+{
+	{ "Straddle", 80, 8 },
+	{ "Packed", 32, 4 },
+	{ "Arrays", 160, 8 },
+	{ "Matrices", 448, 12 },
+};
+
+static const HlslCBuffer* FindCBuffer(const HlslParser& parser, const std::string& name)
+{
+	for (auto& cb : parser.CBuffers)
+	{
+		if (cb.Name == name)
+			return &cb;
+	}
+	return 0;
+}
+
+static const HlslMember* FindMember(const HlslCBuffer& cb, const std::string& name)
+{
+	for (auto& m : cb.Members)
+	{
+		if (m.Name == name)
+			return &m;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string fixture = argc > 1 ? argv[1] : "PackingTest.hlsl";
+
+	HlslParser parser;
+	try
+	{
+		parser.ParseFile(fixture);
+	}
+	catch (const std::exception& e)
+	{
+		printf("ShaderLayoutGenTest: %s\n", e.what());
+		printf("Usage: ShaderLayoutGenTest [fixture]\n");
+		return 1;
+	}
+
+	int failures = 0;
+	for (const ExpectedCBuffer& expected : expectedCBuffers)
+	{
+		const HlslCBuffer* cb = FindCBuffer(parser, expected.Name);
+		if (!cb)
+		{
+			printf("FAIL  cbuffer %s is missing\n", expected.Name);
+			failures++;
+			continue;
+		}
+
+		if (cb->Size != expected.Size || cb->Members.size() != expected.MemberCount)
+		{
+			printf("FAIL  cbuffer %s is %u bytes with %zu members, expected %u bytes with %zu\n",
+				expected.Name, cb->Size, cb->Members.size(), expected.Size, expected.MemberCount);
+			failures++;
+		}
+	}
+
+	for (const ExpectedMember& expected : expectedMembers)
+	{
+		const HlslCBuffer* cb = FindCBuffer(parser, expected.CBuffer);
+		const HlslMember* m = cb ? FindMember(*cb, expected.Name) : 0;
+		if (!m)
+		{
+			printf("FAIL  %s.%s is missing\n", expected.CBuffer, expected.Name);
+			failures++;
+			continue;
+		}
+
+		bool passed = m->Offset == expected.Offset && m->Size == expected.Size;
+		printf("%s  %-9s %-13s offset %3u size %3u", passed ? "pass" : "FAIL", expected.CBuffer, expected.Name, m->Offset, m->Size);
+		if (!passed)
+			printf("  expected offset %u size %u", expected.Offset, expected.Size);
+		printf("\n");
+		failures += passed ? 0 : 1;
+	}
+
+	if (failures > 0)
+		printf("%d checks failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
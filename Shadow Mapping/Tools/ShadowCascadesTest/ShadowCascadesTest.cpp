@@ -0,0 +1,324 @@
+// --------------------------------------------------------
+// ShadowCascadesTest - checks the cascade fitting math:
+// that the splits start and end where asked and match the
+// uniform and logarithmic schemes at lambda 0 and 1, that
+// every slice's sphere holds all 8 of its corners (wide,
+// thin slices too, where the center is clamped to the far
+// cap), that moving a cascade's center by less than a
+// texel doesn't move the cascade, and that every receiver
+// (next to a split too) picks a cascade that holds it and
+// whose culled casters include the ones shadowing it.
+//
+// Usage:
+//   ShadowCascadesTest
+//
+// Only DirectXMath, so no device is needed.  Builds with
+// the game's cascade code:
+//   cl /std:c++17 /O2 /EHsc /I..\.. ShadowCascadesTest.cpp ..\..\ShadowCascades.cpp ..\..\FrustumCulling.cpp
+// --------------------------------------------------------
+
+#include <cmath>
+#include <cstdio>
+
+#include "ShadowCascades.h"
+#include "FrustumCulling.h"
+#include "../TestCheck.h"
+
+using namespace DirectX;
+
+static bool Close(float a, float b, float tolerance)
+{
+	return fabsf(a - b) <= tolerance * (1.0f + fabsf(a) + fabsf(b));
+}
+
+// --------------------------------------------------------
+// Endpoints, ordering, and the two pure schemes
+// --------------------------------------------------------
+static void TestSplits()
+{
+	struct SplitCase { float Near; float Far; unsigned int Count; };
+	const SplitCase cases[] = { { 0.1f, 100.0f, 4 }, { 0.5f, 1000.0f, 3 }, { 1.0f, 50.0f, 1 }, { 0.01f, 200.0f, 2 } };
+	const float lambdas[] = { 0.0f, 0.25f, 0.5f, 0.9f, 1.0f };
+
+	bool endpoints = true;
+	bool increasing = true;
+	bool uniform = true;
+	bool logarithmic = true;
+	for (const SplitCase& c : cases)
+	{
+		for (float lambda : lambdas)
+		{
+			float splits[MAX_SHADOW_CASCADES + 1];
+			ComputeCascadeSplits(c.Near, c.Far, c.Count, lambda, splits);
+
+			endpoints = endpoints && splits[0] == c.Near && splits[c.Count] == c.Far;
+			for (unsigned int i = 1; i <= c.Count; i++)
+				increasing = increasing && splits[i] > splits[i - 1];
+
+			for (unsigned int i = 0; i <= c.Count; i++)
+			{
+				float fraction = (float)i / c.Count;
+				if (lambda == 0.0f)
+					uniform = uniform && Close(splits[i], c.Near + (c.Far - c.Near) * fraction, 1e-5f);
+				if (lambda == 1.0f)
+					logarithmic = logarithmic && Close(splits[i], c.Near * powf(c.Far / c.Near, fraction), 1e-5f);
+			}
+		}
+	}
+
+	Check(endpoints, "splits start at near and end at far");
+	Check(increasing, "splits always increase");
+	Check(uniform, "lambda 0 gives uniform splits");
+	Check(logarithmic, "lambda 1 gives logarithmic splits");
+}
+
+// --------------------------------------------------------
+// The sphere, moved into world space the same way as the
+// corners, must reach every corner - and for a tight fit,
+// the furthest corner should be right on it
+// --------------------------------------------------------
+static void TestSliceSpheres()
+{
+	struct SliceCase { const char* Name; float TanHalfFovY; float Aspect; float Near; float Far; bool Clamped; };
+	const SliceCase cases[] =
+	{
+		{ "slice sphere holds its corners (first cascade)", tanf(XM_PIDIV4 * 0.5f), 16.0f / 9.0f, 0.1f, 8.0f, false },
+		{ "slice sphere holds its corners (last cascade, clamped)", tanf(XM_PIDIV4 * 0.5f), 16.0f / 9.0f, 40.0f, 100.0f, true },
+		{ "slice sphere holds its corners (narrow view)", tanf(0.1f), 1.0f, 5.0f, 500.0f, false },
+		{ "slice sphere holds its corners (wide, thin, clamped)", tanf(1.2f), 2.0f, 10.0f, 10.5f, true },
+		{ "slice sphere holds its corners (wide, clamped)", tanf(1.0f), 16.0f / 9.0f, 20.0f, 60.0f, true },
+	};
+
+	XMMATRIX cameraWorld = XMMatrixMultiply(XMMatrixRotationRollPitchYaw(0.3f, -1.1f, 0.2f), XMMatrixTranslation(12.0f, 3.0f, -40.0f));
+	for (const SliceCase& c : cases)
+	{
+		float centerZ, radius;
+		GetFrustumSliceSphere(c.TanHalfFovY, c.Aspect, c.Near, c.Far, centerZ, radius);
+
+		XMFLOAT3 corners[8];
+		GetFrustumSliceCorners(c.TanHalfFovY, c.Aspect, c.Near, c.Far, cameraWorld, corners);
+		XMVECTOR center = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, centerZ, 1.0f), cameraWorld);
+
+		float furthest = 0.0f;
+		for (int i = 0; i < 8; i++)
+		{
+			XMFLOAT3 offset;
+			XMStoreFloat3(&offset, XMVectorSubtract(XMLoadFloat3(&corners[i]), center));
+			furthest = fmaxf(furthest, sqrtf(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z));
+		}
+
+		bool clamped = centerZ == c.Far;
+		bool holds = furthest <= radius * (1.0f + 1e-5f);
+		bool tight = furthest >= radius * (1.0f - 1e-4f);
+		Check(holds && tight && clamped == c.Clamped, c.Name);
+	}
+}
+
+// --------------------------------------------------------
+// Snapping: the center's texel in light space decides the
+// view, so moves inside a texel change nothing across the
+// light, and moves of any size step in whole texels
+// --------------------------------------------------------
+static void TestSnapping()
+{
+	const XMFLOAT3 lightDirection(0.4f, -1.0f, 0.7f);
+	const unsigned int resolution = 1024;
+	const float radius = 37.5f;
+	const float casterDistance = 50.0f;
+
+	ShadowCascade first = FitShadowCascade(XMFLOAT3(3.7f, 1.2f, -8.9f), radius, lightDirection, resolution, casterDistance);
+	float texelSize = 2.0f / (first.Projection._11 * resolution);
+
+	// The light's right and up in world space are the view's first two columns
+	XMVECTOR right = XMVectorSet(first.View._11, first.View._21, first.View._31, 0.0f);
+	XMVECTOR up = XMVectorSet(first.View._12, first.View._22, first.View._32, 0.0f);
+	XMVECTOR along = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+
+	// Start from the middle of a texel so small moves stay inside it
+	XMVECTOR start = XMVectorSet(3.7f, 1.2f, -8.9f, 1.0f);
+	XMFLOAT3 inView;
+	XMStoreFloat3(&inView, XMVector3TransformCoord(start, XMLoadFloat4x4(&first.View)));
+	start = XMVectorAdd(start, XMVectorAdd(
+		XMVectorScale(right, (0.5f * texelSize) - inView.x),
+		XMVectorScale(up, (0.5f * texelSize) - inView.y)));
+
+	XMFLOAT3 startCenter;
+	XMStoreFloat3(&startCenter, start);
+	ShadowCascade base = FitShadowCascade(startCenter, radius, lightDirection, resolution, casterDistance);
+
+	bool sameProjection = true;
+	bool sameAcross = true;
+	bool wholeTexels = true;
+	bool sphereInside = true;
+	const float moves[][3] =
+	{
+		{ 0.4f, 0.0f, 0.0f }, { -0.4f, 0.3f, 0.0f }, { 0.2f, -0.45f, 0.0f }, { 0.0f, 0.0f, 25.0f }, { -0.3f, 0.3f, -10.0f },
+	};
+	for (const auto& move : moves)
+	{
+		XMVECTOR moved = XMVectorAdd(start, XMVectorAdd(XMVectorAdd(
+			XMVectorScale(right, move[0] * texelSize),
+			XMVectorScale(up, move[1] * texelSize)),
+			XMVectorScale(along, move[2])));
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, moved);
+		ShadowCascade cascade = FitShadowCascade(center, radius, lightDirection, resolution, casterDistance);
+
+		for (int i = 0; i < 16; i++)
+			sameProjection = sameProjection && cascade.Projection.m[i / 4][i % 4] == base.Projection.m[i / 4][i % 4];
+
+		// Only depth can change when the move stays inside the texel
+		sameAcross = sameAcross &&
+			Close(cascade.View._41, base.View._41, 1e-5f) &&
+			Close(cascade.View._42, base.View._42, 1e-5f);
+	}
+
+	// Bigger moves, which should step the view by whole texels
+	// and keep the sphere inside the projection
+	for (int step = 1; step <= 50; step++)
+	{
+		XMVECTOR moved = XMVectorAdd(start, XMVectorAdd(
+			XMVectorScale(right, step * 0.37f * texelSize),
+			XMVectorScale(up, step * -1.73f * texelSize)));
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, moved);
+		ShadowCascade cascade = FitShadowCascade(center, radius, lightDirection, resolution, casterDistance);
+
+		float texelsX = (cascade.View._41 - base.View._41) / texelSize;
+		float texelsY = (cascade.View._42 - base.View._42) / texelSize;
+		wholeTexels = wholeTexels && fabsf(texelsX - roundf(texelsX)) < 0.01f && fabsf(texelsY - roundf(texelsY)) < 0.01f;
+
+		XMStoreFloat3(&center, XMVector3TransformCoord(moved, XMLoadFloat4x4(&cascade.View)));
+		float halfWidth = 1.0f / cascade.Projection._11;
+		sphereInside = sphereInside &&
+			fabsf(center.x) + radius <= halfWidth * (1.0f + 1e-5f) &&
+			fabsf(center.y) + radius <= halfWidth * (1.0f + 1e-5f);
+	}
+
+	Check(sameProjection, "moving the center leaves the projection unchanged");
+	Check(sameAcross, "moving the center within a texel leaves the view unchanged across the light");
+	Check(wholeTexels, "moving the center further steps the view in whole texels");
+	Check(sphereInside, "the snapped view still holds the whole sphere");
+}
+
+// --------------------------------------------------------
+// Coverage, with the game's defaults: receivers all over
+// each slice pick that slice's cascade by depth, land
+// inside its shadow map, and anything between them and the
+// light survives that cascade's caster culling.  Receivers
+// just past a split are inside the previous cascade's
+// square as well, and are where picking by square (instead
+// of depth) used to find an empty shadow map
+// --------------------------------------------------------
+static bool InsidePlanes(const XMFLOAT4* planes, XMVECTOR point)
+{
+	for (int p = 0; p < 6; p++)
+	{
+		if (XMVectorGetX(XMVector3Dot(XMLoadFloat4(&planes[p]), point)) + planes[p].w < -1e-3f)
+			return false;
+	}
+	return true;
+}
+
+static bool InsideShadowMap(const ShadowCascade& cascade, XMVECTOR point)
+{
+	XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&cascade.View), XMLoadFloat4x4(&cascade.Projection));
+	XMFLOAT3 inMap;
+	XMStoreFloat3(&inMap, XMVector3TransformCoord(point, viewProjection));
+	return fabsf(inMap.x) <= 1.0f && fabsf(inMap.y) <= 1.0f && inMap.z >= 0.0f && inMap.z <= 1.0f;
+}
+
+static void TestCoverage()
+{
+	const unsigned int cascadeCount = 3;
+	const float nearZ = 0.01f;
+	const float shadowDistance = 60.0f;
+	const float lambda = 0.75f;
+	const float casterDistance = 50.0f;
+	const unsigned int resolution = 1024;
+	const float tanHalfFovY = tanf(XM_PI / 6.0f);
+	const float aspect = 16.0f / 9.0f;
+	const XMFLOAT3 lightDirections[] = { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, -1.0f, -1.0f) };
+
+	float splits[MAX_SHADOW_CASCADES + 1];
+	ComputeCascadeSplits(nearZ, shadowDistance, cascadeCount, lambda, splits);
+
+	XMMATRIX cameraWorld = XMMatrixMultiply(XMMatrixRotationRollPitchYaw(0.4f, 0.7f, 0.0f), XMMatrixTranslation(-3.0f, 6.0f, -12.0f));
+	XMFLOAT3 corners[MAX_SHADOW_CASCADES][8];
+	XMFLOAT3 centers[MAX_SHADOW_CASCADES];
+	float radii[MAX_SHADOW_CASCADES];
+	for (unsigned int c = 0; c < cascadeCount; c++)
+	{
+		float centerZ;
+		GetFrustumSliceSphere(tanHalfFovY, aspect, splits[c], splits[c + 1], centerZ, radii[c]);
+		XMStoreFloat3(&centers[c], XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, centerZ, 1.0f), cameraWorld));
+		GetFrustumSliceCorners(tanHalfFovY, aspect, splits[c], splits[c + 1], cameraWorld, corners[c]);
+	}
+
+	bool rightCascade = true;
+	bool inShadowMap = true;
+	bool castersKept = true;
+	int nextSliceInPrevious = 0;
+	for (const XMFLOAT3& lightDirection : lightDirections)
+	{
+		ShadowCascade cascades[MAX_SHADOW_CASCADES];
+		XMFLOAT4 casterPlanes[MAX_SHADOW_CASCADES][6];
+		for (unsigned int c = 0; c < cascadeCount; c++)
+		{
+			cascades[c] = FitShadowCascade(centers[c], radii[c], lightDirection, resolution, casterDistance);
+			GetShadowCasterPlanes(cascades[c], corners[c], 8, casterPlanes[c]);
+		}
+		XMVECTOR towardLight = XMVectorNegate(XMVector3Normalize(XMLoadFloat3(&lightDirection)));
+
+		for (unsigned int c = 0; c < cascadeCount; c++)
+		{
+			// Just past the split, through the slice, and up to its end
+			float span = splits[c + 1] - splits[c];
+			const float depths[] = { splits[c] + span * 0.001f, splits[c] + span * 0.02f, splits[c] + span * 0.5f, splits[c + 1] };
+			for (float depth : depths)
+			{
+				for (int u = 0; u <= 4; u++)
+				{
+					for (int v = 0; v <= 4; v++)
+					{
+						float x = (u / 2.0f - 1.0f) * depth * tanHalfFovY * aspect;
+						float y = (v / 2.0f - 1.0f) * depth * tanHalfFovY;
+						XMVECTOR receiver = XMVector3TransformCoord(XMVectorSet(x, y, depth, 1.0f), cameraWorld);
+
+						unsigned int cascade = GetCascadeForDepth(splits, cascadeCount, depth);
+						rightCascade = rightCascade && cascade == c;
+						if (cascade >= cascadeCount)
+							continue;
+
+						if (c > 0 && InsideShadowMap(cascades[c - 1], receiver))
+							nextSliceInPrevious++;
+
+						inShadowMap = inShadowMap && InsideShadowMap(cascades[cascade], receiver);
+						const float casterOffsets[] = { 0.0f, 1.0f, 10.0f, 40.0f };
+						for (float offset : casterOffsets)
+						{
+							XMVECTOR caster = XMVectorAdd(receiver, XMVectorScale(towardLight, offset));
+							castersKept = castersKept && InsidePlanes(casterPlanes[cascade], caster);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	Check(rightCascade, "receivers pick the cascade for their slice by depth");
+	Check(GetCascadeForDepth(splits, cascadeCount, shadowDistance * 1.01f) == cascadeCount, "receivers past the last split pick no cascade");
+	Check(nextSliceInPrevious > 0, "some receivers past a split are inside the previous cascade's square too");
+	Check(inShadowMap, "receivers are inside their cascade's shadow map");
+	Check(castersKept, "casters between a receiver and the light survive its cascade's culling");
+}
+
+int main()
+{
+	TestSplits();
+	TestSliceSpheres();
+	TestSnapping();
+	TestCoverage();
+
+	return TestResult();
+}
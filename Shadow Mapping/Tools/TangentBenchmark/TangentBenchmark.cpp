@@ -0,0 +1,196 @@
+// --------------------------------------------------------
+// TangentBenchmark - times the original one triangle at a
+// time tangent loop against CalculateTangents (4 triangles
+// per SIMD pass, split across threads for big meshes), and
+// reports how far apart their tangents end up.
+//
+// Usage:
+//   TangentBenchmark [triangles] [runs]
+//   (defaults: 400000 triangles, 20 runs)
+//
+// The mesh is a bumpy grid with shared vertices, so vertices
+// collect tangents from several triangles like a real mesh.
+// Builds with the game's tangent code:
+//   cl /std:c++17 /O2 /EHsc /I..\.. TangentBenchmark.cpp ..\..\MeshTangents.cpp
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "MeshTangents.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// The loop Mesh::CalculateTangents used before it was
+// vectorized, kept here as the reference
+// --------------------------------------------------------
+static void CalculateTangentsScalar(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	for (int i = 0; i < numVerts; i++)
+		verts[i].Tangent = XMFLOAT3(0, 0, 0);
+
+	for (int i = 0; i < numIndices;)
+	{
+		Vertex* v1 = &verts[indices[i++]];
+		Vertex* v2 = &verts[indices[i++]];
+		Vertex* v3 = &verts[indices[i++]];
+
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		float r = 1.0f / (s1 * t2 - s2 * t1);
+
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+
+		v1->Tangent.x += tx; v1->Tangent.y += ty; v1->Tangent.z += tz;
+		v2->Tangent.x += tx; v2->Tangent.y += ty; v2->Tangent.z += tz;
+		v3->Tangent.x += tx; v3->Tangent.y += ty; v3->Tangent.z += tz;
+	}
+
+	for (int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+		tangent = XMVector3Normalize(tangent - normal * XMVector3Dot(normal, tangent));
+		XMStoreFloat3(&verts[i].Tangent, tangent);
+	}
+}
+
+// A grid with a bump in it, of at least the given number of triangles
+static void MakeGrid(size_t triangleCount, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	unsigned int quadsPerSide = (unsigned int)ceil(sqrt((double)triangleCount / 2.0));
+	unsigned int vertsPerSide = quadsPerSide + 1;
+
+	verts.resize((size_t)vertsPerSide * vertsPerSide);
+	for (unsigned int z = 0; z < vertsPerSide; z++)
+	{
+		for (unsigned int x = 0; x < vertsPerSide; x++)
+		{
+			float u = (float)x / quadsPerSide;
+			float v = (float)z / quadsPerSide;
+
+			Vertex& vert = verts[(size_t)z * vertsPerSide + x];
+			vert.Position = XMFLOAT3(u * 100.0f, sinf(u * 20.0f) * cosf(v * 20.0f), v * 100.0f);
+			vert.UV = XMFLOAT2(u * 4.0f, v * 4.0f);
+
+			XMVECTOR normal = XMVector3Normalize(XMVectorSet(-cosf(u * 20.0f) * cosf(v * 20.0f) * 0.2f, 1.0f, sinf(u * 20.0f) * sinf(v * 20.0f) * 0.2f, 0.0f));
+			XMStoreFloat3(&vert.Normal, normal);
+			vert.Tangent = XMFLOAT3(0, 0, 0);
+		}
+	}
+
+	indices.clear();
+	indices.reserve((size_t)quadsPerSide * quadsPerSide * 6);
+	for (unsigned int z = 0; z < quadsPerSide; z++)
+	{
+		for (unsigned int x = 0; x < quadsPerSide; x++)
+		{
+			unsigned int a = z * vertsPerSide + x;
+			unsigned int b = a + 1;
+			unsigned int c = a + vertsPerSide;
+			unsigned int d = c + 1;
+			indices.insert(indices.end(), { a, c, b, b, c, d });
+		}
+	}
+}
+
+// Largest difference in any tangent component
+static float MaxDifference(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+{
+	float maxDifference = 0.0f;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		maxDifference = fmaxf(maxDifference, fabsf(a[i].Tangent.x - b[i].Tangent.x));
+		maxDifference = fmaxf(maxDifference, fabsf(a[i].Tangent.y - b[i].Tangent.y));
+		maxDifference = fmaxf(maxDifference, fabsf(a[i].Tangent.z - b[i].Tangent.z));
+	}
+	return maxDifference;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t triangleCount = argc > 1 ? (size_t)atoll(argv[1]) : 400000;
+	unsigned int runCount = argc > 2 ? (unsigned int)atoi(argv[2]) : 20;
+	if (triangleCount == 0 || runCount == 0)
+	{
+		printf("Usage: TangentBenchmark [triangles] [runs]\n");
+		return 1;
+	}
+
+	std::vector<Vertex> source;
+	std::vector<unsigned int> indices;
+	MakeGrid(triangleCount, source, indices);
+	int vertexCount = (int)source.size();
+	int indexCount = (int)indices.size();
+	printf("%d vertices, %d triangles, %u runs\n\n", vertexCount, indexCount / 3, runCount);
+
+	std::vector<Vertex> reference = source;
+	CalculateTangentsScalar(&reference[0], vertexCount, &indices[0], indexCount);
+
+	struct Variant
+	{
+		const char* Name;
+		unsigned int Threads;	// 0 is the scalar reference
+	};
+	unsigned int cores = (std::max)(1u, std::thread::hardware_concurrency());
+	const Variant variants[] =
+	{
+		{ "Scalar (original)", 0 },
+		{ "SIMD, 1 thread", 1 },
+		{ "SIMD, all cores", cores },
+	};
+
+	printf("%-20s %8s %12s %12s %8s %14s\n", "Version", "Threads", "Best", "Average", "Speedup", "Max difference");
+
+	double scalarBest = 0;
+	std::vector<Vertex> verts;
+	for (const Variant& variant : variants)
+	{
+		double best = 1e30;
+		double total = 0;
+		for (unsigned int run = 0; run < runCount; run++)
+		{
+			verts = source;
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			if (variant.Threads == 0)
+				CalculateTangentsScalar(&verts[0], vertexCount, &indices[0], indexCount);
+			else
+				CalculateTangents(&verts[0], vertexCount, &indices[0], indexCount, variant.Threads);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			best = ms < best ? ms : best;
+			total += ms;
+		}
+
+		if (variant.Threads == 0)
+			scalarBest = best;
+
+		printf("%-20s %8u %9.3f ms %9.3f ms %7.2fx %14g\n",
+			variant.Name, variant.Threads > 0 ? variant.Threads : 1,
+			best, total / runCount, scalarBest / best,
+			MaxDifference(verts, reference));
+	}
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// --------------------------------------------------------
+// TestCheck - the pass/fail reporting the test programs
+// under Tools share.  Each check prints one line, and main
+// ends with "return TestResult();" so the exit code says
+// whether any of them failed.
+// --------------------------------------------------------
+
+#include <cstdio>
+
+// Checks that have failed so far
+inline int& TestFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline void Check(bool passed, const char* what)
+{
+	printf("%s  %s\n", passed ? "pass" : "FAIL", what);
+	TestFailures() += passed ? 0 : 1;
+}
+
+// Reports how many checks failed, giving the exit code for main
+inline int TestResult()
+{
+	if (TestFailures() > 0)
+		printf("%d checks failed\n", TestFailures());
+	return TestFailures() > 0 ? 1 : 0;
+}
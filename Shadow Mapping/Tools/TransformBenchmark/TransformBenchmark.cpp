@@ -0,0 +1,129 @@
+// --------------------------------------------------------
+// TransformBenchmark - times TransformSystem::UpdateMatrices
+// on the two hierarchy shapes that stress it most: one deep
+// chain (every transform parented to the one before) and one
+// wide fan (every transform parented to the same root).
+//
+// Usage:
+//   TransformBenchmark [depth] [width] [frames]
+//   (defaults: 1000 levels deep, 100000 children wide, 200 frames)
+//
+// Each shape is timed with only the root moving (everything
+// below has to follow), only one leaf moving, and everything
+// moving, and the leaves' world positions are checked against
+// what the chain of offsets says they should be.  Builds with
+// the game's transforms:
+//   cl /std:c++17 /O2 /EHsc /I..\.. TransformBenchmark.cpp ..\..\Transform.cpp ..\..\TransformSystem.cpp
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "Transform.h"
+#include "TransformSystem.h"
+
+// Per-frame time of UpdateMatrices() after calling move(frame)
+template<typename Move>
+static void TimeUpdates(const char* shape, const char* what, unsigned int frameCount, Move move)
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	system.UpdateMatrices();
+
+	double total = 0;
+	double best = 1e30;
+	for (unsigned int frame = 0; frame < frameCount; frame++)
+	{
+		move(frame);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		system.UpdateMatrices();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		total += ms;
+		best = ms < best ? ms : best;
+	}
+
+	printf("%-6s %-18s %10u %9.3f ms %9.3f ms\n", shape, what, system.GetLastUpdateCount(), best, total / frameCount);
+}
+
+// Whether a world position is where it should be, give or take float error
+static bool CloseTo(DirectX::XMFLOAT4X4 world, float x, float y, float z)
+{
+	float tolerance = 1e-3f * (1.0f + fabsf(x) + fabsf(y) + fabsf(z));
+	return fabsf(world._41 - x) <= tolerance && fabsf(world._42 - y) <= tolerance && fabsf(world._43 - z) <= tolerance;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int depth = argc > 1 ? (unsigned int)atoi(argv[1]) : 1000;
+	unsigned int width = argc > 2 ? (unsigned int)atoi(argv[2]) : 100000;
+	unsigned int frameCount = argc > 3 ? (unsigned int)atoi(argv[3]) : 200;
+	if (depth < 2 || width == 0 || frameCount == 0)
+	{
+		printf("Usage: TransformBenchmark [depth] [width] [frames]\n");
+		return 1;
+	}
+
+	printf("%-6s %-18s %10s %12s %12s\n", "Shape", "Moving", "Updated", "Best", "Average");
+	int failures = 0;
+
+	// Deep: each level sits one unit above its parent
+	{
+		std::vector<std::unique_ptr<Transform>> chain;
+		for (unsigned int i = 0; i < depth; i++)
+		{
+			chain.push_back(std::make_unique<Transform>());
+			if (i > 0)
+			{
+				chain[i]->SetParent(chain[i - 1].get());
+				chain[i]->SetPosition(0.0f, 1.0f, 0.0f);
+			}
+		}
+		Transform* root = chain.front().get();
+		Transform* leaf = chain.back().get();
+
+		TimeUpdates("Deep", "root", frameCount, [&](unsigned int frame) { root->SetPosition((float)frame, 0.0f, 0.0f); });
+		failures += CloseTo(leaf->GetWorldMatrix(), (float)(frameCount - 1), (float)(depth - 1), 0.0f) ? 0 : 1;
+
+		TimeUpdates("Deep", "leaf", frameCount, [&](unsigned int frame) { leaf->SetPosition(0.0f, 1.0f, (float)frame); });
+		failures += CloseTo(leaf->GetWorldMatrix(), (float)(frameCount - 1), (float)(depth - 1), (float)(frameCount - 1)) ? 0 : 1;
+
+		TimeUpdates("Deep", "every level", frameCount, [&](unsigned int frame)
+			{
+				for (auto& t : chain)
+					t->SetScale(1.0f, 1.0f + (frame % 2) * 1e-6f, 1.0f);
+			});
+	}
+
+	// Wide: every child sits one unit out along x, at its own height
+	{
+		Transform root;
+		std::vector<std::unique_ptr<Transform>> children;
+		for (unsigned int i = 0; i < width; i++)
+		{
+			children.push_back(std::make_unique<Transform>());
+			children[i]->SetParent(&root);
+			children[i]->SetPosition(1.0f, (float)i, 0.0f);
+		}
+
+		TimeUpdates("Wide", "root", frameCount, [&](unsigned int frame) { root.SetPosition(0.0f, 0.0f, (float)frame); });
+		for (unsigned int i = 0; i < width; i += (width / 16) + 1)
+			failures += CloseTo(children[i]->GetWorldMatrix(), 1.0f, (float)i, (float)(frameCount - 1)) ? 0 : 1;
+
+		TimeUpdates("Wide", "one child", frameCount, [&](unsigned int frame) { children[frame % width]->SetRotation(0.0f, frame * 0.01f, 0.0f); });
+
+		TimeUpdates("Wide", "every child", frameCount, [&](unsigned int frame)
+			{
+				for (auto& t : children)
+					t->SetRotation(0.0f, frame * 0.01f, 0.0f);
+			});
+	}
+
+	if (failures > 0)
+		printf("%d world positions were wrong\n", failures);
+	return failures > 0 ? 1 : 0;
+}
@@ -1,78 +1,148 @@
 #include "Transform.h"
+#include "TransformSystem.h"
+#include <algorithm>
+#include <cmath>
 
 using namespace DirectX;
 
 Transform::Transform()
 {
-	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
-	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixIdentity());
-	
-	position = XMFLOAT3(0, 0, 0);
-	rotation = XMFLOAT3(0, 0, 0);
-	scale = XMFLOAT3(1, 1, 1);
+	slot = TransformSystem::GetInstance().Allocate(this);
 
+	orientation = XMFLOAT4(0, 0, 0, 1);
 	right = XMFLOAT3(1, 0, 0);
 	up = XMFLOAT3(0, 1, 0);
 	forward = XMFLOAT3(0, 0, 1);
 
-	isWorldMatrixDirty = false; 
 	isRotated = false;
 }
 
-Transform::~Transform() {}
+//copies get their own slot, since a slot belongs to exactly one transform,
+//and end up as a sibling of the original
+Transform::Transform(const Transform& other)
+	: Transform()
+{
+	*this = other;
+}
+
+Transform& Transform::operator=(const Transform& other)
+{
+	if (this != &other)
+	{
+		TransformSystem& system = TransformSystem::GetInstance();
+		system.SetPosition(slot, system.GetPosition(other.slot));
+		system.SetPitchYawRoll(slot, system.GetPitchYawRoll(other.slot));
+		system.SetScale(slot, system.GetScale(other.slot));
+		system.SetParent(slot, system.GetParent(other.slot));
+
+		orientation = other.orientation;
+		right = other.right;
+		up = other.up;
+		forward = other.forward;
+		isRotated = other.isRotated;
+	}
+
+	return *this;
+}
+
+Transform::~Transform()
+{
+	TransformSystem::GetInstance().Free(slot);
+}
+
+bool Transform::SetParent(Transform* parent)
+{
+	return TransformSystem::GetInstance().SetParent(slot, parent ? parent->slot : TransformSystem::NoSlot);
+}
+
+Transform* Transform::GetParent()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	unsigned int parent = system.GetParent(slot);
+	return parent == TransformSystem::NoSlot ? nullptr : system.GetOwner(parent);
+}
 
 void Transform::SetPosition(float x, float y, float z)
 {
-	isWorldMatrixDirty = true;
-	position = XMFLOAT3(x, y, z);
+	TransformSystem::GetInstance().SetPosition(slot, XMFLOAT3(x, y, z));
 }
 
 void Transform::SetRotation(float pitch, float yaw, float roll)
 {
 	isRotated = true;
-	isWorldMatrixDirty = true;
-	rotation = XMFLOAT3(pitch, yaw, roll);
+	TransformSystem::GetInstance().SetPitchYawRoll(slot, XMFLOAT3(pitch, yaw, roll));
+}
+
+//keeps the quaternion as given, and stores matching Euler angles for the matrices
+void Transform::SetRotation(XMFLOAT4 quaternion)
+{
+	XMVECTOR rot = XMQuaternionNormalize(XMLoadFloat4(&quaternion));
+	XMMATRIX basis = XMMatrixRotationQuaternion(rot);
+
+	XMFLOAT3X3 m;
+	XMStoreFloat3x3(&m, basis);
+
+	//inverse of the roll-pitch-yaw matrix: m[2][1] is -sin(pitch)
+	float pitch = asinf((std::max)(-1.0f, (std::min)(1.0f, -m._32)));
+	float yaw, roll;
+	if (fabsf(m._32) < 0.9999f)
+	{
+		yaw = atan2f(m._31, m._33);
+		roll = atan2f(m._12, m._22);
+	}
+	else
+	{
+		//looking straight up or down, so yaw and roll spin the same axis
+		yaw = atan2f(-m._13, m._11);
+		roll = 0.0f;
+	}
+	TransformSystem::GetInstance().SetPitchYawRoll(slot, XMFLOAT3(pitch, yaw, roll));
+
+	XMStoreFloat4(&orientation, rot);
+	XMStoreFloat3(&right, basis.r[0]);
+	XMStoreFloat3(&up, basis.r[1]);
+	XMStoreFloat3(&forward, basis.r[2]);
+	isRotated = false;
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
-	isWorldMatrixDirty = true;
-	scale = XMFLOAT3(x, y, z);
+	TransformSystem::GetInstance().SetScale(slot, XMFLOAT3(x, y, z));
 }
 
 XMFLOAT3 Transform::GetPosition()
 {
-	return position;
+	return TransformSystem::GetInstance().GetPosition(slot);
 }
 
 XMFLOAT3 Transform::GetPitchYawRoll()
 {
-	return rotation;
+	return TransformSystem::GetInstance().GetPitchYawRoll(slot);
 }
 
 XMFLOAT3 Transform::GetScale()
 {
-	return scale;
+	return TransformSystem::GetInstance().GetScale(slot);
 }
 
+//rebuilt in TransformSystem::UpdateMatrices (or right here if still dirty)
 XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	if (isWorldMatrixDirty)
-	{
-		UpdateMatrices();
-	}
-
-	return worldMatrix;
+	return TransformSystem::GetInstance().GetWorldMatrix(slot);
 }
 
 XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
-	if (isWorldMatrixDirty)
+	return TransformSystem::GetInstance().GetWorldInverseTransposeMatrix(slot);
+}
+
+XMFLOAT4 Transform::GetRotation()
+{
+	if (isRotated)
 	{
-		UpdateMatrices();
+		UpdateOrientation();
 	}
-
-	return worldInverseTransposeMatrix;
+	return orientation;
 }
 
 XMFLOAT3 Transform::GetRight()
@@ -104,64 +174,64 @@ XMFLOAT3 Transform::GetForward()
 
 void Transform::MoveAbsolute(float x, float y, float z)
 {
-	isWorldMatrixDirty = true;
+	XMFLOAT3 position = GetPosition();
 	XMVECTOR pos = XMLoadFloat3(&position);
 	pos = XMVectorAdd(pos, XMVectorSet(x, y, z, 0.0f));
 	XMStoreFloat3(&position, pos);
+	TransformSystem::GetInstance().SetPosition(slot, position);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	//convert Euler Angles to Quaternion
-	XMVECTOR rot = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation));
+	if (isRotated)
+	{
+		UpdateOrientation();
+	}
+
+	//relative movement to add to position, along the cached basis
+	XMVECTOR relVec = XMVectorScale(XMLoadFloat3(&right), x);
+	relVec = XMVectorMultiplyAdd(XMVectorReplicate(y), XMLoadFloat3(&up), relVec);
+	relVec = XMVectorMultiplyAdd(XMVectorReplicate(z), XMLoadFloat3(&forward), relVec);
 
-	//relative movement to add to position
-	XMVECTOR relVec = XMVector3Rotate(XMVectorSet(x, y, z, 1), rot);
-	
 	//updating position
+	XMFLOAT3 position = GetPosition();
 	XMStoreFloat3(&position, XMVectorAdd(XMLoadFloat3(&position), relVec));
+	TransformSystem::GetInstance().SetPosition(slot, position);
 }
 
 void Transform::Rotate(float pitch, float yaw, float roll)
 {
 	isRotated = true;
-	isWorldMatrixDirty = true;
+	XMFLOAT3 rotation = GetPitchYawRoll();
 	XMVECTOR rot = XMLoadFloat3(&rotation);
 	rot = XMVectorAdd(rot, XMVectorSet(pitch, yaw, roll, 0.0f));
 	XMStoreFloat3(&rotation, rot);
+	TransformSystem::GetInstance().SetPitchYawRoll(slot, rotation);
 }
 
 void Transform::Scale(float x, float y, float z)
 {
-	isWorldMatrixDirty = true;
+	XMFLOAT3 scale = GetScale();
 	XMVECTOR sc = XMLoadFloat3(&scale);
 	sc = XMVectorMultiply(sc, XMVectorSet(x, y, z, 0.0f));
 	XMStoreFloat3(&scale, sc);
+	TransformSystem::GetInstance().SetScale(slot, scale);
 }
 
-void Transform::UpdateMatrices()
-{
-	XMMATRIX transMat = XMMatrixTranslationFromVector(XMLoadFloat3(&position));
-	XMMATRIX rotMat = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&rotation));
-	XMMATRIX scaleMat = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
-
-	XMMATRIX world = scaleMat * rotMat * transMat;
-
-	XMStoreFloat4x4(&worldMatrix, world);
-	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(world)));
-	
-	isWorldMatrixDirty = false;
-}
-
+//the only place Euler angles get turned into a quaternion
 void Transform::UpdateOrientation()
 {
+	XMFLOAT3 rotation = GetPitchYawRoll();
+
 	//convert Euler Angles to Quaternion
 	XMVECTOR rot = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation));
+	XMStoreFloat4(&orientation, rot);
 
-	//Update orientation vectors
-	XMStoreFloat3(&right, XMVector3Rotate(XMVectorSet(1, 0, 0,0), rot));
-	XMStoreFloat3(&up, XMVector3Rotate(XMVectorSet(0, 1, 0, 0), rot));
-	XMStoreFloat3(&forward, XMVector3Rotate(XMVectorSet(0, 0, 1, 0), rot));
+	//the rows of the rotation matrix are the rotated axes
+	XMMATRIX basis = XMMatrixRotationQuaternion(rot);
+	XMStoreFloat3(&right, basis.r[0]);
+	XMStoreFloat3(&up, basis.r[1]);
+	XMStoreFloat3(&forward, basis.r[2]);
 
 	isRotated = false;
 }
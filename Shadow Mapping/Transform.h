@@ -5,11 +5,20 @@ class Transform
 {
 public:
 	Transform();
+	Transform(const Transform& other);
+	Transform& operator=(const Transform& other);
 	~Transform();
 	
+	//Hierarchy (nullptr detaches). Position, rotation and scale are
+	//relative to the parent; the world matrix includes every ancestor.
+	//Returns false if the parent is this transform or one of its children.
+	bool SetParent(Transform* parent);
+	Transform* GetParent();
+
 	//Setters
 	void SetPosition(float x, float y, float z);
 	void SetRotation(float pitch, float yaw, float roll);
+	void SetRotation(DirectX::XMFLOAT4 quaternion);
 	void SetScale(float x, float y, float z);
 
 	//Getters
@@ -19,6 +28,8 @@ public:
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
 
+	DirectX::XMFLOAT4 GetRotation(); //orientation quaternion
+
 	DirectX::XMFLOAT3 GetRight();
 	DirectX::XMFLOAT3 GetUp();
 	DirectX::XMFLOAT3 GetForward();
@@ -30,20 +41,17 @@ public:
 	void Scale(float x, float y, float z);
 
 private:
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 rotation;
-	DirectX::XMFLOAT3 scale;
+	//position, rotation, scale and matrices live in the TransformSystem
+	unsigned int slot;
 	
+	//cached from the Euler angles, and only rebuilt after they change
+	DirectX::XMFLOAT4 orientation;
 	DirectX::XMFLOAT3 right;
 	DirectX::XMFLOAT3 up;
 	DirectX::XMFLOAT3 forward;
 
-	bool isWorldMatrixDirty; //true if matrix needs to be updated.
-	bool isRotated; //true if only rotation has been updated.
+	bool isRotated; //true if the rotation changed since the cache was built
 
-	void UpdateMatrices();
 	void UpdateOrientation();
 };
 
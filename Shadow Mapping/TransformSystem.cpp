@@ -0,0 +1,464 @@
+#include "TransformSystem.h"
+
+using namespace DirectX;
+
+TransformSystem* TransformSystem::instance;
+
+namespace
+{
+	void SetBit(std::vector<unsigned long long>& bits, unsigned int index)
+	{
+		bits[index / 64] |= 1ull << (index % 64);
+	}
+
+	void ClearBit(std::vector<unsigned long long>& bits, unsigned int index)
+	{
+		bits[index / 64] &= ~(1ull << (index % 64));
+	}
+
+	bool TestBit(const std::vector<unsigned long long>& bits, unsigned int index)
+	{
+		return (bits[index / 64] >> (index % 64)) & 1;
+	}
+}
+
+TransformSystem::TransformSystem()
+{
+	slotCount = 0;
+	lastUpdateCount = 0;
+	hierarchyChanged = false;
+	pendingChanges = false;
+}
+
+TransformSystem::~TransformSystem() {}
+
+unsigned int TransformSystem::Allocate(Transform* owner)
+{
+	if (freeSlots.empty())
+		Grow();
+
+	unsigned int slot = freeSlots.back();
+	freeSlots.pop_back();
+
+	positionX[slot] = positionY[slot] = positionZ[slot] = 0.0f;
+	pitch[slot] = yaw[slot] = roll[slot] = 0.0f;
+	scaleX[slot] = scaleY[slot] = scaleZ[slot] = 1.0f;
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	localMatrices[slot] = localInverseTransposeMatrices[slot] = identity;
+	worldMatrices[slot] = worldInverseTransposeMatrices[slot] = identity;
+
+	owners[slot] = owner;
+	parents[slot] = firstChildren[slot] = NoSlot;
+	nextSiblings[slot] = previousSiblings[slot] = NoSlot;
+	worldVersions[slot] = parentVersions[slot] = 0;
+
+	ClearBit(dirty, slot);
+	ClearBit(worldStale, slot);
+	SetBit(live, slot);
+
+	//a new root only needs adding to the order, its matrices are already right
+	hierarchyChanged = true;
+	pendingChanges = true;
+
+	return slot;
+}
+
+void TransformSystem::Free(unsigned int slot)
+{
+	//orphan the children, keeping their local values
+	while (firstChildren[slot] != NoSlot)
+	{
+		unsigned int child = firstChildren[slot];
+		Detach(child);
+		SetBit(worldStale, child);
+	}
+	Detach(slot);
+
+	ClearBit(dirty, slot);
+	ClearBit(worldStale, slot);
+	ClearBit(live, slot);
+	owners[slot] = nullptr;
+	freeSlots.push_back(slot);
+
+	hierarchyChanged = true;
+	pendingChanges = true;
+}
+
+bool TransformSystem::SetParent(unsigned int slot, unsigned int parent)
+{
+	if (parents[slot] == parent)
+		return true;
+
+	//a slot can't end up under itself
+	for (unsigned int ancestor = parent; ancestor != NoSlot; ancestor = parents[ancestor])
+	{
+		if (ancestor == slot)
+			return false;
+	}
+
+	Detach(slot);
+
+	if (parent != NoSlot)
+	{
+		parents[slot] = parent;
+		nextSiblings[slot] = firstChildren[parent];
+		if (firstChildren[parent] != NoSlot)
+			previousSiblings[firstChildren[parent]] = slot;
+		firstChildren[parent] = slot;
+	}
+
+	SetBit(worldStale, slot);
+	hierarchyChanged = true;
+	pendingChanges = true;
+	return true;
+}
+
+unsigned int TransformSystem::GetParent(unsigned int slot)
+{
+	return parents[slot];
+}
+
+Transform* TransformSystem::GetOwner(unsigned int slot)
+{
+	return owners[slot];
+}
+
+void TransformSystem::SetPosition(unsigned int slot, XMFLOAT3 position)
+{
+	positionX[slot] = position.x;
+	positionY[slot] = position.y;
+	positionZ[slot] = position.z;
+	MarkDirty(slot);
+}
+
+void TransformSystem::SetPitchYawRoll(unsigned int slot, XMFLOAT3 rotation)
+{
+	pitch[slot] = rotation.x;
+	yaw[slot] = rotation.y;
+	roll[slot] = rotation.z;
+	MarkDirty(slot);
+}
+
+void TransformSystem::SetScale(unsigned int slot, XMFLOAT3 scale)
+{
+	scaleX[slot] = scale.x;
+	scaleY[slot] = scale.y;
+	scaleZ[slot] = scale.z;
+	MarkDirty(slot);
+}
+
+XMFLOAT3 TransformSystem::GetPosition(unsigned int slot)
+{
+	return XMFLOAT3(positionX[slot], positionY[slot], positionZ[slot]);
+}
+
+XMFLOAT3 TransformSystem::GetPitchYawRoll(unsigned int slot)
+{
+	return XMFLOAT3(pitch[slot], yaw[slot], roll[slot]);
+}
+
+XMFLOAT3 TransformSystem::GetScale(unsigned int slot)
+{
+	return XMFLOAT3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldMatrix(unsigned int slot)
+{
+	if (pendingChanges)
+		UpdateAncestors(slot);
+
+	return worldMatrices[slot];
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldInverseTransposeMatrix(unsigned int slot)
+{
+	if (pendingChanges)
+		UpdateAncestors(slot);
+
+	return worldInverseTransposeMatrices[slot];
+}
+
+// --------------------------------------------------------
+// Two passes:
+// - Walks the dirty bitset a word at a time, skipping clean
+//   words entirely, and rebuilds the local matrices of each
+//   group of 4 slots that has anything dirty in it
+// - Sweeps the hierarchy order front to back.  Parents are
+//   always done by the time their children are reached, so
+//   one pass settles every world matrix with no recursion
+// --------------------------------------------------------
+void TransformSystem::UpdateMatrices()
+{
+	lastUpdateCount = 0;
+
+	if (!pendingChanges)
+		return;
+
+	for (size_t word = 0; word < dirty.size(); word++)
+	{
+		while (dirty[word])
+		{
+			// Lowest dirty bit, rounded down to its group of 4
+			unsigned long long bits = dirty[word];
+			unsigned int bit = 0;
+			while (!(bits & (1ull << bit)))
+				bit++;
+
+			UpdateGroup((unsigned int)(word * 64) + (bit & ~3u));
+		}
+	}
+
+	if (hierarchyChanged)
+		RebuildHierarchyOrder();
+
+	for (unsigned int slot : hierarchyOrder)
+	{
+		if (NeedsWorldUpdate(slot))
+		{
+			UpdateWorld(slot);
+			lastUpdateCount++;
+		}
+	}
+
+	pendingChanges = false;
+}
+
+unsigned int TransformSystem::GetLastUpdateCount()
+{
+	return lastUpdateCount;
+}
+
+void TransformSystem::MarkDirty(unsigned int slot)
+{
+	SetBit(dirty, slot);
+	pendingChanges = true;
+}
+
+bool TransformSystem::IsDirty(unsigned int slot)
+{
+	return TestBit(dirty, slot);
+}
+
+bool TransformSystem::NeedsWorldUpdate(unsigned int slot)
+{
+	unsigned int parent = parents[slot];
+	return TestBit(worldStale, slot) ||
+		(parent != NoSlot && parentVersions[slot] != worldVersions[parent]);
+}
+
+// Unlinks a slot from its parent (if any), making it a root
+void TransformSystem::Detach(unsigned int slot)
+{
+	unsigned int parent = parents[slot];
+	if (parent == NoSlot)
+		return;
+
+	if (previousSiblings[slot] != NoSlot)
+		nextSiblings[previousSiblings[slot]] = nextSiblings[slot];
+	else
+		firstChildren[parent] = nextSiblings[slot];
+
+	if (nextSiblings[slot] != NoSlot)
+		previousSiblings[nextSiblings[slot]] = previousSiblings[slot];
+
+	parents[slot] = nextSiblings[slot] = previousSiblings[slot] = NoSlot;
+	hierarchyChanged = true;
+}
+
+// Adds another 64 slots to every array
+void TransformSystem::Grow()
+{
+	unsigned int newCount = slotCount + 64;
+
+	positionX.resize(newCount, 0.0f);
+	positionY.resize(newCount, 0.0f);
+	positionZ.resize(newCount, 0.0f);
+	pitch.resize(newCount, 0.0f);
+	yaw.resize(newCount, 0.0f);
+	roll.resize(newCount, 0.0f);
+	scaleX.resize(newCount, 1.0f);
+	scaleY.resize(newCount, 1.0f);
+	scaleZ.resize(newCount, 1.0f);
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	localMatrices.resize(newCount, identity);
+	localInverseTransposeMatrices.resize(newCount, identity);
+	worldMatrices.resize(newCount, identity);
+	worldInverseTransposeMatrices.resize(newCount, identity);
+
+	owners.resize(newCount, nullptr);
+	parents.resize(newCount, NoSlot);
+	firstChildren.resize(newCount, NoSlot);
+	nextSiblings.resize(newCount, NoSlot);
+	previousSiblings.resize(newCount, NoSlot);
+	worldVersions.resize(newCount, 0);
+	parentVersions.resize(newCount, 0);
+
+	dirty.push_back(0);
+	worldStale.push_back(0);
+	live.push_back(0);
+
+	// Hand out the lowest slots first so live transforms stay packed
+	for (unsigned int slot = newCount; slot > slotCount; slot--)
+		freeSlots.push_back(slot - 1);
+
+	slotCount = newCount;
+}
+
+// --------------------------------------------------------
+// Rebuilds the local matrices of 4 neighboring slots at once,
+// with each SIMD lane handling one slot.
+//
+// - Local is scale * rotation * translation, with rotation
+//   built the same way as XMMatrixRotationRollPitchYaw
+// - The inverse transpose is found analytically rather than
+//   with a general inverse: the upper 3x3 is scale^-1 * rotation,
+//   so each row is just a rotation row divided by its scale
+// --------------------------------------------------------
+void TransformSystem::UpdateGroup(unsigned int firstSlot)
+{
+	XMVECTOR sinPitch, cosPitch, sinYaw, cosYaw, sinRoll, cosRoll;
+	XMVectorSinCos(&sinPitch, &cosPitch, XMLoadFloat4((const XMFLOAT4*)&pitch[firstSlot]));
+	XMVectorSinCos(&sinYaw, &cosYaw, XMLoadFloat4((const XMFLOAT4*)&yaw[firstSlot]));
+	XMVectorSinCos(&sinRoll, &cosRoll, XMLoadFloat4((const XMFLOAT4*)&roll[firstSlot]));
+
+	XMVECTOR px = XMLoadFloat4((const XMFLOAT4*)&positionX[firstSlot]);
+	XMVECTOR py = XMLoadFloat4((const XMFLOAT4*)&positionY[firstSlot]);
+	XMVECTOR pz = XMLoadFloat4((const XMFLOAT4*)&positionZ[firstSlot]);
+	XMVECTOR sx = XMLoadFloat4((const XMFLOAT4*)&scaleX[firstSlot]);
+	XMVECTOR sy = XMLoadFloat4((const XMFLOAT4*)&scaleY[firstSlot]);
+	XMVECTOR sz = XMLoadFloat4((const XMFLOAT4*)&scaleZ[firstSlot]);
+
+	// Rotation matrix, one element per register
+	XMVECTOR sinRollSinPitch = XMVectorMultiply(sinRoll, sinPitch);
+	XMVECTOR cosRollSinPitch = XMVectorMultiply(cosRoll, sinPitch);
+
+	XMVECTOR r00 = XMVectorMultiplyAdd(sinRollSinPitch, sinYaw, XMVectorMultiply(cosRoll, cosYaw));
+	XMVECTOR r01 = XMVectorMultiply(sinRoll, cosPitch);
+	XMVECTOR r02 = XMVectorNegativeMultiplySubtract(cosRoll, sinYaw, XMVectorMultiply(sinRollSinPitch, cosYaw));
+	XMVECTOR r10 = XMVectorNegativeMultiplySubtract(sinRoll, cosYaw, XMVectorMultiply(cosRollSinPitch, sinYaw));
+	XMVECTOR r11 = XMVectorMultiply(cosRoll, cosPitch);
+	XMVECTOR r12 = XMVectorMultiplyAdd(cosRollSinPitch, cosYaw, XMVectorMultiply(sinRoll, sinYaw));
+	XMVECTOR r20 = XMVectorMultiply(cosPitch, sinYaw);
+	XMVECTOR r21 = XMVectorNegate(sinPitch);
+	XMVECTOR r22 = XMVectorMultiply(cosPitch, cosYaw);
+
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+
+	// Each transpose turns "one element from 4 slots" into
+	// "one row for each of the 4 slots"
+	XMMATRIX localRow0 = XMMatrixTranspose(XMMATRIX(
+		XMVectorMultiply(r00, sx), XMVectorMultiply(r01, sx), XMVectorMultiply(r02, sx), zero));
+	XMMATRIX localRow1 = XMMatrixTranspose(XMMATRIX(
+		XMVectorMultiply(r10, sy), XMVectorMultiply(r11, sy), XMVectorMultiply(r12, sy), zero));
+	XMMATRIX localRow2 = XMMatrixTranspose(XMMATRIX(
+		XMVectorMultiply(r20, sz), XMVectorMultiply(r21, sz), XMVectorMultiply(r22, sz), zero));
+	XMMATRIX localRow3 = XMMatrixTranspose(XMMATRIX(px, py, pz, one));
+
+	// The last column holds the inverse's translation, -(rotation row . position) / scale
+	XMVECTOR invSx = XMVectorReciprocal(sx);
+	XMVECTOR invSy = XMVectorReciprocal(sy);
+	XMVECTOR invSz = XMVectorReciprocal(sz);
+
+	XMVECTOR d0 = XMVectorMultiplyAdd(r00, px, XMVectorMultiplyAdd(r01, py, XMVectorMultiply(r02, pz)));
+	XMVECTOR d1 = XMVectorMultiplyAdd(r10, px, XMVectorMultiplyAdd(r11, py, XMVectorMultiply(r12, pz)));
+	XMVECTOR d2 = XMVectorMultiplyAdd(r20, px, XMVectorMultiplyAdd(r21, py, XMVectorMultiply(r22, pz)));
+
+	XMMATRIX inverseRow0 = XMMatrixTranspose(XMMATRIX(
+		XMVectorMultiply(r00, invSx), XMVectorMultiply(r01, invSx), XMVectorMultiply(r02, invSx), XMVectorNegate(XMVectorMultiply(d0, invSx))));
+	XMMATRIX inverseRow1 = XMMatrixTranspose(XMMATRIX(
+		XMVectorMultiply(r10, invSy), XMVectorMultiply(r11, invSy), XMVectorMultiply(r12, invSy), XMVectorNegate(XMVectorMultiply(d1, invSy))));
+	XMMATRIX inverseRow2 = XMMatrixTranspose(XMMATRIX(
+		XMVectorMultiply(r20, invSz), XMVectorMultiply(r21, invSz), XMVectorMultiply(r22, invSz), XMVectorNegate(XMVectorMultiply(d2, invSz))));
+	XMVECTOR inverseRow3 = g_XMIdentityR3;
+
+	for (unsigned int lane = 0; lane < 4; lane++)
+	{
+		unsigned int slot = firstSlot + lane;
+		XMStoreFloat4x4(&localMatrices[slot], XMMATRIX(localRow0.r[lane], localRow1.r[lane], localRow2.r[lane], localRow3.r[lane]));
+		XMStoreFloat4x4(&localInverseTransposeMatrices[slot], XMMATRIX(inverseRow0.r[lane], inverseRow1.r[lane], inverseRow2.r[lane], inverseRow3));
+	}
+
+	// Free slots in the group were rebuilt too, which is harmless,
+	// but only the dirty ones need their world matrix redone
+	unsigned long long groupMask = 0xFull << (firstSlot % 64);
+	worldStale[firstSlot / 64] |= dirty[firstSlot / 64] & groupMask;
+	dirty[firstSlot / 64] &= ~groupMask;
+}
+
+// --------------------------------------------------------
+// World = local * parent world.  The inverse transpose of a
+// product is the product of the inverse transposes in the
+// same order, so the analytic local ones chain the same way
+// and no general inverse is ever needed.
+// --------------------------------------------------------
+void TransformSystem::UpdateWorld(unsigned int slot)
+{
+	unsigned int parent = parents[slot];
+	if (parent == NoSlot)
+	{
+		worldMatrices[slot] = localMatrices[slot];
+		worldInverseTransposeMatrices[slot] = localInverseTransposeMatrices[slot];
+	}
+	else
+	{
+		XMStoreFloat4x4(&worldMatrices[slot], XMMatrixMultiply(
+			XMLoadFloat4x4(&localMatrices[slot]), XMLoadFloat4x4(&worldMatrices[parent])));
+		XMStoreFloat4x4(&worldInverseTransposeMatrices[slot], XMMatrixMultiply(
+			XMLoadFloat4x4(&localInverseTransposeMatrices[slot]), XMLoadFloat4x4(&worldInverseTransposeMatrices[parent])));
+		parentVersions[slot] = worldVersions[parent];
+	}
+
+	worldVersions[slot]++;
+	ClearBit(worldStale, slot);
+}
+
+// --------------------------------------------------------
+// Breadth first from every root, which puts each slot after
+// its parent.  The order array doubles as the queue, so this
+// is linear in the number of live slots.
+// --------------------------------------------------------
+void TransformSystem::RebuildHierarchyOrder()
+{
+	hierarchyOrder.clear();
+
+	for (unsigned int slot = 0; slot < slotCount; slot++)
+	{
+		if (TestBit(live, slot) && parents[slot] == NoSlot)
+			hierarchyOrder.push_back(slot);
+	}
+
+	for (size_t i = 0; i < hierarchyOrder.size(); i++)
+	{
+		for (unsigned int child = firstChildren[hierarchyOrder[i]]; child != NoSlot; child = nextSiblings[child])
+			hierarchyOrder.push_back(child);
+	}
+
+	hierarchyChanged = false;
+}
+
+// --------------------------------------------------------
+// Settles one slot between batch updates by walking its
+// ancestors from the root down, rebuilding only what's out
+// of date along the way.  Siblings are left for the next
+// UpdateMatrices(), which will still see them as stale.
+// --------------------------------------------------------
+void TransformSystem::UpdateAncestors(unsigned int slot)
+{
+	ancestorChain.clear();
+	for (unsigned int ancestor = slot; ancestor != NoSlot; ancestor = parents[ancestor])
+		ancestorChain.push_back(ancestor);
+
+	for (size_t i = ancestorChain.size(); i-- > 0;)
+	{
+		unsigned int current = ancestorChain[i];
+		if (IsDirty(current))
+			UpdateGroup(current & ~3u);
+		if (NeedsWorldUpdate(current))
+			UpdateWorld(current);
+	}
+}
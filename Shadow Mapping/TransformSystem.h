@@ -0,0 +1,134 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+class Transform;
+
+// --------------------------------------------------------
+// Owns the data of every Transform in structure-of-arrays
+// form.  Transform objects only hold a slot index, and any
+// change marks the slot in a dirty bitset.  UpdateMatrices()
+// then rebuilds every dirty local matrix 4 transforms at a
+// time, and finds world matrices in one linear sweep over the
+// hierarchy, which is kept as a flat array sorted so parents
+// always come before their children.
+//
+// A slot's world matrix is recomputed when its local matrix
+// changed or its parent's world matrix did, so dirty state
+// flows down whole subtrees without visiting clean ones twice.
+//
+// Slots are recycled, and the arrays only ever grow, so a
+// slot index stays valid for the life of its Transform.
+// --------------------------------------------------------
+class TransformSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static TransformSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new TransformSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	TransformSystem(TransformSystem const&) = delete;
+	void operator=(TransformSystem const&) = delete;
+
+private:
+	static TransformSystem* instance;
+	TransformSystem();
+#pragma endregion
+
+public:
+	~TransformSystem();
+
+	// Marks a slot with no parent
+	static constexpr unsigned int NoSlot = 0xFFFFFFFF;
+
+	// Slots start out as an identity transform with no parent
+	unsigned int Allocate(Transform* owner);
+	// Children of a freed slot become roots
+	void Free(unsigned int slot);
+
+	// Position, rotation and scale are relative to the parent.
+	// Returns false (and changes nothing) if it would make a cycle.
+	bool SetParent(unsigned int slot, unsigned int parent);
+	unsigned int GetParent(unsigned int slot);
+	Transform* GetOwner(unsigned int slot);
+
+	void SetPosition(unsigned int slot, DirectX::XMFLOAT3 position);
+	void SetPitchYawRoll(unsigned int slot, DirectX::XMFLOAT3 rotation);
+	void SetScale(unsigned int slot, DirectX::XMFLOAT3 scale);
+
+	DirectX::XMFLOAT3 GetPosition(unsigned int slot);
+	DirectX::XMFLOAT3 GetPitchYawRoll(unsigned int slot);
+	DirectX::XMFLOAT3 GetScale(unsigned int slot);
+
+	// Brings this slot and its ancestors up to date on their own if needed
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int slot);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(unsigned int slot);
+
+	// Rebuilds every dirty slot (call once per frame, after things move)
+	void UpdateMatrices();
+
+	// World matrices recomputed by the last UpdateMatrices() call
+	unsigned int GetLastUpdateCount();
+
+private:
+	// Per-component arrays, padded to a multiple of 64 slots
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> pitch, yaw, roll;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	// Relative to the parent
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTransposeMatrices;
+
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+
+	// Hierarchy links, NoSlot where there is none
+	std::vector<Transform*> owners;
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> firstChildren;
+	std::vector<unsigned int> nextSiblings;
+	std::vector<unsigned int> previousSiblings;
+
+	// Every live slot, parents before children
+	std::vector<unsigned int> hierarchyOrder;
+	bool hierarchyChanged;
+
+	// Bumped whenever a world matrix is recomputed, so a child can
+	// tell that its parent moved by comparing against what it last saw
+	std::vector<unsigned int> worldVersions;
+	std::vector<unsigned int> parentVersions;
+
+	// One bit per slot
+	std::vector<unsigned long long> dirty;		// local values changed
+	std::vector<unsigned long long> worldStale;	// local matrix rebuilt (or reparented), world not yet
+	std::vector<unsigned long long> live;
+
+	// Anything to do at all since the last UpdateMatrices()
+	bool pendingChanges;
+
+	std::vector<unsigned int> freeSlots;
+	std::vector<unsigned int> ancestorChain;
+	unsigned int slotCount;
+	unsigned int lastUpdateCount;
+
+	void MarkDirty(unsigned int slot);
+	bool IsDirty(unsigned int slot);
+	bool NeedsWorldUpdate(unsigned int slot);
+	void Detach(unsigned int slot);
+	void Grow();
+	void UpdateGroup(unsigned int firstSlot);
+	void UpdateWorld(unsigned int slot);
+	void RebuildHierarchyOrder();
+	void UpdateAncestors(unsigned int slot);
+};
@@ -1,16 +1,17 @@
 #include "ShaderIncludes.hlsli"
 #include "ShaderHelpers.hlsli"
 
-//constant buffer definition
-cbuffer ExternalData : register(b0)
+//constant buffers, split by how often they change
+cbuffer PerFrame : register(b0)
 {
-	matrix world;
-    matrix worldInvTranspose;
 	matrix view;
 	matrix projection;
-	
-    matrix shadowView[3];
-    matrix shadowProjection;
+}
+
+cbuffer PerObject : register(b2)
+{
+	matrix world;
+    matrix worldInvTranspose;
 }
 
 VertexToPixel main( VertexShaderInput input )
@@ -28,11 +29,5 @@ VertexToPixel main( VertexShaderInput input )
 	
     output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
 	
-	// Calculate where this vertex is from the light's point of view
-    for (int i = 0; i < 3; i++)
-    {
-        output.posForShadow[i] = mul(mul(shadowProjection, mul(shadowView[i], world)), float4(input.localPosition, 1.0f));
-    }
-	
 	return output;
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "ShaderIncludes.hlsli"
+#include "ShaderHelpers.hlsli"
+
+//same per frame data as VertexShader.hlsl, but the per object
+//matrices come from the instance buffer instead of a cbuffer
+cbuffer PerFrame : register(b0)
+{
+	matrix view;
+	matrix projection;
+}
+
+VertexToPixel main( VertexShaderInput input, InstanceInput instance )
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	// The rows stored on the CPU are the columns of the matrices a cbuffer would hold
+    matrix world = transpose(matrix(instance.world0, instance.world1, instance.world2, instance.world3));
+    matrix worldInvTranspose = transpose(matrix(instance.worldInvTranspose0, instance.worldInvTranspose1, instance.worldInvTranspose2, instance.worldInvTranspose3));
+
+	matrix wvp = mul(projection, mul(view, world));
+	output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+	output.uv = input.uv;
+	    
+    output.normal = mul((float3x3) worldInvTranspose, input.normal);
+
+    output.tangent = mul((float3x3) world, input.tangent);
+	
+    output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
+	
+	return output;
+}
\ No newline at end of file
@@ -1,13 +1,17 @@
 #include "ShaderIncludes.hlsli"
 #include "ShaderHelpers.hlsli"
 
-cbuffer externalData : register(b0)
+cbuffer PerFrame : register(b0)
 {
-    matrix world;
     matrix view;
     matrix projection;
 };
 
+cbuffer PerObject : register(b2)
+{
+    matrix world;
+};
+
 VertexToPixel_Shadow main(VertexShaderInput input)
 {
     VertexToPixel_Shadow output;
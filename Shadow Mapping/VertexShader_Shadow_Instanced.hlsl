@@ -0,0 +1,19 @@
+#include "ShaderIncludes.hlsli"
+#include "ShaderHelpers.hlsli"
+
+cbuffer PerFrame : register(b0)
+{
+    matrix view;
+    matrix projection;
+};
+
+VertexToPixel_Shadow main(VertexShaderInput input, InstanceInput_Shadow instance)
+{
+    VertexToPixel_Shadow output;
+    
+    matrix world = transpose(matrix(instance.world0, instance.world1, instance.world2, instance.world3));
+    matrix wvp = mul(projection, mul(view, world));
+    output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+	
+    return output;
+}
\ No newline at end of file
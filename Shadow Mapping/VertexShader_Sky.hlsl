@@ -1,7 +1,7 @@
 #include "ShaderIncludes.hlsli"
 
 //constant buffer definition
-cbuffer ExternalData : register(b0)
+cbuffer PerFrame : register(b0)
 {
     matrix view;
     matrix projection;